@@ -17,10 +17,34 @@ void Bone::setRotate(const Quat& rotation) {
 	transform_.setRotation(rotation);
 }
 
+void Bone::setRotate(const UnitQuat& rotation) {
+	transform_.setRotation(rotation);
+}
+
+void Bone::setTranslate(const Cvec3& translation) {
+	transform_.setTranslation(translation);
+}
+
+void Bone::setOffset(const Matrix4& offset) {
+	offset_ = offset;
+}
+
 Quat Bone::getRotation() const{
 	return transform_.getRotation();
 }
 
+const RigTForm& Bone::getTransform() const {
+	return transform_;
+}
+
+const Matrix4& Bone::getOffset() const {
+	return offset_;
+}
+
+Bone* Bone::getParent() const {
+	return parent_;
+}
+
 Matrix4 Bone::getModelMatrix() const
 {
 	if(parent_ != NULL)
@@ -55,4 +79,24 @@ Bone* Skeleton::addBone(int name,Bone* parent,const RigTForm& transform)
 Bone* Skeleton::getNamedBone(int index)
 {
 	return bones_[index];
-}
\ No newline at end of file
+}
+
+int Skeleton::getBoneCount() const
+{
+	return (int)bones_.size();
+}
+
+void Skeleton::getParentNames(std::vector<int>& parents) const
+{
+	std::map<const Bone*, int> names;
+	std::map<int, Bone*>::const_iterator iter;
+	for (iter = bones_.begin(); iter != bones_.end(); iter++)
+		names[iter->second] = iter->first;
+
+	parents.assign(bones_.size(), -1);
+	for (iter = bones_.begin(); iter != bones_.end(); iter++) {
+		const Bone* parent = iter->second->getParent();
+		if (parent != NULL)
+			parents[iter->first] = names[parent];
+	}
+}
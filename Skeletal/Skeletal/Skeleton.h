@@ -4,6 +4,7 @@
 #include "rigtform.h"
 
 #include <map>
+#include <vector>
 
 class Skeleton;
 
@@ -18,8 +19,15 @@ public:
 
 	void rotate(const Quat& rotation);
 	void setRotate(const Quat& rotation);
+	void setRotate(const UnitQuat& rotation);
+	void setTranslate(const Cvec3& translation);
+	// Overrides the inverse bind matrix computed from the initial transform
+	void setOffset(const Matrix4& offset);
 
 	Quat getRotation() const;
+	const RigTForm& getTransform() const;
+	const Matrix4& getOffset() const;
+	Bone* getParent() const;
 	Matrix4 getModelMatrix() const;
 	Matrix4 getBoneMatrix() const;
 };
@@ -34,6 +42,9 @@ public:
 
 	Bone* addBone(int name,Bone* parent,const RigTForm& transform);
 	Bone* getNamedBone(int name);
+	int getBoneCount() const;
+	// Name of the parent of each bone, -1 for roots
+	void getParentNames(std::vector<int>& parents) const;
 };
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,374 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "accuracy.h"
+#include "animlod.h"
+#include "bonemask.h"
+#include "gltf.h"
+#include "gpumatrix.h"
+#include "morph.h"
+#include "skinweights.h"
+#include "sparseskin.h"
+
+using namespace std;
+
+namespace {
+
+// Bone::rotate steps per drift measurement, each up to 2 degrees
+const int ROTATE_STEPS = 1000;
+
+// Errors of one path over all trials, in millimetres
+struct ErrorStats {
+  double maxMm;
+  double sumSquares;
+  long long count;
+  int worst;                 // bone, vertex or rotation of the largest error
+  vector<double> itemMaxMm;  // largest error of each of them
+
+  ErrorStats() : maxMm(0), sumSquares(0), count(0), worst(-1) {}
+
+  void add(double mm, int item) {
+    if (mm > maxMm || worst < 0) {
+      maxMm = mm;
+      worst = item;
+    }
+    if (item >= (int) itemMaxMm.size())
+      itemMaxMm.resize(item + 1, 0);
+    itemMaxMm[item] = max(itemMaxMm[item], mm);
+    sumSquares += mm * mm;
+    ++count;
+  }
+
+  double getRms() const {
+    return count ? sqrt(sumSquares / count) : 0;
+  }
+};
+
+double uniform(mt19937& rng, double lo, double hi) {
+  return uniform_real_distribution<double>(lo, hi)(rng);
+}
+
+Cvec3 randomAxis(mt19937& rng) {
+  Cvec3 axis;
+  do {
+    axis = Cvec3(uniform(rng, -1, 1), uniform(rng, -1, 1), uniform(rng, -1, 1));
+  } while (norm2(axis) < 0.01 || norm2(axis) > 1);
+  return normalize(axis);
+}
+
+// The rotation by degrees about a unit axis
+Quat axisRotation(const Cvec3& axis, double degrees) {
+  const double h = 0.5 * degrees * CS175_PI / 180;
+  return Quat(cos(h), axis * sin(h));
+}
+
+// A rotation about a random axis by up to maxDegrees either way
+Quat randomRotation(mt19937& rng, double maxDegrees) {
+  const Cvec3 axis = randomAxis(rng);
+  return axisRotation(axis, uniform(rng, -maxDegrees, maxDegrees));
+}
+
+// A tree of bones 5 to 40 cm long, each hanging from one of the four
+// bones before it
+void makeRandomSkeleton(mt19937& rng, int boneCount, Skeleton& skeleton) {
+  vector<Bone*> added;
+  for (int b = 0; b < boneCount; ++b) {
+    Bone* parent = b ? added[uniform_int_distribution<int>(max(0, b - 4), b - 1)(rng)] : NULL;
+    const Quat r = randomRotation(rng, 30);
+    const Cvec3 t = Cvec3(r * Cvec4(0, uniform(rng, 0.05, 0.4), 0, 0));
+    added.push_back(skeleton.addBone(b, parent, RigTForm(t, r)));
+  }
+}
+
+// Every bone rotates within 40 degrees of its bind pose through 2 to 6
+// keys, and the root also moves
+GltfAnimation makeRandomClip(mt19937& rng, Skeleton& skeleton) {
+  GltfAnimation clip;
+  clip.name = "random";
+  clip.duration = uniform(rng, 1, 3);
+  for (int b = 0; b < skeleton.getBoneCount(); ++b) {
+    const RigTForm bind = skeleton.getNamedBone(b)->getTransform();
+    for (int channel = 0; channel < (b ? 1 : 2); ++channel) {
+      GltfChannel ch;
+      ch.bone = b;
+      ch.rotation = channel == 0;
+      ch.step = false;
+      const int keys = uniform_int_distribution<int>(2, 6)(rng);
+      for (int k = 0; k < keys; ++k) {
+        ch.times.push_back(float(clip.duration * k / (keys - 1)));
+        if (ch.rotation) {
+          const Quat q = bind.getRotation() * randomRotation(rng, 40);
+          ch.values.push_back(Cvec4(q[0], q[1], q[2], q[3]));
+        }
+        else
+          ch.values.push_back(Cvec4(bind.getTranslation() + Cvec3(uniform(rng, -0.2, 0.2)), 0));
+      }
+      clip.channels.push_back(ch);
+    }
+  }
+  return clip;
+}
+
+// Weighted to one to three bones, a few centimetres off the joint of the
+// first, with random weights
+void makeRandomMesh(mt19937& rng, const vector<Matrix4>& bindFrames, const vector<int>& parents,
+                    int count, vector<VertexPNB>& vtx) {
+  const int boneCount = (int) bindFrames.size();
+  for (int v = 0; v < count; ++v) {
+    const int b = uniform_int_distribution<int>(0, boneCount - 1)(rng);
+    const Cvec3 offset(uniform(rng, -0.1, 0.1), uniform(rng, -0.1, 0.1), uniform(rng, -0.1, 0.1));
+    const Cvec3 p = Cvec3(bindFrames[b] * Cvec4(offset, 1));
+    const Cvec3 n = normalize(offset + Cvec3(0, 0, 1e-3));
+    VertexPNB vertex((float) p[0], (float) p[1], (float) p[2], (float) n[0], (float) n[1], (float) n[2]);
+    const int influences = uniform_int_distribution<int>(1, 3)(rng);
+    const int names[3] = {b, parents[b] >= 0 ? parents[b] : b, uniform_int_distribution<int>(0, boneCount - 1)(rng)};
+    double weights[3] = {0, 0, 0}, sum = 0;
+    for (int j = 0; j < influences; ++j)
+      sum += (weights[j] = uniform(rng, 0.1, 1));
+    for (int j = 0; j < 3; ++j) {
+      vertex.bn[j] = names[j];
+      vertex.bw[j] = float(weights[j] / sum);
+    }
+    vtx.push_back(vertex);
+  }
+  pruneInfluences(vtx);
+}
+
+// Largest distance in mm between where two bone matrices take the bone's
+// bind-pose joint and the points one metre along its axes
+double boneErrorMm(const Matrix4& reference, const Matrix4& fast, const Matrix4& bindFrame) {
+  static const Cvec4 probes[4] = {Cvec4(0, 0, 0, 1), Cvec4(1, 0, 0, 1), Cvec4(0, 1, 0, 1), Cvec4(0, 0, 1, 1)};
+  double error = 0;
+  for (int i = 0; i < 4; ++i) {
+    const Cvec4 p = bindFrame * probes[i];
+    error = max(error, norm(Cvec3(reference * p - fast * p)));
+  }
+  return 1000 * error;
+}
+
+// boneErrorMm for a bone matrix sent to the GPU, applied in float as the
+// shaders do
+double gpuErrorMm(const Matrix4& reference, const GpuMatrix4& gpu, const Matrix4& bindFrame) {
+  static const Cvec4 probes[4] = {Cvec4(0, 0, 0, 1), Cvec4(1, 0, 0, 1), Cvec4(0, 1, 0, 1), Cvec4(0, 0, 1, 1)};
+  double error = 0;
+  for (int i = 0; i < 4; ++i) {
+    const Cvec4 p = bindFrame * probes[i];
+    const Cvec4 exact = reference * p;
+    for (int r = 0; r < 3; ++r) {
+      float f = 0;
+      for (int c = 0; c < 4; ++c)
+        f += gpu(r, c) * float(p[c]);
+      error = max(error, abs(exact[r] - f));
+    }
+  }
+  return 1000 * error;
+}
+
+// Moves a random third of the vertices by up to 5 cm and their normals by
+// up to 0.2 along each axis
+vector<VertexPNB> makeRandomMorphTarget(mt19937& rng, const vector<VertexPNB>& base) {
+  vector<VertexPNB> target(base);
+  for (size_t v = 0; v < target.size(); ++v) {
+    if (uniform(rng, 0, 3) >= 1)
+      continue;
+    for (int j = 0; j < 3; ++j) {
+      target[v].p[j] += float(uniform(rng, -0.05, 0.05));
+      target[v].n[j] += float(uniform(rng, -0.2, 0.2));
+    }
+  }
+  return target;
+}
+
+void addBoneErrors(const vector<Matrix4>& reference, const Matrix4 fast[], const vector<Matrix4>& bindFrames,
+                   ErrorStats& stats) {
+  for (size_t b = 0; b < reference.size(); ++b)
+    stats.add(boneErrorMm(reference[b], fast[b], bindFrames[b]), (int) b);
+}
+
+void getBoneMatrices(Skeleton& skeleton, vector<Matrix4>& bones) {
+  for (size_t b = 0; b < bones.size(); ++b)
+    bones[b] = skeleton.getNamedBone((int) b)->getBoneMatrix();
+}
+
+// slerp along the shorter arc, which blendPoses takes and slerp does not
+Quat slerpShortest(const Quat& a, const Quat& b, double w) {
+  return slerp(a, dot(a, b) < 0 ? b * -1.0 : b, w);
+}
+
+} // namespace
+
+bool checkAccuracy(const AccuracyConfig& config) {
+  mt19937 rng(config.seed);
+  ErrorStats stats[ACCURACY_PATH_COUNT];
+  const int n = config.bones;
+  vector<Matrix4> reference(n), bindFrames(n), models(n), bones(n);
+  vector<RigTForm> localsA(n), localsB(n), blended(n);
+  vector<float> palette(n * SKIN_PALETTE_STRIDE);
+
+  for (int trial = 0; trial < config.trials; ++trial) {
+    Skeleton skeleton;
+    makeRandomSkeleton(rng, n, skeleton);
+    BoneMask all;
+    all.used.assign(n, 1);
+    vector<int> parents;
+    skeleton.getParentNames(parents);
+    finishBoneMask(parents, all);
+    AnimRig rig;
+    buildAnimRig(skeleton, all, rig);
+    for (int b = 0; b < n; ++b)
+      bindFrames[b] = inv(skeleton.getNamedBone(b)->getOffset());
+    const GltfAnimation clipA = makeRandomClip(rng, skeleton), clipB = makeRandomClip(rng, skeleton);
+
+    // a random pose
+    for (int b = 0; b < n; ++b)
+      skeleton.getNamedBone(b)->setRotate(skeleton.getNamedBone(b)->getRotation() * randomRotation(rng, 90));
+    getBoneMatrices(skeleton, reference);
+    evaluateBones(skeleton, parents, all.order, &models[0], &bones[0]);
+    addBoneErrors(reference, &bones[0], bindFrames, stats[ACCURACY_EVALUATE_BONES]);
+
+    // a clip sampled at a random time
+    const double t = uniform(rng, 0, min(clipA.duration, clipB.duration));
+    sampleGltfAnimation(clipA, t, skeleton);
+    getBoneMatrices(skeleton, reference);
+    evaluateAnimLod(rig, clipA, t, 0, &localsA[0], &models[0], &bones[0]);
+    addBoneErrors(reference, &bones[0], bindFrames, stats[ACCURACY_ANIM_LOD]);
+
+    // the chain of one random bone at the same time, as attachments take it
+    const int chainBone = uniform_int_distribution<int>(0, n - 1)(rng);
+    stats[ACCURACY_ANIM_CHAIN].add(boneErrorMm(reference[chainBone],
+                                               evaluateAnimChain(rig, clipA, t, chainBone) * rig.offsets[chainBone],
+                                               bindFrames[chainBone]), chainBone);
+
+    // two clips blended by a random weight
+    for (int b = 0; b < n; ++b)
+      localsA[b] = skeleton.getNamedBone(b)->getTransform();
+    sampleGltfAnimation(clipB, t, skeleton);
+    for (int b = 0; b < n; ++b)
+      localsB[b] = skeleton.getNamedBone(b)->getTransform();
+    const double w = uniform(rng, 0, 1);
+    for (int b = 0; b < n; ++b) {
+      Bone* bone = skeleton.getNamedBone(b);
+      bone->setRotate(slerpShortest(localsA[b].getRotation(), localsB[b].getRotation(), w));
+      bone->setTranslate(localsA[b].getTranslation() * (1 - w) + localsB[b].getTranslation() * w);
+    }
+    getBoneMatrices(skeleton, reference);
+    blendPoses(rig, &localsA[0], &localsB[0], w, &blended[0]);
+    evaluateAnimRig(rig, &blended[0], &models[0], &bones[0]);
+    addBoneErrors(reference, &bones[0], bindFrames, stats[ACCURACY_BLEND]);
+
+    // the blended pose as sent to the shaders
+    for (int b = 0; b < n; ++b)
+      stats[ACCURACY_GPU_MATRIX].add(gpuErrorMm(reference[b], GpuMatrix4(reference[b]), bindFrames[b]), b);
+
+    // a random mesh skinned by the reference blended pose
+    vector<VertexPNB> vtx;
+    makeRandomMesh(rng, bindFrames, parents, config.vertices, vtx);
+    const int vbLen = (int) vtx.size();
+    SkinWeightsCsr csr;
+    SkinWeightsEll ell;
+    SkinInput input;
+    buildSkinWeightsCsr(&vtx[0], vbLen, csr);
+    buildSkinWeightsEll(&vtx[0], vbLen, ell);
+    buildSkinInput(&vtx[0], vbLen, input);
+    for (int b = 0; b < n; ++b) {
+      for (int i = 0; i < SKIN_PALETTE_STRIDE; ++i)
+        palette[b * SKIN_PALETTE_STRIDE + i] = float(reference[b][i]);
+    }
+    vector<float> positions[2], normals(3 * vbLen);
+    positions[0].resize(3 * vbLen);
+    positions[1].resize(3 * vbLen);
+    skinCsr(csr, input, &palette[0], &positions[0][0], &normals[0]);
+    skinEllBatch(ell, input, &palette[0], 1, &positions[1][0], &normals[0]);
+    for (int v = 0; v < vbLen; ++v) {
+      const Cvec4 p(Cvec3(vtx[v].p[0], vtx[v].p[1], vtx[v].p[2]), 1);
+      Cvec3 skinned;
+      for (int j = 0; j < 3; ++j)
+        skinned += Cvec3(reference[vtx[v].bn[j]] * p) * vtx[v].bw[j];
+      for (int path = 0; path < 2; ++path) {
+        const float* q = &positions[path][3 * v];
+        stats[ACCURACY_SKIN_CSR + path].add(1000 * norm(skinned - Cvec3(q[0], q[1], q[2])), v);
+      }
+    }
+
+    // the mesh morphed by two random targets at random weights
+    MorphSet morphs(vbLen);
+    vector<VertexPNB> targets[2];
+    float weights[2];
+    for (int i = 0; i < 2; ++i) {
+      targets[i] = makeRandomMorphTarget(rng, vtx);
+      morphs.addTarget("random", vtx, targets[i]);
+      weights[i] = float(uniform(rng, 0, 1));
+    }
+    MorphApplier applier(vtx);
+    applier.apply(morphs, weights);
+    for (int v = 0; v < vbLen; ++v) {
+      Cvec3 exact(vtx[v].p[0], vtx[v].p[1], vtx[v].p[2]);
+      for (int i = 0; i < 2; ++i) {
+        for (int j = 0; j < 3; ++j)
+          exact[j] += weights[i] * (double(targets[i][v].p[j]) - vtx[v].p[j]);
+      }
+      const Cvec3f& morphed = applier.getVertices()[v].p;
+      stats[ACCURACY_MORPH].add(1000 * norm(exact - Cvec3(morphed[0], morphed[1], morphed[2])), v);
+    }
+
+    // one bone turned in many small steps by Bone::rotate, each product
+    // renormalized, against the same turn made at once
+    const int turned = uniform_int_distribution<int>(0, n - 1)(rng);
+    Bone* bone = skeleton.getNamedBone(turned);
+    const Quat start = bone->getRotation();
+    const Cvec3 axis = randomAxis(rng);
+    const double step = uniform(rng, -2, 2);
+    for (int k = 0; k < ROTATE_STEPS; ++k)
+      bone->rotate(axisRotation(axis, step));
+    getBoneMatrices(skeleton, bones);
+    bone->setRotate(start * axisRotation(axis, step * ROTATE_STEPS));
+    getBoneMatrices(skeleton, reference);
+    addBoneErrors(reference, &bones[0], bindFrames, stats[ACCURACY_ROTATE_DRIFT]);
+
+    // rotations by random angles, from the series of constmath.h and from
+    // std::sin and std::cos, as matrices and as quaternions
+    const double ang = uniform(rng, -720, 720), rad = ang * CS175_PI / 180;
+    const Matrix4 series[6] = {
+      Matrix4::makeConstXRotation(ang), Matrix4::makeConstYRotation(ang), Matrix4::makeConstZRotation(ang),
+      quatToMatrix(Quat::makeConstXRotation(ang)), quatToMatrix(Quat::makeConstYRotation(ang)),
+      quatToMatrix(Quat::makeConstZRotation(ang))
+    };
+    const Matrix4 exact[6] = {
+      Matrix4::makeXRotation(cos(rad), sin(rad)), Matrix4::makeYRotation(cos(rad), sin(rad)),
+      Matrix4::makeZRotation(cos(rad), sin(rad)), quatToMatrix(Quat(cos(rad / 2), sin(rad / 2), 0, 0)),
+      quatToMatrix(Quat(cos(rad / 2), 0, sin(rad / 2), 0)), quatToMatrix(Quat(cos(rad / 2), 0, 0, sin(rad / 2)))
+    };
+    for (int i = 0; i < 6; ++i)
+      stats[ACCURACY_SERIES_ROTATION].add(boneErrorMm(exact[i], series[i], Matrix4()), i);
+  }
+
+  cout << "Accuracy over " << config.trials << " random rigs of " << n << " bones and " << config.vertices
+       << " vertices (seed " << config.seed << "), world-space mm:" << endl;
+  static const char* const itemNames[] = {"bone", "vertex", "rotation"};
+  bool passed = true;
+  for (int path = 0; path < ACCURACY_PATH_COUNT; ++path) {
+    const AccuracyLimit& limit = ACCURACY_LIMITS[path];
+    const ErrorStats& s = stats[path];
+    const bool ok = s.maxMm <= limit.maxMm && s.getRms() <= limit.rmsMm;
+    passed = passed && ok;
+    cout << "  " << left << setw(17) << limit.name << right << setprecision(3)
+         << " max " << setw(9) << s.maxMm << " (" << itemNames[limit.item] << " " << s.worst << ")"
+         << "  rms " << setw(9) << s.getRms() << "  limits " << limit.maxMm << " / " << limit.rmsMm
+         << (ok ? "  ok" : "  FAILED") << endl;
+    // the max of every bone, eight to a line, where any is off
+    if (limit.item == ACCURACY_PER_BONE && s.maxMm > 0) {
+      for (size_t b = 0; b < s.itemMaxMm.size(); ++b) {
+        if (b % 8 == 0)
+          cout << (b ? "\n" : "") << "    bones " << setw(2) << b << "-" << setw(2) << min(b + 7, s.itemMaxMm.size() - 1) << ":";
+        cout << " " << setw(9) << s.itemMaxMm[b];
+      }
+      cout << endl;
+    }
+  }
+  cout << setprecision(6);
+  return passed;
+}
@@ -0,0 +1,69 @@
+#ifndef ACCURACY_H
+#define ACCURACY_H
+
+//--------------------------------------------------------------------------------
+// Accuracy regression checks for the fast animation and skinning paths.
+// Random rigs, poses and clips go through the reference double precision
+// path (Bone::getBoneMatrix over Matrix4 and Quat, slerp, skinning with
+// double matrices) and through each fast path, and the difference is
+// measured in world-space millimetres, taking scene units as metres. A bone
+// is measured at its bind-pose joint and one metre along each of its axes,
+// so rotation errors count as the displacement they cause at that reach.
+// Paths measured per bone also report the largest error of each bone.
+//--------------------------------------------------------------------------------
+
+enum AccuracyPath {
+  ACCURACY_EVALUATE_BONES,  // evaluateBones against getBoneMatrix
+  ACCURACY_ANIM_LOD,        // evaluateAnimLod at full detail against sampling into the Skeleton
+  ACCURACY_ANIM_CHAIN,      // evaluateAnimChain of a random bone, likewise
+  ACCURACY_BLEND,           // blendPoses (nlerp) against slerp
+  ACCURACY_ROTATE_DRIFT,    // a bone turned by Bone::rotate many times against one exact turn
+  ACCURACY_GPU_MATRIX,      // bone matrices as GpuMatrix4 floats against doubles
+  ACCURACY_SKIN_CSR,        // skinCsr (float palettes) against double skinning
+  ACCURACY_SKIN_ELL,        // skinEllBatch, likewise
+  ACCURACY_MORPH,           // 16 bit morph deltas through MorphApplier against double deltas
+  ACCURACY_SERIES_ROTATION, // makeConst*Rotation (sinDegrees and cosDegrees) against std::sin and std::cos
+  ACCURACY_PATH_COUNT
+};
+
+enum AccuracyItem {
+  ACCURACY_PER_BONE,
+  ACCURACY_PER_VERTEX,
+  ACCURACY_PER_ROTATION
+};
+
+// How far a path may stray from the reference, in millimetres
+struct AccuracyLimit {
+  const char* name;
+  AccuracyItem item;  // what each error is measured on
+  double maxMm;
+  double rmsMm;
+};
+
+static const AccuracyLimit ACCURACY_LIMITS[ACCURACY_PATH_COUNT] = {
+  {"evaluateBones",     ACCURACY_PER_BONE,     1e-9,  1e-10},
+  {"evaluateAnimLod",   ACCURACY_PER_BONE,     1e-9,  1e-10},
+  {"evaluateAnimChain", ACCURACY_PER_BONE,     1e-9,  1e-10},
+  {"blendPoses",        ACCURACY_PER_BONE,     20.0,  3.0},
+  {"Bone::rotate",      ACCURACY_PER_BONE,     1e-9,  1e-10},
+  {"GpuMatrix4",        ACCURACY_PER_BONE,     0.002, 0.0005},
+  {"skinCsr",           ACCURACY_PER_VERTEX,   0.002, 0.0005},
+  {"skinEllBatch",      ACCURACY_PER_VERTEX,   0.002, 0.0005},
+  {"morph deltas",      ACCURACY_PER_VERTEX,   0.005, 0.001},
+  {"sinDegrees",        ACCURACY_PER_ROTATION, 1e-10, 1e-11}
+};
+
+struct AccuracyConfig {
+  int trials;     // random rigs, each with a random pose and a pair of clips
+  int bones;      // per rig
+  int vertices;   // skinned per rig
+  unsigned seed;
+};
+
+static const AccuracyConfig ACCURACY_DEFAULTS = {200, 24, 500, 175};
+
+// Runs every path, prints the max and RMS error of each against its limits
+// and returns whether all are within them
+bool checkAccuracy(const AccuracyConfig& config);
+
+#endif
@@ -0,0 +1,116 @@
+#include <cmath>
+
+#include "animlod.h"
+#include "fusedmath.h"
+
+using namespace std;
+
+double projectedSize(const Cvec3& center, double radius, double fovY) {
+  const double distance = norm(center);
+  if (distance <= radius)
+    return 1;
+  return radius / (distance * tan(fovY * 0.5 * CS175_PI / 180));
+}
+
+int selectAnimLod(double size) {
+  int level = 0;
+  while (level + 1 < ANIMLOD_LEVEL_COUNT && size < ANIMLOD_LEVELS[level].minSize)
+    ++level;
+  return level;
+}
+
+void buildAnimRig(Skeleton& skeleton, const BoneMask& bones, AnimRig& rig) {
+  const int boneCount = skeleton.getBoneCount();
+  skeleton.getParentNames(rig.parents);
+  rig.order = bones.order;
+  rig.rest.resize(boneCount);
+  rig.restMatrices.resize(boneCount);
+  rig.offsets.resize(boneCount);
+  for (int b = 0; b < boneCount; ++b) {
+    const Bone* bone = skeleton.getNamedBone(b);
+    rig.rest[b] = bone->getTransform();
+    rig.restMatrices[b] = rigTFormToMatrix(rig.rest[b]);
+    rig.offsets[b] = bone->getOffset();
+  }
+
+  // depth of each bone and whether it has children
+  vector<int> depth(boneCount, 0);
+  vector<char> isLeaf(boneCount, 1);
+  for (int b = 0; b < boneCount; ++b) {
+    if (rig.parents[b] >= 0)
+      isLeaf[rig.parents[b]] = 0;
+    for (int p = rig.parents[b]; p >= 0; p = rig.parents[p])
+      ++depth[b];
+  }
+
+  for (int l = 0; l < ANIMLOD_LEVEL_COUNT; ++l) {
+    const AnimLodLevel& level = ANIMLOD_LEVELS[l];
+    rig.masks[l].assign(bones.used.begin(), bones.used.end());
+    rig.maskSizes[l] = 0;
+    for (int b = 0; b < boneCount; ++b) {
+      if ((level.skipLeaves && isLeaf[b] && depth[b] > 0) || (level.maxDepth > 0 && depth[b] >= level.maxDepth))
+        rig.masks[l][b] = 0;
+      rig.maskSizes[l] += rig.masks[l][b];
+    }
+  }
+}
+
+int evaluateAnimLod(const AnimRig& rig, const GltfAnimation& animation, double t, int level,
+                    RigTForm locals[], Matrix4 models[], Matrix4 bones[]) {
+  const vector<char>& mask = rig.masks[level];
+  for (size_t i = 0; i < rig.order.size(); ++i) {
+    if (mask[rig.order[i]])
+      locals[rig.order[i]] = rig.rest[rig.order[i]];
+  }
+  sampleGltfAnimation(animation, t, mask, ANIMLOD_LEVELS[level].interpolate, locals);
+
+  // skipped bones follow their parent in their rest pose
+  for (size_t i = 0; i < rig.order.size(); ++i) {
+    const int b = rig.order[i], p = rig.parents[b];
+    if (p < 0)
+      models[b] = mask[b] ? rigTFormToMatrix(locals[b]) : rig.restMatrices[b];
+    else if (mask[b])
+      composeRigidInto(models[p], locals[b], models[b]);
+    else
+      multiplyAffineInto(models[p], rig.restMatrices[b], models[b]);
+    multiplyAffineInto(models[b], rig.offsets[b], bones[b]);
+  }
+  return rig.maskSizes[level];
+}
+
+void evaluateAnimRig(const AnimRig& rig, const RigTForm locals[], Matrix4 models[], Matrix4 bones[]) {
+  for (size_t i = 0; i < rig.order.size(); ++i) {
+    const int b = rig.order[i], p = rig.parents[b];
+    if (p >= 0)
+      composeRigidInto(models[p], locals[b], models[b]);
+    else
+      models[b] = rigTFormToMatrix(locals[b]);
+    multiplyAffineInto(models[b], rig.offsets[b], bones[b]);
+  }
+}
+
+void blendPoses(const AnimRig& rig, const RigTForm a[], const RigTForm b[], double w, RigTForm out[]) {
+  for (size_t i = 0; i < rig.order.size(); ++i) {
+    const int bone = rig.order[i];
+    const Quat qa = a[bone].getRotation(), qb = b[bone].getRotation();
+    const Quat q = dot(qa, qb) < 0 ? qa * (1 - w) - qb * w : qa * (1 - w) + qb * w;
+    out[bone] = RigTForm(a[bone].getTranslation() * (1 - w) + b[bone].getTranslation() * w, UnitQuat(q));
+  }
+}
+
+Matrix4 evaluateAnimChain(const AnimRig& rig, const GltfAnimation& animation, double t, int bone) {
+  vector<int> chain;
+  getBoneChain(rig.parents, bone, chain);
+  vector<char> mask(rig.parents.size(), 0);
+  vector<RigTForm> locals(rig.parents.size());
+  for (size_t i = 0; i < chain.size(); ++i) {
+    mask[chain[i]] = 1;
+    locals[chain[i]] = rig.rest[chain[i]];
+  }
+  sampleGltfAnimation(animation, t, mask, true, &locals[0]);
+
+  Matrix4 model;
+  for (size_t i = 0; i < chain.size(); ++i)
+    composeRigidInto(model, locals[chain[i]], model);
+  return model;
+}
@@ -0,0 +1,96 @@
+#ifndef ANIMLOD_H
+#define ANIMLOD_H
+
+#include <vector>
+
+#include "cvec.h"
+#include "matrix4.h"
+#include "rigtform.h"
+#include "Skeleton.h"
+#include "gltf.h"
+#include "bonemask.h"
+
+//--------------------------------------------------------------------------------
+// Animation level of detail. Each animated instance picks a level from its
+// projected size: smaller instances update less often, sample fewer bones
+// and take the previous key instead of interpolating. Instances updating at
+// a reduced rate take turns, so every frame updates about the same number.
+//--------------------------------------------------------------------------------
+
+struct AnimLodLevel {
+  double minSize;     // smallest projected size using this level
+  int interval;       // update every interval frames
+  bool skipLeaves;    // leaf bones (fingers, toes, ...) keep their rest pose
+  int maxDepth;       // bones at least this deep keep their rest pose, 0 for no limit
+  bool interpolate;   // interpolate between keys or take the previous key
+};
+
+static const int ANIMLOD_LEVEL_COUNT = 4;
+static const AnimLodLevel ANIMLOD_LEVELS[ANIMLOD_LEVEL_COUNT] = {
+  {0.25, 1, false, 0, true},
+  {0.1,  2, false, 0, true},
+  {0.04, 4, true,  0, true},
+  {0.0,  8, true,  2, false}
+};
+
+// Fraction of the screen height covered by a sphere at `center', in eye
+// coordinates, seen with a vertical field of view of fovY degrees
+double projectedSize(const Cvec3& center, double radius, double fovY);
+
+// Level of an instance of the given projected size
+int selectAnimLod(double size);
+
+// Instance i of a level updates on the frames where frame % interval equals
+// i % interval. Neighbouring instances tend to share a level, so they split
+// its frames evenly.
+inline bool isAnimLodUpdate(int level, int instance, int frame) {
+  const int interval = ANIMLOD_LEVELS[level].interval;
+  return frame % interval == instance % interval;
+}
+
+// A skeleton flattened for evaluating many instances of it
+struct AnimRig {
+  std::vector<int> order;                         // names of the bones evaluated, parents first
+  std::vector<int> parents;                       // -1 for roots
+  std::vector<RigTForm> rest;                     // local transforms of the rest pose
+  std::vector<Matrix4> restMatrices;              // the same as matrices
+  std::vector<Matrix4> offsets;                   // inverse bind matrices
+  std::vector<char> masks[ANIMLOD_LEVEL_COUNT];   // bones sampled at each level
+  int maskSizes[ANIMLOD_LEVEL_COUNT];
+};
+
+// Takes the current pose of the skeleton as the rest pose. Only the bones
+// of `bones' (usually those a mesh references) are ever sampled or
+// evaluated; the palette entries of the others are left alone.
+void buildAnimRig(Skeleton& skeleton, const BoneMask& bones, AnimRig& rig);
+
+// Writes the bone matrices of an instance posed at time t of the animation
+// with the bones of its level to bones[], leaving the entries of bones the
+// rig never evaluates alone. locals and models are scratch space the size
+// of the rig. Returns the number of bones sampled.
+int evaluateAnimLod(const AnimRig& rig, const GltfAnimation& animation, double t, int level,
+                    RigTForm locals[], Matrix4 models[], Matrix4 bones[]);
+
+// Writes the model and bone matrices of the rig's bones posed at locals,
+// leaving the entries of other bones alone
+void evaluateAnimRig(const AnimRig& rig, const RigTForm locals[], Matrix4 models[], Matrix4 bones[]);
+
+// Blends two poses of the rig's bones into out, a fraction w of the way
+// from a to b. Translations are interpolated linearly and rotations by
+// normalized lerp along the shorter arc, which is close to slerp for the
+// angles between the clips a crowd blends. Other bones are left alone.
+void blendPoses(const AnimRig& rig, const RigTForm a[], const RigTForm b[], double w, RigTForm out[]);
+
+// Model matrix of one bone at time t of the animation, at full quality,
+// sampling and evaluating only the chain from its root. For attachments.
+Matrix4 evaluateAnimChain(const AnimRig& rig, const GltfAnimation& animation, double t, int bone);
+
+// What a frame of animation LOD did
+struct AnimLodStats {
+  int instances[ANIMLOD_LEVEL_COUNT];  // instances at each level
+  int updates;                         // instances evaluated
+  int bonesEvaluated;                  // bones sampled over all of them
+  int bonesFull;                       // bones sampled without LOD
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include <algorithm>
+
+#include "bonemask.h"
+#include "fusedmath.h"
+
+using namespace std;
+
+void markReferencedBones(const VertexPNB* vertices, int count, vector<char>& mask) {
+  for (int i = 0; i < count; ++i) {
+    const VertexPNB& v = vertices[i];
+    for (int j = 0; j < 3; ++j) {
+      if (v.bw[j] <= 0)
+        continue;
+      if (v.bn[j] >= int(mask.size()))
+        mask.resize(v.bn[j] + 1, 0);
+      mask[v.bn[j]] = 1;
+    }
+  }
+}
+
+void markAncestors(const vector<int>& parents, vector<char>& mask) {
+  mask.resize(parents.size(), 0);
+  for (size_t b = 0; b < parents.size(); ++b) {
+    if (!mask[b])
+      continue;
+    // stop at the first ancestor already flagged, its own are too
+    for (int p = parents[b]; p >= 0 && !mask[p]; p = parents[p])
+      mask[p] = 1;
+  }
+}
+
+void finishBoneMask(const vector<int>& parents, BoneMask& mask) {
+  markAncestors(parents, mask.used);
+
+  vector<int> depth(parents.size(), 0);
+  mask.order.clear();
+  for (size_t b = 0; b < parents.size(); ++b) {
+    for (int p = parents[b]; p >= 0; p = parents[p])
+      ++depth[b];
+    if (mask.used[b])
+      mask.order.push_back(int(b));
+  }
+  stable_sort(mask.order.begin(), mask.order.end(), [&depth](int a, int b) { return depth[a] < depth[b]; });
+}
+
+void getBoneChain(const vector<int>& parents, int bone, vector<int>& chain) {
+  chain.clear();
+  for (int b = bone; b >= 0; b = parents[b])
+    chain.push_back(b);
+  reverse(chain.begin(), chain.end());
+}
+
+void evaluateBones(Skeleton& skeleton, const vector<int>& parents, const vector<int>& order,
+                   Matrix4 models[], Matrix4 bones[]) {
+  for (size_t i = 0; i < order.size(); ++i) {
+    const int b = order[i], p = parents[b];
+    const Bone* bone = skeleton.getNamedBone(b);
+    if (p >= 0)
+      composeRigidInto(models[p], bone->getTransform(), models[b]);
+    else
+      models[b] = rigTFormToMatrix(bone->getTransform());
+    multiplyAffineInto(models[b], bone->getOffset(), bones[b]);
+  }
+}
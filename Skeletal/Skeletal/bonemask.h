@@ -0,0 +1,43 @@
+#ifndef BONEMASK_H
+#define BONEMASK_H
+
+#include <vector>
+
+#include "matrix4.h"
+#include "vertexpnb.h"
+#include "Skeleton.h"
+
+//--------------------------------------------------------------------------------
+// Subsets of a skeleton's bones. A mesh only needs the bones its vertices
+// are weighted to and the ancestors those inherit their pose from; every
+// other bone can be left unsampled and unevaluated.
+//--------------------------------------------------------------------------------
+
+// Bones of a subset, both as flags indexed by bone name and as a list
+struct BoneMask {
+  std::vector<char> used;
+  std::vector<int> order;  // the used bones, parents first
+};
+
+// Flags the bones that any vertex weights with a nonzero weight, growing
+// mask as needed. Flags already set are kept.
+void markReferencedBones(const VertexPNB* vertices, int count, std::vector<char>& mask);
+
+// Flags the ancestors of every flagged bone. parents holds the parent name of
+// each bone, -1 for roots.
+void markAncestors(const std::vector<int>& parents, std::vector<char>& mask);
+
+// Completes `mask.used' with ancestors and lists its bones parents first
+void finishBoneMask(const std::vector<int>& parents, BoneMask& mask);
+
+// The bones from the root down to `bone', which is all an attachment to
+// that bone needs
+void getBoneChain(const std::vector<int>& parents, int bone, std::vector<int>& chain);
+
+// Bone matrices of the skeleton's bones in `order' (parents first), with
+// each parent's model matrix computed once. Other entries are left alone.
+// models is scratch space indexed by bone name.
+void evaluateBones(Skeleton& skeleton, const std::vector<int>& parents, const std::vector<int>& order,
+                   Matrix4 models[], Matrix4 bones[]);
+
+#endif
@@ -0,0 +1,70 @@
+#include <cmath>
+#include <algorithm>
+
+#include "bounds.h"
+
+using namespace std;
+
+void computeBoneBounds(const VertexPNB* vertices, int count, vector<Aabb>& bounds) {
+  bounds.clear();
+  for (int i = 0; i < count; ++i) {
+    const VertexPNB& v = vertices[i];
+    for (int j = 0; j < 3; ++j) {
+      if (v.bw[j] <= 0)
+        continue;
+      if (v.bn[j] >= int(bounds.size()))
+        bounds.resize(v.bn[j] + 1);
+      bounds[v.bn[j]].add(Cvec3(v.p[0], v.p[1], v.p[2]));
+    }
+  }
+}
+
+Aabb transformAabb(const Matrix4& m, const Aabb& b) {
+  // transform the center and project the half extents onto each axis
+  const Cvec3 c = b.getCenter(), e = (b.hi - b.lo) * 0.5;
+  Cvec3 tc, te;
+  for (int i = 0; i < 3; ++i) {
+    tc[i] = m(i, 3);
+    te[i] = 0;
+    for (int j = 0; j < 3; ++j) {
+      tc[i] += m(i, j) * c[j];
+      te[i] += abs(m(i, j)) * e[j];
+    }
+  }
+  return Aabb(tc - te, tc + te);
+}
+
+Aabb skinnedBounds(const vector<Aabb>& boneBounds, const Matrix4 bones[], int boneCount) {
+  Aabb result;
+  const int count = min((int) boneBounds.size(), boneCount);
+  for (int i = 0; i < count; ++i) {
+    if (!boneBounds[i].isEmpty())
+      result.add(transformAabb(bones[i], boneBounds[i]));
+  }
+  return result;
+}
+
+Frustum::Frustum(const Matrix4& m) {
+  // a point is inside when -w <= x, y, z <= w in clip space
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      planes_[2 * i][j] = m(3, j) + m(i, j);
+      planes_[2 * i + 1][j] = m(3, j) - m(i, j);
+    }
+  }
+}
+
+bool Frustum::isOutside(const Aabb& b) const {
+  if (b.isEmpty())
+    return true;
+  for (int i = 0; i < 6; ++i) {
+    const Cvec4& p = planes_[i];
+    // corner furthest along the plane normal
+    double d = p[3];
+    for (int j = 0; j < 3; ++j)
+      d += p[j] * (p[j] >= 0 ? b.hi[j] : b.lo[j]);
+    if (d < 0)
+      return true;
+  }
+  return false;
+}
@@ -0,0 +1,81 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <vector>
+#include <algorithm>
+
+#include "cvec.h"
+#include "matrix4.h"
+#include "vertexpnb.h"
+
+//--------------------------------------------------------------------------------
+// Bounds of skinned meshes without skinning their vertices. Every skinned
+// vertex is a convex combination of the vertex transformed by each of its
+// bones, so the union of each bone's bind space box, transformed by that
+// bone, bounds the whole posed mesh.
+//--------------------------------------------------------------------------------
+
+// Axis aligned box, empty when default constructed
+struct Aabb {
+  Cvec3 lo, hi;
+
+  Aabb() : lo(1e30), hi(-1e30) {}
+  Aabb(const Cvec3& lo, const Cvec3& hi) : lo(lo), hi(hi) {}
+
+  bool isEmpty() const {
+    return lo[0] > hi[0];
+  }
+
+  void add(const Cvec3& p) {
+    for (int i = 0; i < 3; ++i) {
+      lo[i] = std::min(lo[i], p[i]);
+      hi[i] = std::max(hi[i], p[i]);
+    }
+  }
+
+  void add(const Aabb& b) {
+    add(b.lo);
+    add(b.hi);
+  }
+
+  // Moves every face out by margin, leaving an empty box empty
+  void grow(double margin) {
+    if (isEmpty())
+      return;
+    lo -= Cvec3(margin);
+    hi += Cvec3(margin);
+  }
+
+  Cvec3 getCenter() const {
+    return (lo + hi) * 0.5;
+  }
+
+  // Radius of the bounding sphere about the center
+  double getRadius() const {
+    return norm(hi - lo) * 0.5;
+  }
+};
+
+// Box of the vertices each bone influences with a nonzero weight, indexed
+// by bone name. Bones that influence nothing get an empty box.
+void computeBoneBounds(const VertexPNB* vertices, int count, std::vector<Aabb>& bounds);
+
+// Box bounding the affine transform of a box
+Aabb transformAabb(const Matrix4& m, const Aabb& b);
+
+// Bounds of the mesh posed by the boneCount matrices of bones[], in
+// O(bones). Boxes of bones past boneCount are left out.
+Aabb skinnedBounds(const std::vector<Aabb>& boneBounds, const Matrix4 bones[], int boneCount);
+
+// The six clip planes of a view projection matrix
+class Frustum {
+  Cvec4 planes_[6];
+
+public:
+  explicit Frustum(const Matrix4& viewProj);
+
+  // Conservative: true only if the box is entirely outside one plane
+  bool isOutside(const Aabb& b) const;
+};
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef CHAINRIG_H
+#define CHAINRIG_H
+
+#include "rigtform.h"
+
+//--------------------------------------------------------------------------------
+// The procedural character's rig: three bones stacked along y over the
+// cylinder's height of 2. The app skins its surface to it, and the crowd
+// benchmark animates the same rig, so both measure one character.
+//--------------------------------------------------------------------------------
+
+static const int g_chainBoneCount = 3;
+
+// Bind pose of each bone relative to its parent, built at compile time
+static constexpr RigTForm g_chainBindPose[g_chainBoneCount] = {
+  RigTForm(), RigTForm(Cvec3(0.0, 2.0 / 3, 0.0)), RigTForm(Cvec3(0.0, 2.0 / 3, 0.0))
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef CONSTMATH_H
+#define CONSTMATH_H
+
+#include "cvec.h"
+
+//--------------------------------------------------------------------------------
+// Functions from <cmath> that can run at compile time, so rotations given by
+// literal angles can be built into constants. The angle is reduced exactly,
+// in degrees, to within 45 degrees of a multiple of 90, where the series
+// below are accurate to the last bit or so of a double.
+//--------------------------------------------------------------------------------
+
+constexpr double constAbs(const double x) {
+  return x < 0 ? -x : x;
+}
+
+// sin and cos of x in [-pi/4, pi/4]; the first omitted terms are below 1e-19
+constexpr double sinSeries(const double x) {
+  const double x2 = x * x;
+  double term = x, sum = x;
+  for (int k = 1; k <= 8; ++k) {
+    term *= -x2 * (1.0 / ((2 * k) * (2 * k + 1)));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr double cosSeries(const double x) {
+  const double x2 = x * x;
+  double term = 1, sum = 1;
+  for (int k = 1; k <= 8; ++k) {
+    term *= -x2 * (1.0 / ((2 * k - 1) * (2 * k)));
+    sum += term;
+  }
+  return sum;
+}
+
+// ang less a multiple of 360, exactly, for angles whose count of quarter
+// turns would not fit a long long. Doubles that large are integers, so ang
+// is halved down to 53 bits and the remainder doubled back up mod 360.
+constexpr double reduceDegrees(const double ang) {
+  if (constAbs(ang) < 1e15)
+    return ang;
+  double m = constAbs(ang);
+  int halvings = 0;
+  for (; m >= 9007199254740992.0; m *= 0.5)  // 2^53
+    ++halvings;
+  long long r = (long long) m % 360;
+  for (; halvings > 0; --halvings)
+    r = 2 * r % 360;
+  return ang < 0 ? -double(r) : double(r);
+}
+
+// sin of angle + 90 * quarters degrees, with the angle reduced before the
+// quarter turns are added so they cost no precision. NaN for infinite or
+// NaN angles, as std::sin.
+constexpr double sinQuarters(const double angle, const int quarters) {
+  if (!(angle - angle == 0))
+    return angle - angle;
+  const double ang = reduceDegrees(angle);
+  const double q = ang / 90;
+  const long long k = (long long) (q < 0 ? q - 0.5 : q + 0.5);
+  const double r = (ang - 90.0 * k) * (CS175_PI / 180);
+  switch ((((k + quarters) % 4) + 4) % 4) {
+    case 0: return sinSeries(r);
+    case 1: return cosSeries(r);
+    case 2: return -sinSeries(r);
+    default: return -cosSeries(r);
+  }
+}
+
+// sin and cos of an angle in degrees
+constexpr double sinDegrees(const double ang) {
+  return sinQuarters(ang, 0);
+}
+
+constexpr double cosDegrees(const double ang) {
+  return sinQuarters(ang, 1);
+}
+
+#endif
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "crowdbench.h"
+#include "animlod.h"
+#include "bonemask.h"
+#include "chainrig.h"
+#include "framearena.h"
+#include "geometrymaker.h"
+#include "skinweights.h"
+#include "sparseskin.h"
+
+using namespace std;
+
+namespace {
+
+enum CrowdStage { STAGE_SAMPLE, STAGE_BLEND, STAGE_PALETTES, STAGE_SKIN, STAGE_COUNT };
+
+const char* const STAGE_NAMES[STAGE_COUNT] = {"sample", "blend", "palettes", "skin"};
+
+// Seconds between frames, and between the clocks of neighbouring characters
+const double CROWDBENCH_FRAME_TIME = 1.0 / 60;
+const double CROWDBENCH_PHASE = 0.37;
+
+// A cylinder of height 2 around a chain of bones, each vertex weighted to
+// the two bones nearest its height. With 3 bones it is the procedural
+// surface's layout.
+struct ChainCylinderMaker {
+  int bones;
+
+  SmallVertex operator () (const SurfaceSample& p) const {
+    const float u = max(0.0f, min(p.t * bones - 0.5f, bones - 1.0f));
+    const int b0 = int(u), b1 = min(b0 + 1, bones - 1);
+    const float f = u - b0;
+    return SmallVertex(Cvec3f(0.4f*p.cosS, 2*p.t, 0.4f*p.sinS), Cvec3f(p.cosS, 0, p.sinS),
+                       Cvec<int, 3>(b0, b1, b1), Cvec3f(1 - f, f, 0));
+  }
+};
+
+// Bones stacked along y over a height of 2, like the procedural chain
+vector<RigTForm> makeChainBindPose(int bones) {
+  vector<RigTForm> bindPose(bones);
+  for (int b = 1; b < bones; ++b)
+    bindPose[b] = RigTForm(Cvec3(0, 2.0 / bones, 0));
+  return bindPose;
+}
+
+// Clip c swings every bone about z (even c) or x (odd c), each bone with its
+// own amplitude, over 2 + c / 2 seconds
+GltfAnimation makeChainClip(int bones, int c) {
+  static const double phases[] = {0, 1, 0, -1, 0};
+  GltfAnimation clip;
+  clip.name = "chain";
+  clip.duration = 2 + 0.5 * c;
+  for (int b = 0; b < bones; ++b) {
+    GltfChannel ch;
+    ch.bone = b;
+    ch.rotation = true;
+    ch.step = false;
+    const double amplitude = 10 + (7 * b + 11 * c) % 25;  // degrees
+    for (int k = 0; k < 5; ++k) {
+      const double ang = phases[k] * amplitude;
+      const Quat q = c % 2 ? Quat::makeXRotation(ang) : Quat::makeZRotation(ang);
+      ch.times.push_back(float(clip.duration * k / 4));
+      ch.values.push_back(Cvec4(q[0], q[1], q[2], q[3]));
+    }
+    clip.channels.push_back(ch);
+  }
+  return clip;
+}
+
+// Runs the crowd on the chain of boneCount bones whose bind pose is given
+void runCrowd(const char* name, const RigTForm bindPose[], int boneCount, const CrowdBenchConfig& config) {
+  typedef chrono::steady_clock Clock;
+  const int n = config.meshSize, characters = config.characters, clipCount = config.clips;
+  // the peak of this run alone where the platform can restart it
+  const bool runPeak = resetPeakResidentBytes();
+
+  Skeleton skeleton;
+  Bone* added = NULL;
+  for (int b = 0; b < boneCount; ++b)
+    added = skeleton.addBone(b, added, bindPose[b]);
+  int vbLen, ibLen;
+  getSurfaceVbIbLen(n, true, n, false, vbLen, ibLen);
+  vector<VertexPNB> vtx(vbLen);
+  vector<unsigned short> idx(ibLen);
+  const ChainCylinderMaker maker = {boneCount};
+  makeSurfaceParallel(0.0, 2*CS175_PI/n, n, true, 0.0, 1.0/n, n, false, maker, vtx.begin(), idx.begin());
+  pruneInfluences(vtx);
+
+  SkinWeightsCsr csr;
+  SkinInput input;
+  buildSkinWeightsCsr(&vtx[0], vbLen, csr);
+  buildSkinInput(&vtx[0], vbLen, input);
+  BoneMask mask;
+  vector<int> parents;
+  markReferencedBones(&vtx[0], vbLen, mask.used);
+  skeleton.getParentNames(parents);
+  finishBoneMask(parents, mask);
+  AnimRig rig;
+  buildAnimRig(skeleton, mask, rig);
+  vector<GltfAnimation> clips;
+  for (int c = 0; c < clipCount; ++c)
+    clips.push_back(makeChainClip(boneCount, c));
+
+  FrameArena arena(1 << 20);
+  double stageNs[STAGE_COUNT] = {};
+  long long allocations = 0, warmUpAllocations = 0;
+  for (int frame = 0; frame <= config.frames; ++frame) {
+    const long long heapBefore = getHeapAllocationCount();
+    const double time = frame * CROWDBENCH_FRAME_TIME;
+    RigTForm* sampledA = arena.allocate<RigTForm>(characters * boneCount);
+    RigTForm* sampledB = arena.allocate<RigTForm>(characters * boneCount);
+    RigTForm* blended = arena.allocate<RigTForm>(characters * boneCount);
+    Matrix4* models = arena.allocate<Matrix4>(boneCount);
+    Matrix4* bones = arena.allocate<Matrix4>(boneCount);
+    float* palettes = arena.allocate<float>(boneCount * characters * SKIN_PALETTE_STRIDE);
+    float* positions = arena.allocate<float>(3 * vbLen * characters);
+    float* normals = arena.allocate<float>(3 * vbLen * characters);
+
+    // each character plays clips i and i + 1 from its own clock
+    Clock::time_point marks[STAGE_COUNT + 1];
+    marks[0] = Clock::now();
+    for (int i = 0; i < characters; ++i) {
+      RigTForm* a = sampledA + i * boneCount;
+      RigTForm* b = sampledB + i * boneCount;
+      for (size_t j = 0; j < rig.order.size(); ++j)
+        a[rig.order[j]] = b[rig.order[j]] = rig.rest[rig.order[j]];
+      const GltfAnimation& clipA = clips[i % clipCount];
+      const GltfAnimation& clipB = clips[(i + 1) % clipCount];
+      const double t = time + CROWDBENCH_PHASE * i;
+      sampleGltfAnimation(clipA, fmod(t, clipA.duration), rig.masks[0], true, a);
+      sampleGltfAnimation(clipB, fmod(t, clipB.duration), rig.masks[0], true, b);
+    }
+    marks[1] = Clock::now();
+
+    for (int i = 0; i < characters; ++i)
+      blendPoses(rig, sampledA + i * boneCount, sampledB + i * boneCount, 0.5 + 0.5 * sin(time + i),
+                 blended + i * boneCount);
+    marks[2] = Clock::now();
+
+    // palettes as the interleaved block skinCsrBatch takes
+    for (int i = 0; i < characters; ++i) {
+      evaluateAnimRig(rig, blended + i * boneCount, models, bones);
+      for (size_t j = 0; j < rig.order.size(); ++j) {
+        const int bone = rig.order[j];
+        float* dst = palettes + bone * SKIN_PALETTE_STRIDE * characters + i;
+        for (int k = 0; k < SKIN_PALETTE_STRIDE; ++k)
+          dst[k * characters] = float(bones[bone][k]);
+      }
+    }
+    marks[3] = Clock::now();
+
+    // the whole crowd in one batch: each vertex's weights are loaded once for
+    // all characters, which runs 2-3 times faster here than skinCsr per
+    // character
+    skinCsrBatch(csr, input, palettes, characters, positions, normals);
+    marks[4] = Clock::now();
+
+    arena.reset();
+    const long long frameAllocations = getHeapAllocationCount() - heapBefore;
+    // the warm up frame grows the arena to fit and is not counted
+    if (frame == 0) {
+      warmUpAllocations = frameAllocations;
+      continue;
+    }
+    allocations += frameAllocations;
+    for (int s = 0; s < STAGE_COUNT; ++s)
+      stageNs[s] += chrono::duration<double, nano>(marks[s + 1] - marks[s]).count();
+  }
+
+  const double frames = config.frames;
+  double frameNs = 0;
+  cout << name << ": " << characters << " characters of " << boneCount << " bones, " << clipCount << " clips, "
+       << vbLen << " vertices, " << config.frames << " frames" << endl << " ";
+  for (int s = 0; s < STAGE_COUNT; ++s) {
+    frameNs += stageNs[s];
+    cout << " " << STAGE_NAMES[s] << " " << stageNs[s] / frames / 1e6 << " ms" << (s + 1 < STAGE_COUNT ? "," : " per frame");
+  }
+  cout << endl << "  " << 1e9 * frames / frameNs << " frames/s, " << 1e9 * frames * characters / frameNs
+       << " characters/s, " << allocations / frames << " heap allocations per frame (" << warmUpAllocations
+       << " in the warm up frame)" << endl;
+  cout << "  Peak resident set: " << getPeakResidentBytes() / (1024.0 * 1024.0) << " MB"
+       << (runPeak ? "" : " (of the process so far)") << endl;
+}
+
+} // namespace
+
+void benchCrowd(const CrowdBenchConfig& config) {
+  const vector<RigTForm> generated = makeChainBindPose(config.bones);
+  runCrowd("Generated chain", &generated[0], config.bones, config);
+  runCrowd("3 bone chain", g_chainBindPose, g_chainBoneCount, config);
+}
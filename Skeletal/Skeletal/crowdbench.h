@@ -0,0 +1,27 @@
+#ifndef CROWDBENCH_H
+#define CROWDBENCH_H
+
+//--------------------------------------------------------------------------------
+// Headless crowd benchmark: the whole CPU side of animating a crowd, with no
+// window and no GPU. Every frame, each character samples two clips, blends
+// them, computes its palette, and the crowd is skinned on the CPU. The
+// timings it reports are the figure of merit for changes to that path.
+//--------------------------------------------------------------------------------
+
+struct CrowdBenchConfig {
+  int characters;  // N
+  int bones;       // B, of the generated rig
+  int clips;       // M, generated for each rig
+  int frames;      // frames run after a warm up frame
+  int meshSize;    // the cylinder has meshSize x meshSize quads
+};
+
+static const CrowdBenchConfig CROWDBENCH_DEFAULTS = {100, 64, 4, 200, 32};
+
+// Runs the frames on a generated chain of config.bones bones, then on the
+// app's own 3 bone rig (chainrig.h), and prints for each the time of every stage,
+// frames and characters per second, the heap allocations per frame and the
+// peak resident set of that run
+void benchCrowd(const CrowdBenchConfig& config);
+
+#endif
@@ -7,47 +7,45 @@
 
 using namespace std;
 
-static const double CS175_PI = 3.14159265358979323846264338327950288;
-static const double CS175_EPS = 1e-8;
-static const double CS175_EPS2 = CS175_EPS * CS175_EPS;
-static const double CS175_EPS3 = CS175_EPS * CS175_EPS * CS175_EPS;
+static constexpr double CS175_PI = 3.14159265358979323846264338327950288;
+static constexpr double CS175_EPS = 1e-8;
+static constexpr double CS175_EPS2 = CS175_EPS * CS175_EPS;
+static constexpr double CS175_EPS3 = CS175_EPS * CS175_EPS * CS175_EPS;
 
 
+// Every operation that needs no sqrt is constexpr, so vectors can be
+// constants built at compile time
 template <typename T, int n>
 class Cvec {
   T d_[n];
 
 public:
-  Cvec() {
-    for (int i = 0; i < n; ++i) {
-      d_[i] = 0;
-    }
-  }
+  constexpr Cvec() : d_() {}
 
-  Cvec(const T& t) {
+  constexpr Cvec(const T& t) : d_() {
     for (int i = 0; i < n; ++i) {
       d_[i] = t;
     }
   }
 
-  Cvec(const T& t0, const T& t1) {
+  constexpr Cvec(const T& t0, const T& t1) : d_() {
     assert(n == 2); // better to use static_assert from c++11
     d_[0] = t0, d_[1] = t1;
   }
 
-  Cvec(const T& t0, const T& t1, const T& t2) {
+  constexpr Cvec(const T& t0, const T& t1, const T& t2) : d_() {
     assert(n == 3); // better to use static_assert from c++11
     d_[0] = t0, d_[1] = t1, d_[2] = t2;
   }
 
-  Cvec(const T& t0, const T& t1, const T& t2, const T& t3) {
+  constexpr Cvec(const T& t0, const T& t1, const T& t2, const T& t3) : d_() {
     assert(n == 4); // better to use static_assert from c++11
     d_[0] = t0, d_[1] = t1, d_[2] = t2, d_[3] = t3;
   }
 
   // either truncate if m < n, or extend with extendValue
   template<int m>
-  explicit Cvec(const Cvec<T, m>& v, const T& extendValue = T(0)) {
+  constexpr explicit Cvec(const Cvec<T, m>& v, const T& extendValue = T(0)) : d_() {
     for (int i = 0; i < std::min(m, n); ++i) {
       d_[i] = v[i];
     }
@@ -56,48 +54,48 @@ public:
     }
   }
 
-  T& operator [] (const int i) {
+  constexpr T& operator [] (const int i) {
     return d_[i];
   }
 
-  const T& operator [] (const int i) const {
+  constexpr const T& operator [] (const int i) const {
     return d_[i];
   }
 
-  T& operator () (const int i) {
+  constexpr T& operator () (const int i) {
     return d_[i];
   }
 
-  const T& operator () (const int i) const {
+  constexpr const T& operator () (const int i) const {
     return d_[i];
   }
 
-  Cvec operator - () const {
+  constexpr Cvec operator - () const {
     return Cvec(*this) *= -1;
   }
 
-  Cvec& operator += (const Cvec& v) {
+  constexpr Cvec& operator += (const Cvec& v) {
     for (int i = 0; i < n; ++i) {
       d_[i] += v[i];
     }
     return *this;
   }
 
-  Cvec& operator -= (const Cvec& v) {
+  constexpr Cvec& operator -= (const Cvec& v) {
     for (int i = 0; i < n; ++i) {
       d_[i] -= v[i];
     }
     return *this;
   }
 
-  Cvec& operator *= (const T a) {
+  constexpr Cvec& operator *= (const T a) {
     for (int i = 0; i < n; ++i) {
       d_[i] *= a;
     }
     return *this;
   }
 
-  Cvec& operator /= (const T a) {
+  constexpr Cvec& operator /= (const T a) {
     const T inva(1/a);
     for (int i = 0; i < n; ++i) {
       d_[i] *= inva;
@@ -105,19 +103,19 @@ public:
     return *this;
   }
 
-  Cvec operator + (const Cvec& v) const {
+  constexpr Cvec operator + (const Cvec& v) const {
     return Cvec(*this) += v;
   }
 
-  Cvec operator - (const Cvec& v) const {
+  constexpr Cvec operator - (const Cvec& v) const {
     return Cvec(*this) -= v;
   }
 
-  Cvec operator * (const T a) const {
+  constexpr Cvec operator * (const T a) const {
     return Cvec(*this) *= a;
   }
 
-  Cvec operator / (const T a) const {
+  constexpr Cvec operator / (const T a) const {
     return Cvec(*this) /= a;
   }
 
@@ -129,12 +127,12 @@ public:
 };
 
 template<typename T>
-inline Cvec<T,3> cross(const Cvec<T,3>& a, const Cvec<T,3>& b) {
+constexpr Cvec<T,3> cross(const Cvec<T,3>& a, const Cvec<T,3>& b) {
   return Cvec<T,3>(a(1)*b(2)-a(2)*b(1), a(2)*b(0)-a(0)*b(2), a(0)*b(1)-a(1)*b(0));
 }
 
 template<typename T, int n>
-inline T dot(const Cvec<T,n>& a, const Cvec<T,n>& b) {
+constexpr T dot(const Cvec<T,n>& a, const Cvec<T,n>& b) {
   T r(0);
   for (int i = 0; i < n; ++i) {
     r += a(i)*b(i);
@@ -143,7 +141,7 @@ inline T dot(const Cvec<T,n>& a, const Cvec<T,n>& b) {
 }
 
 template<typename T, int n>
-inline T norm2(const Cvec<T, n>& v) {
+constexpr T norm2(const Cvec<T, n>& v) {
   return dot(v, v);
 }
 
@@ -0,0 +1,41 @@
+#ifndef CYLINDER_H
+#define CYLINDER_H
+
+#include <cmath>
+
+#include "cvec.h"
+#include "geometrymaker.h"
+
+//--------------------------------------------------------------------------------
+// The procedural character's surface: a cylinder of radius 0.4 and height 2
+// skinned to three bones, as the functions of s and t makeSurface takes and
+// as the single functor of makeSurfaceParallel. The app draws it, and the
+// geometry and skinning benchmarks time it.
+//--------------------------------------------------------------------------------
+
+inline Cvec3f makeCylinderV(float s,float t) { return Cvec3f(0.4*cos(s),2*t,0.4*sin(s)); }
+inline Cvec3f makeCylinderN(float s,float t) { return Cvec3f(cos(s),0.0,sin(s)); }
+inline Cvec<int, 3> makeCylinderBN(float s, float t) { return Cvec<int, 3>(0, 1, 2); }
+inline Cvec3f makeCylinderBW(float s,float t) 
+{
+	if (t < 1.0 / 4)
+		return Cvec3f(1.0, 0.0, 0.0);
+	if (t < 5.0 / 12)
+		return Cvec3f(2.5 - 6 * t, -1.5 + 6 * t, 0.0);
+	if (t < 7.0 / 12)
+		return Cvec3f(0.0, 1.0, 0.0);
+	if (t < 3.0 / 4)
+		return Cvec3f(0.0, 4.5 - 6 * t, -3.5 + 6 * t);
+	return Cvec3f(0.0, 0.0, 1.0);
+}
+
+// The cylinder as a single functor for makeSurfaceParallel: the cos/sin of
+// the ring come from the sample and the call is inlined into the generator
+struct CylinderMaker {
+  SmallVertex operator () (const SurfaceSample& p) const {
+    return SmallVertex(Cvec3f(0.4f*p.cosS, 2*p.t, 0.4f*p.sinS), Cvec3f(p.cosS, 0, p.sinS),
+                       Cvec<int, 3>(0, 1, 2), makeCylinderBW(p.s, p.t));
+  }
+};
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef FIXEDSKELETON_H
+#define FIXEDSKELETON_H
+
+#include <type_traits>
+#include <stdexcept>
+#include <vector>
+
+#include "fusedmath.h"
+#include "matrix4.h"
+#include "rigtform.h"
+#include "Skeleton.h"
+
+//--------------------------------------------------------------------------------
+// Skeleton whose topology is fixed at compile time by its parent table, one
+// template argument per bone (-1 for roots), parents listed before their
+// children. Evaluation is unrolled bone by bone with the parent of each one
+// a constant, so there are no parent pointers to chase and nothing to check
+// at run time. It writes the same bone matrices as Skeleton, so it can feed
+// the same palettes.
+//
+//   typedef FixedSkeleton<-1, 0, 1> ChainSkeleton;  // the procedural 3 bone chain
+//--------------------------------------------------------------------------------
+
+// Whether every parent comes before its child
+template <int N>
+constexpr bool fixedParentsFirst(const int (&parents)[N]) {
+  for (int i = 0; i < N; ++i) {
+    if (parents[i] < -1 || parents[i] >= i)
+      return false;
+  }
+  return true;
+}
+
+template <int... Parents>
+class FixedSkeleton {
+public:
+  static const int BONE_COUNT = sizeof...(Parents);
+
+private:
+  static constexpr int parents_[BONE_COUNT] = {Parents...};
+  static_assert(fixedParentsFirst(parents_), "FixedSkeleton needs parents listed before their children");
+
+  RigTForm transforms_[BONE_COUNT];
+  Matrix4 offsets_[BONE_COUNT];
+
+  template <int B>
+  void evaluateFrom(Matrix4 models[], Matrix4 bones[], std::integral_constant<int, B>) const {
+    const int parent = parents_[B];
+    // the branch not taken is folded away
+    if (parent >= 0)
+      composeRigidInto(models[parent >= 0 ? parent : 0], transforms_[B], models[B]);
+    else
+      models[B] = rigTFormToMatrix(transforms_[B]);
+    multiplyAffineInto(models[B], offsets_[B], bones[B]);
+    evaluateFrom(models, bones, std::integral_constant<int, B + 1>());
+  }
+
+  void evaluateFrom(Matrix4[], Matrix4[], std::integral_constant<int, BONE_COUNT>) const {}
+
+public:
+  // All bones at the identity, with identity offsets
+  FixedSkeleton() {}
+
+  // Bones at the given local transforms, which are also the bind pose: each
+  // offset is the inverse of the bone's model matrix, as for Bone
+  explicit FixedSkeleton(const RigTForm transforms[]) {
+    for (int b = 0; b < BONE_COUNT; ++b)
+      transforms_[b] = transforms[b];
+    Matrix4 models[BONE_COUNT], bones[BONE_COUNT];
+    evaluate(models, bones);
+    for (int b = 0; b < BONE_COUNT; ++b)
+      offsets_[b] = inv(models[b]);
+  }
+
+  static constexpr int getParent(int bone) {
+    return parents_[bone];
+  }
+
+  void setRotate(int bone, const Quat& rotation) {
+    transforms_[bone].setRotation(rotation);
+  }
+
+  void setTranslate(int bone, const Cvec3& translation) {
+    transforms_[bone].setTranslation(translation);
+  }
+
+  void setOffset(int bone, const Matrix4& offset) {
+    offsets_[bone] = offset;
+  }
+
+  const RigTForm& getTransform(int bone) const {
+    return transforms_[bone];
+  }
+
+  // Takes the transforms and offsets of a Skeleton with the same topology.
+  // Throws runtime_error when the parent tables differ.
+  void copyFrom(Skeleton& skeleton) {
+    std::vector<int> parents;
+    skeleton.getParentNames(parents);
+    if (int(parents.size()) != BONE_COUNT)
+      throw std::runtime_error("Skeleton does not have the bone count of the fixed skeleton");
+    for (int b = 0; b < BONE_COUNT; ++b) {
+      if (parents[b] != parents_[b])
+        throw std::runtime_error("Skeleton does not have the topology of the fixed skeleton");
+      const Bone* bone = skeleton.getNamedBone(b);
+      transforms_[b] = bone->getTransform();
+      offsets_[b] = bone->getOffset();
+    }
+  }
+
+  // Writes the model matrix and the bone matrix (model matrix times
+  // offset) of every bone
+  void evaluate(Matrix4 models[], Matrix4 bones[]) const {
+    evaluateFrom(models, bones, std::integral_constant<int, 0>());
+  }
+};
+
+template <int... Parents>
+constexpr int FixedSkeleton<Parents...>::parents_[FixedSkeleton<Parents...>::BONE_COUNT];
+
+template <int... Parents>
+const int FixedSkeleton<Parents...>::BONE_COUNT;
+
+#endif
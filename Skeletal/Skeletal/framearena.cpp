@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <cstdio>
+
+#ifdef _WIN32
+# define WIN32_LEAN_AND_MEAN
+# include <windows.h>
+# include <psapi.h>
+# pragma comment(lib, "psapi.lib")
+#else
+# include <sys/resource.h>
+#endif
+
+#include "framearena.h"
+
+using namespace std;
+
+static const size_t ARENA_ALIGNMENT = 16;
+
+static size_t alignUp(size_t bytes) {
+  return (bytes + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+// operator new[] returns memory aligned for any fundamental type, 16 bytes
+// on the platforms we build for
+FrameArena::FrameArena(size_t capacity)
+  : base_(new char[alignUp(capacity)]), capacity_(alignUp(capacity)), used_(0), peak_(0), overflowBytes_(0) {}
+
+FrameArena::~FrameArena() {
+  reset();
+  delete[] base_;
+}
+
+void* FrameArena::allocateBytes(size_t bytes) {
+  bytes = alignUp(bytes);
+  void* p;
+  if (used_ + bytes <= capacity_) {
+    p = base_ + used_;
+    used_ += bytes;
+  }
+  else {
+    overflow_.push_back(new char[bytes]);
+    overflowBytes_ += bytes;
+    p = overflow_.back();
+  }
+  peak_ = max(peak_, getUsed());
+  return p;
+}
+
+void FrameArena::reset() {
+  if (!overflow_.empty()) {
+    for (size_t i = 0; i < overflow_.size(); ++i)
+      delete[] overflow_[i];
+    overflow_.clear();
+
+    // fit the largest frame so far, with some room to spare
+    delete[] base_;
+    capacity_ = alignUp(max(2 * capacity_, peak_ + peak_ / 2));
+    base_ = new char[capacity_];
+  }
+  used_ = 0;
+  overflowBytes_ = 0;
+}
+
+size_t getPeakResidentBytes() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return counters.PeakWorkingSetSize;
+  return 0;
+#else
+# ifdef __linux__
+  // VmHWM follows resetPeakResidentBytes, where ru_maxrss does not
+  if (FILE* status = fopen("/proc/self/status", "r")) {
+    char line[128];
+    unsigned long kb = 0;
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), status))
+      found = sscanf(line, "VmHWM: %lu kB", &kb) == 1;
+    fclose(status);
+    if (found)
+      return size_t(kb) * 1024;
+  }
+# endif
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+# ifdef __APPLE__
+  return size_t(usage.ru_maxrss);
+# else
+  return size_t(usage.ru_maxrss) * 1024;  // in kilobytes
+# endif
+#endif
+}
+
+bool resetPeakResidentBytes() {
+#ifdef __linux__
+  // 5 resets the peak resident set of the process, since Linux 4.0
+  FILE* clearRefs = fopen("/proc/self/clear_refs", "w");
+  if (!clearRefs)
+    return false;
+  const bool written = fputs("5", clearRefs) >= 0;
+  return fclose(clearRefs) == 0 && written;
+#else
+  return false;
+#endif
+}
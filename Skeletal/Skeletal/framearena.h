@@ -0,0 +1,75 @@
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+#include <type_traits>
+
+//--------------------------------------------------------------------------------
+// Linear allocator for the temporaries of one frame: poses, blend scratch
+// space, palettes. Allocations bump a pointer and are all released at once
+// by reset() at the end of the frame. A frame that outgrows the arena is
+// served from extra heap blocks, and the next reset() grows the arena to
+// fit, so steady state frames never touch the heap.
+//--------------------------------------------------------------------------------
+
+class FrameArena {
+  char* base_;
+  size_t capacity_, used_, peak_;
+  std::vector<char*> overflow_;  // blocks of the frame that outgrew the arena
+  size_t overflowBytes_;
+
+  void* allocateBytes(size_t bytes);
+
+  FrameArena(const FrameArena&);
+  FrameArena& operator = (const FrameArena&);
+
+public:
+  explicit FrameArena(size_t capacity);
+  ~FrameArena();
+
+  // count default constructed T's, valid until the next reset(). T must not
+  // need its destructor run.
+  template <class T>
+  T* allocate(size_t count) {
+    static_assert(std::is_trivially_destructible<T>::value, "FrameArena never runs destructors");
+    static_assert(alignof(T) <= 16, "FrameArena aligns to 16 bytes");
+    T* p = static_cast<T*>(allocateBytes(count * sizeof(T)));
+    for (size_t i = 0; i < count; ++i)
+      new (p + i) T();
+    return p;
+  }
+
+  // Releases everything allocated since the last reset
+  void reset();
+
+  size_t getUsed() const {
+    return used_ + overflowBytes_;
+  }
+
+  size_t getPeak() const {
+    return peak_;
+  }
+
+  size_t getCapacity() const {
+    return capacity_;
+  }
+};
+
+// Number of calls to the global operator new so far. heapcount.h defines
+// it, with the counting operator new and delete, in the executable's main
+// file.
+long long getHeapAllocationCount();
+
+// Largest resident set (working set on Windows) of the process so far, or
+// since the last resetPeakResidentBytes(), in bytes, or 0 where the platform
+// does not tell
+size_t getPeakResidentBytes();
+
+// Restarts getPeakResidentBytes() from the current resident set, so that a
+// stage can be measured on its own. Returns false where the platform keeps
+// only the peak of the whole process (Windows, macOS).
+bool resetPeakResidentBytes();
+
+#endif
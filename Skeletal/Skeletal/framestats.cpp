@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include "framestats.h"
+
+using namespace std;
+
+namespace {
+
+// Nearest rank percentiles of the first count values, which are reordered
+void getPercentiles(vector<double>& values, int count, double out[]) {
+  for (int p = 0; p < FRAMESTATS_PERCENTILE_COUNT; ++p) {
+    if (count == 0) {
+      out[p] = 0;
+      continue;
+    }
+    const int rank = max(0, min(count - 1, int(FRAMESTATS_PERCENTILES[p] / 100 * count + 0.5) - 1));
+    nth_element(values.begin(), values.begin() + rank, values.begin() + count);
+    out[p] = values[rank];
+  }
+}
+
+} // namespace
+
+FrameStats::FrameStats(int window)
+  : window_(window), frames_(0), gpuFrames_(0), cpuMs_(window), gpuMs_(window), counters_(window), sorted_(window) {}
+
+void FrameStats::addFrame(double cpuMs, const FrameCounters& counters) {
+  cpuMs_[frames_ % window_] = cpuMs;
+  counters_[frames_ % window_] = counters;
+  ++frames_;
+}
+
+void FrameStats::addGpuFrame(double gpuMs) {
+  gpuMs_[gpuFrames_ % window_] = gpuMs;
+  ++gpuFrames_;
+}
+
+FrameStatsSummary FrameStats::summarize() const {
+  FrameStatsSummary s;
+  s.frames = (int) min<long long>(frames_, window_);
+  s.gpuFrames = (int) min<long long>(gpuFrames_, window_);
+  copy(cpuMs_.begin(), cpuMs_.begin() + s.frames, sorted_.begin());
+  getPercentiles(sorted_, s.frames, s.cpuMs);
+  copy(gpuMs_.begin(), gpuMs_.begin() + s.gpuFrames, sorted_.begin());
+  getPercentiles(sorted_, s.gpuFrames, s.gpuMs);
+
+  s.drawCalls = s.uniformUploads = s.bytesUploaded = s.bonesEvaluated = s.verticesSkinned = 0;
+  for (int i = 0; i < s.frames; ++i) {
+    const FrameCounters& c = counters_[i];
+    s.drawCalls += c.drawCalls;
+    s.uniformUploads += c.uniformUploads;
+    s.bytesUploaded += c.bytesUploaded;
+    s.bonesEvaluated += c.bonesEvaluated;
+    s.verticesSkinned += c.verticesSkinned;
+  }
+  if (s.frames > 0) {
+    const double frames = s.frames;
+    s.drawCalls /= frames;
+    s.uniformUploads /= frames;
+    s.bytesUploaded /= frames;
+    s.bonesEvaluated /= frames;
+    s.verticesSkinned /= frames;
+  }
+  return s;
+}
+
+void formatFrameStats(const FrameStatsSummary& s, vector<string>& lines) {
+  lines.clear();
+  ostringstream line;
+  line.setf(ios::fixed);
+  line.precision(2);
+  line << "CPU ms p50/p95/p99  " << s.cpuMs[FRAMESTATS_P50] << " / " << s.cpuMs[FRAMESTATS_P95] << " / "
+       << s.cpuMs[FRAMESTATS_P99] << "  (" << s.frames << " frames)";
+  lines.push_back(line.str());
+  line.str("");
+  if (s.gpuFrames > 0)
+    line << "GPU ms p50/p95/p99  " << s.gpuMs[FRAMESTATS_P50] << " / " << s.gpuMs[FRAMESTATS_P95] << " / "
+         << s.gpuMs[FRAMESTATS_P99];
+  else
+    line << "GPU ms  no timer queries";
+  lines.push_back(line.str());
+  line.str("");
+  line.precision(1);
+  line << "Draw calls " << s.drawCalls << "  uniforms " << s.uniformUploads << "  uploaded "
+       << s.bytesUploaded / 1024 << " KB";
+  lines.push_back(line.str());
+  line.str("");
+  line << "Bones evaluated " << s.bonesEvaluated << "  vertices skinned " << s.verticesSkinned;
+  lines.push_back(line.str());
+}
+
+FrameStatsLog::FrameStatsLog(const char* filename)
+  : file_(filename) {
+  if (!file_)
+    throw runtime_error(string("Cannot write frame statistics ") + filename);
+  const size_t length = strlen(filename);
+  json_ = length >= 5 && strcmp(filename + length - 5, ".json") == 0;
+  if (!json_)
+    file_ << "seconds,frames,cpu_p50_ms,cpu_p95_ms,cpu_p99_ms,gpu_p50_ms,gpu_p95_ms,gpu_p99_ms,"
+          << "draw_calls,uniform_uploads,bytes_uploaded,bones_evaluated,vertices_skinned" << endl;
+}
+
+void FrameStatsLog::write(double seconds, const FrameStatsSummary& s) {
+  if (json_) {
+    file_ << "{\"seconds\": " << seconds << ", \"frames\": " << s.frames
+          << ", \"cpuMs\": [" << s.cpuMs[0] << ", " << s.cpuMs[1] << ", " << s.cpuMs[2] << "]";
+    if (s.gpuFrames > 0)
+      file_ << ", \"gpuMs\": [" << s.gpuMs[0] << ", " << s.gpuMs[1] << ", " << s.gpuMs[2] << "]";
+    file_ << ", \"drawCalls\": " << s.drawCalls << ", \"uniformUploads\": " << s.uniformUploads
+          << ", \"bytesUploaded\": " << s.bytesUploaded << ", \"bonesEvaluated\": " << s.bonesEvaluated
+          << ", \"verticesSkinned\": " << s.verticesSkinned << "}" << endl;
+  }
+  else {
+    file_ << seconds << "," << s.frames << "," << s.cpuMs[0] << "," << s.cpuMs[1] << "," << s.cpuMs[2];
+    for (int p = 0; p < FRAMESTATS_PERCENTILE_COUNT; ++p) {
+      file_ << ",";
+      if (s.gpuFrames > 0)
+        file_ << s.gpuMs[p];
+    }
+    file_ << "," << s.drawCalls << "," << s.uniformUploads << "," << s.bytesUploaded << "," << s.bonesEvaluated
+          << "," << s.verticesSkinned << endl;
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+//--------------------------------------------------------------------------------
+// Frame statistics: CPU and GPU frame time percentiles over a sliding window
+// of frames, next to the work counters of those frames. Summaries feed the
+// on-screen overlay and a log file, so that the cost of a scene can be read
+// off instead of guessed. Nothing here uses GL; the caller measures.
+//--------------------------------------------------------------------------------
+
+// What one frame did
+struct FrameCounters {
+  int drawCalls;
+  int uniformUploads;
+  long long bytesUploaded;     // uniforms and buffer data
+  int bonesEvaluated;
+  long long verticesSkinned;   // vertices of the skinned meshes drawn, all instances
+};
+
+enum FrameStatsPercentile { FRAMESTATS_P50, FRAMESTATS_P95, FRAMESTATS_P99, FRAMESTATS_PERCENTILE_COUNT };
+
+static const double FRAMESTATS_PERCENTILES[FRAMESTATS_PERCENTILE_COUNT] = {50, 95, 99};
+
+struct FrameStatsSummary {
+  int frames;                                      // in the window
+  double cpuMs[FRAMESTATS_PERCENTILE_COUNT];
+  int gpuFrames;                                   // 0 without timer queries
+  double gpuMs[FRAMESTATS_PERCENTILE_COUNT];
+  // per frame means
+  double drawCalls, uniformUploads, bytesUploaded, bonesEvaluated, verticesSkinned;
+};
+
+class FrameStats {
+  int window_;
+  long long frames_, gpuFrames_;
+  std::vector<double> cpuMs_, gpuMs_;      // rings of the last window_ frames
+  std::vector<FrameCounters> counters_;
+  mutable std::vector<double> sorted_;
+
+public:
+  explicit FrameStats(int window);
+
+  void addFrame(double cpuMs, const FrameCounters& counters);
+
+  // GPU times arrive frames late, when their timer query is ready, so they
+  // are kept apart from the frames they belong to
+  void addGpuFrame(double gpuMs);
+
+  FrameStatsSummary summarize() const;
+};
+
+// The summary as lines of text, for the overlay
+void formatFrameStats(const FrameStatsSummary& summary, std::vector<std::string>& lines);
+
+// Appends summaries to a file, as CSV with a header line, or as one JSON
+// object per line when the file name ends in .json
+class FrameStatsLog {
+  std::ofstream file_;
+  bool json_;
+
+public:
+  // Throws runtime_error when the file cannot be written
+  explicit FrameStatsLog(const char* filename);
+
+  void write(double seconds, const FrameStatsSummary& summary);
+};
+
+#endif
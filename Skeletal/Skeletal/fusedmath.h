@@ -0,0 +1,80 @@
+#ifndef FUSEDMATH_H
+#define FUSEDMATH_H
+
+#include <cassert>
+
+#include "cvec.h"
+#include "matrix4.h"
+#include "quat.h"
+#include "rigtform.h"
+
+//--------------------------------------------------------------------------------
+// Fused versions of the matrix expressions on the animation and upload
+// paths, for the affine transforms the skeleton produces: they skip the
+// last row, which is [0, 0, 0, 1], and write their result straight to its
+// destination. General 4x4 products have no fused form; math_bench times
+// Matrix4::operator * at least as fast as one writing through a reference.
+//
+// Cvec gets no fused forms. Its operators copy *this too, but a Cvec3 is 24
+// bytes that the compiler keeps in registers: -bench-fused times a pose blend
+// written with the operators against the same blend a component at a time,
+// and the operators are at least as fast.
+//--------------------------------------------------------------------------------
+
+// out = a * b for affine a and b, in 36 multiplies instead of 64. out may
+// be a, but not b.
+inline void multiplyAffineInto(const Matrix4& a, const Matrix4& b, Matrix4& out) {
+  assert(isAffine(a) && isAffine(b));
+  for (int i = 0; i < 3; ++i) {
+    const double a0 = a(i, 0), a1 = a(i, 1), a2 = a(i, 2), a3 = a(i, 3);
+    for (int k = 0; k < 3; ++k)
+      out(i, k) = a0 * b(0, k) + a1 * b(1, k) + a2 * b(2, k);
+    out(i, 3) = a0 * b(0, 3) + a1 * b(1, 3) + a2 * b(2, 3) + a3;
+  }
+  out(3, 0) = out(3, 1) = out(3, 2) = 0;
+  out(3, 3) = 1;
+}
+
+// out = parent * rigTFormToMatrix(local) for an affine parent, with the
+// local matrix never built. out may be parent.
+inline void composeRigidInto(const Matrix4& parent, const RigTForm& local, Matrix4& out) {
+  const UnitQuat q = local.getRotation();
+  const Cvec3 t = local.getTranslation();
+  const double s = 2;
+  // rotation part of quatToMatrix, and the translation as the last column
+  const double l[3][4] = {
+    {1 - (q[2]*q[2] + q[3]*q[3]) * s, (q[1]*q[2] - q[0]*q[3]) * s, (q[1]*q[3] + q[2]*q[0]) * s, t[0]},
+    {(q[1]*q[2] + q[0]*q[3]) * s, 1 - (q[1]*q[1] + q[3]*q[3]) * s, (q[2]*q[3] - q[1]*q[0]) * s, t[1]},
+    {(q[1]*q[3] - q[2]*q[0]) * s, (q[2]*q[3] + q[1]*q[0]) * s, 1 - (q[1]*q[1] + q[2]*q[2]) * s, t[2]}
+  };
+  assert(isAffine(parent));
+  for (int i = 0; i < 3; ++i) {
+    const double p0 = parent(i, 0), p1 = parent(i, 1), p2 = parent(i, 2), p3 = parent(i, 3);
+    for (int k = 0; k < 3; ++k)
+      out(i, k) = p0 * l[0][k] + p1 * l[1][k] + p2 * l[2][k];
+    out(i, 3) = p0 * l[0][3] + p1 * l[1][3] + p2 * l[2][3] + p3;
+  }
+  out(3, 0) = out(3, 1) = out(3, 2) = 0;
+  out(3, 3) = 1;
+}
+
+// Writes a * b column-major, as glUniformMatrix4fv wants it, for affine a
+// and b, without forming the product
+template <class T>
+inline void writeAffineProductColumnMajor(const Matrix4& a, const Matrix4& b, T out[16]) {
+  assert(isAffine(a) && isAffine(b));
+  const double b00 = b(0, 0), b01 = b(0, 1), b02 = b(0, 2), b03 = b(0, 3);
+  const double b10 = b(1, 0), b11 = b(1, 1), b12 = b(1, 2), b13 = b(1, 3);
+  const double b20 = b(2, 0), b21 = b(2, 1), b22 = b(2, 2), b23 = b(2, 3);
+  for (int i = 0; i < 3; ++i) {
+    const double a0 = a(i, 0), a1 = a(i, 1), a2 = a(i, 2), a3 = a(i, 3);
+    out[i] = T(a0 * b00 + a1 * b10 + a2 * b20);
+    out[4 + i] = T(a0 * b01 + a1 * b11 + a2 * b21);
+    out[8 + i] = T(a0 * b02 + a1 * b12 + a2 * b22);
+    out[12 + i] = T(a0 * b03 + a1 * b13 + a2 * b23 + a3);
+  }
+  out[3] = out[7] = out[11] = T(0);
+  out[15] = T(1);
+}
+
+#endif
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "geometrybench.h"
+#include "cylinder.h"
+#include "geometrymaker.h"
+#include "matrix4.h"
+#include "skinweights.h"
+#include "sparseskin.h"
+#include "vertexpnb.h"
+
+using namespace std;
+
+void benchGeometry() {
+  static const int levels[] = {20, 64, 128, 250};
+  for (int l = 0; l < 4; ++l) {
+    const int n = levels[l];
+    int vbLen, ibLen;
+    getSurfaceVbIbLen(n, true, n, false, vbLen, ibLen);
+    vector<VertexPNB> vtx(vbLen);
+    vector<unsigned short> idx(ibLen);
+    const int reps = std::max(1, 4000000 / vbLen);
+
+    double rates[3];
+    for (int variant = 0; variant < 3; ++variant) {
+      const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      for (int r = 0; r < reps; ++r) {
+        if (variant == 0)
+          makeSurface(0.0, 2*CS175_PI/n, n, true, 0.0, 1.0/n, n, false,
+                      makeCylinderV, makeCylinderN, makeCylinderBN, makeCylinderBW, vtx.begin(), idx.begin());
+        else if (variant == 1)
+          makeSurface(0.0, 2*CS175_PI/n, n, true, 0.0, 1.0/n, n, false,
+                      [](float s, float t) { return makeCylinderV(s, t); },
+                      [](float s, float t) { return makeCylinderN(s, t); },
+                      [](float s, float t) { return makeCylinderBN(s, t); },
+                      [](float s, float t) { return makeCylinderBW(s, t); }, vtx.begin(), idx.begin());
+        else
+          makeSurfaceParallel(0.0, 2*CS175_PI/n, n, true, 0.0, 1.0/n, n, false,
+                              CylinderMaker(), vtx.begin(), idx.begin());
+      }
+      const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+      rates[variant] = double(vbLen) * reps / seconds;
+    }
+    cout << n << "x" << n << " (" << vbLen << " vertices): "
+         << rates[0] / 1e6 << " M/s function pointers, "
+         << rates[1] / 1e6 << " M/s lambdas, "
+         << rates[2] / 1e6 << " M/s parallel" << endl;
+  }
+}
+
+void benchSkinning() {
+  const int n = 250, boneCount = 3;
+  int vbLen, ibLen;
+  getSurfaceVbIbLen(n, true, n, false, vbLen, ibLen);
+  vector<VertexPNB> vtx(vbLen);
+  vector<unsigned short> idx(ibLen);
+  makeSurfaceParallel(0.0, 2*CS175_PI/n, n, true, 0.0, 1.0/n, n, false, CylinderMaker(), vtx.begin(), idx.begin());
+  pruneInfluences(vtx);
+
+  SkinWeightsCsr csr;
+  SkinWeightsEll ell;
+  SkinInput input;
+  buildSkinWeightsCsr(&vtx[0], vbLen, csr);
+  buildSkinWeightsEll(&vtx[0], vbLen, ell);
+  buildSkinInput(&vtx[0], vbLen, input);
+  cout << vbLen << " vertices, " << csr.weights.size() << " weights (" << ell.width << " per vertex in ELL)" << endl;
+
+  static const int counts[] = {1, 16, 64};
+  for (int c = 0; c < 3; ++c) {
+    const int K = counts[c];
+
+    // palettes as the interleaved block the batches take, and each
+    // character's own copy
+    vector<float> block(boneCount * K * SKIN_PALETTE_STRIDE);
+    vector<vector<float> > single(K, vector<float>(boneCount * SKIN_PALETTE_STRIDE));
+    for (int b = 0; b < boneCount; ++b) {
+      for (int k = 0; k < K; ++k) {
+        const Matrix4 m = Matrix4::makeYRotation(5.0 * k) * Matrix4::makeZRotation(10.0 * b);
+        for (int i = 0; i < SKIN_PALETTE_STRIDE; ++i)
+          block[(b * SKIN_PALETTE_STRIDE + i) * K + k] = single[k][b * SKIN_PALETTE_STRIDE + i] = float(m[i]);
+      }
+    }
+
+    vector<float> positions(3 * vbLen * K), normals(3 * vbLen * K), reference;
+    const int reps = std::max(1, 20000000 / (vbLen * K));
+    double rates[3];
+    for (int variant = 0; variant < 3; ++variant) {
+      const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      for (int r = 0; r < reps; ++r) {
+        if (variant == 0) {
+          for (int k = 0; k < K; ++k)
+            skinCsr(csr, input, &single[k][0], &positions[3 * vbLen * k], &normals[3 * vbLen * k]);
+        }
+        else if (variant == 1)
+          skinCsrBatch(csr, input, &block[0], K, &positions[0], &normals[0]);
+        else
+          skinEllBatch(ell, input, &block[0], K, &positions[0], &normals[0]);
+      }
+      const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+      rates[variant] = double(vbLen) * K * reps / seconds;
+
+      // all variants must agree, the batches writing the characters interleaved
+      if (variant == 0)
+        reference = positions;
+      else {
+        for (int k = 0; k < K; ++k) {
+          for (int i = 0; i < 3 * vbLen; ++i) {
+            if (abs(positions[i * K + k] - reference[3 * vbLen * k + i]) > 1e-4f)
+              throw runtime_error("Batched skinning differs from per character skinning");
+          }
+        }
+      }
+    }
+    cout << "K=" << K << ": " << rates[0] / 1e6 << " M/s per character, "
+         << rates[1] / 1e6 << " M/s CSR batch, "
+         << rates[2] / 1e6 << " M/s ELL batch" << endl;
+  }
+}
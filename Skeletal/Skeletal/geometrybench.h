@@ -0,0 +1,21 @@
+#ifndef GEOMETRYBENCH_H
+#define GEOMETRYBENCH_H
+
+//--------------------------------------------------------------------------------
+// Benchmarks of the procedural surface (cylinder.h): generating it and
+// skinning it on the CPU. Neither needs GL; the skeletal_bench target of
+// CMakeLists.txt runs them without the app.
+//--------------------------------------------------------------------------------
+
+// Prints vertices generated per second for the cylinder at several
+// tessellations, comparing makeSurface called with function pointers, with
+// inlinable lambdas, and makeSurfaceParallel with the table driven functor
+void benchGeometry();
+
+// Prints vertices skinned per second on the CPU for K characters sharing a
+// 250x250 cylinder, skinning them one by one with CSR weights and in one
+// batched pass with CSR and ELL weights. Throws runtime_error if the
+// batches disagree with the per character skinning.
+void benchSkinning();
+
+#endif
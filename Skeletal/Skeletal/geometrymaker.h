@@ -2,8 +2,11 @@
 #define GEOMETRYMAKER_H
 
 #include <cmath>
+#include <vector>
+#include <algorithm>
 
 #include "cvec.h"
+#include "workerpool.h"
 
 //--------------------------------------------------------------------------------
 // Helpers for creating some special geometries such as plane, cubes, and spheres
@@ -193,28 +196,11 @@ inline void getSurfaceVbIbLen(int s_steps, bool wrap_s, int t_steps, bool wrap_t
   ibLen = (s_steps*2 + 2)*t_steps;
 }
 
-template<typename vMaker, typename nMaker, typename bNameMaker, typename bWeightMaker, typename VtxOutIter, typename IdxOutIter>
-void makeSurface(float start_s,float step_s,unsigned short s_steps,bool wrap_s,
-  float start_t,float step_t,unsigned short t_steps,bool wrap_t,vMaker makeV,nMaker makeN,
-  bNameMaker makeBName, bWeightMaker makeBWeight, VtxOutIter vtxIter, IdxOutIter idxIter) {
-
+template<typename IdxOutIter>
+void makeSurfaceIndices(unsigned short s_steps,bool wrap_s,unsigned short t_steps,bool wrap_t,IdxOutIter idxIter) {
   unsigned short t,s,next_t;
-  
-  unsigned short sCount = s_steps + (wrap_s?0:1);
-  unsigned short tCount = t_steps + (wrap_t?0:1);
 
-  for(t = 0;t < tCount;t++) {
-	for(s = 0;s < sCount;s++) {
-      float paramS = start_s + s*step_s;
-      float paramT = start_t + t*step_t;
-      Cvec3f vertex = makeV(paramS,paramT);
-      Cvec3f normal = makeN(paramS,paramT);
-      Cvec<int,3> boneNames = makeBName(paramS,paramT);
-	  Cvec3f boneWeights = makeBWeight(paramS,paramT);
-	  *vtxIter = SmallVertex(vertex,normal,boneNames,boneWeights);
-      ++vtxIter;
-    }
-  }
+  unsigned short sCount = s_steps + (wrap_s?0:1);
 
   for(t = 0;t < t_steps - 1;t++) {
     next_t = t + 1;
@@ -253,4 +239,93 @@ void makeSurface(float start_s,float step_s,unsigned short s_steps,bool wrap_s,
   ++idxIter;
 }
 
+template<typename vMaker, typename nMaker, typename bNameMaker, typename bWeightMaker, typename VtxOutIter, typename IdxOutIter>
+void makeSurface(float start_s,float step_s,unsigned short s_steps,bool wrap_s,
+  float start_t,float step_t,unsigned short t_steps,bool wrap_t,vMaker makeV,nMaker makeN,
+  bNameMaker makeBName, bWeightMaker makeBWeight, VtxOutIter vtxIter, IdxOutIter idxIter) {
+
+  unsigned short t,s;
+  
+  unsigned short sCount = s_steps + (wrap_s?0:1);
+  unsigned short tCount = t_steps + (wrap_t?0:1);
+
+  for(t = 0;t < tCount;t++) {
+	for(s = 0;s < sCount;s++) {
+      float paramS = start_s + s*step_s;
+      float paramT = start_t + t*step_t;
+      Cvec3f vertex = makeV(paramS,paramT);
+      Cvec3f normal = makeN(paramS,paramT);
+      Cvec<int,3> boneNames = makeBName(paramS,paramT);
+	  Cvec3f boneWeights = makeBWeight(paramS,paramT);
+	  *vtxIter = SmallVertex(vertex,normal,boneNames,boneWeights);
+      ++vtxIter;
+    }
+  }
+
+  makeSurfaceIndices(s_steps,wrap_s,t_steps,wrap_t,idxIter);
+}
+
+// Surface parameters handed to the vertex maker of makeSurfaceParallel.
+// cos(s) and sin(s) come from a table computed once per column, so makers of
+// surfaces of revolution need no trigonometry per vertex.
+struct SurfaceSample {
+  float s, t;
+  float cosS, sinS;
+};
+
+// Same surface as makeSurface, but a single maker functor builds the whole
+// vertex from a SurfaceSample, so that it is inlined rather than called
+// through four function pointers, and bands of rows of t are generated on up
+// to threadCount threads (0 picks the hardware concurrency) of the shared
+// WorkerPool, next to the indices. vtxIter has to be random access.
+// makeSphere and makeCube stay serial: the cube is 24 vertices, and the
+// sphere writes vertices and indices interleaved through output iterators
+// while its trigonometry is already tabled, leaving nothing worth a thread.
+template<typename VertexMaker, typename VtxIter, typename IdxOutIter>
+void makeSurfaceParallel(float start_s,float step_s,unsigned short s_steps,bool wrap_s,
+  float start_t,float step_t,unsigned short t_steps,bool wrap_t,
+  VertexMaker makeVertex, VtxIter vtxIter, IdxOutIter idxIter, int threadCount = 0) {
+
+  const int sCount = s_steps + (wrap_s?0:1);
+  const int tCount = t_steps + (wrap_t?0:1);
+
+  std::vector<SurfaceSample> ring(sCount);
+  for (int s = 0; s < sCount; ++s) {
+    ring[s].s = start_s + s*step_s;
+    ring[s].cosS = std::cos(ring[s].s);
+    ring[s].sinS = std::sin(ring[s].s);
+  }
+
+  auto makeRows = [&](int firstRow, int endRow) {
+    for (int t = firstRow; t < endRow; ++t) {
+      const float paramT = start_t + t*step_t;
+      VtxIter row = vtxIter + t*sCount;
+      for (int s = 0; s < sCount; ++s) {
+        SurfaceSample p = ring[s];
+        p.t = paramT;
+        row[s] = makeVertex(p);
+      }
+    }
+  };
+
+  // small surfaces are not worth a wake-up: ask for 16k vertices per band
+  WorkerPool& pool = WorkerPool::shared();
+  if (threadCount <= 0)
+    threadCount = pool.threadCount();
+  const int bands = std::max(1, std::min(threadCount, std::min(tCount, sCount*tCount / 16384)));
+  if (bands == 1) {
+    makeRows(0, tCount);
+    makeSurfaceIndices(s_steps,wrap_s,t_steps,wrap_t,idxIter);
+    return;
+  }
+
+  // the last job writes the indices
+  pool.run(bands + 1, [&](int i) {
+    if (i == bands)
+      makeSurfaceIndices(s_steps,wrap_s,t_steps,wrap_t,idxIter);
+    else
+      makeRows(tCount*i/bands, tCount*(i + 1)/bands);
+  });
+}
+
 #endif
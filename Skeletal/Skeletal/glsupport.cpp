@@ -8,6 +8,8 @@
 
 using namespace std;
 
+GlFrameCounters g_glFrameCounters;
+
 void checkGlErrors() {
   const GLenum errCode = glGetError();
 
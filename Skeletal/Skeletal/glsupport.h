@@ -131,6 +131,74 @@ public:
   }
 };
 
+// Light wrapper around a GL vertex array object handle that automatically
+// allocates and deallocates. Can be casted to a GLuint.
+class GlVertexArrayObject : Noncopyable {
+protected:
+  GLuint handle_;
+
+public:
+  GlVertexArrayObject() {
+    glGenVertexArrays(1, &handle_);
+    checkGlErrors();
+  }
+
+  ~GlVertexArrayObject() {
+    glDeleteVertexArrays(1, &handle_);
+  }
+
+  // Casts to GLuint so can be used directly glBindVertexArray and so on
+  operator GLuint() const {
+    return handle_;
+  }
+};
+
+// Light wrapper around a GL query object handle that automatically
+// allocates and deallocates. Can be casted to a GLuint.
+class GlQuery : Noncopyable {
+protected:
+  GLuint handle_;
+
+public:
+  GlQuery() {
+    glGenQueries(1, &handle_);
+    checkGlErrors();
+  }
+
+  ~GlQuery() {
+    glDeleteQueries(1, &handle_);
+  }
+
+  // Casts to GLuint so can be used directly glBeginQuery and so on
+  operator GLuint() const {
+    return handle_;
+  }
+};
+
+// Draw calls, uniform calls and bytes sent to GL. The safe_glUniform*
+// functions below count themselves; draws and buffer uploads are counted
+// where they are issued. Whoever keeps frame statistics clears them at the
+// start of a frame.
+struct GlFrameCounters {
+  int drawCalls;
+  int uniformCalls;
+  long long bytesUploaded;
+};
+
+extern GlFrameCounters g_glFrameCounters;
+
+inline void countGlDraw(int calls = 1) {
+  g_glFrameCounters.drawCalls += calls;
+}
+
+inline void countGlUpload(size_t bytes) {
+  g_glFrameCounters.bytesUploaded += bytes;
+}
+
+inline void countGlUniform(size_t bytes) {
+  ++g_glFrameCounters.uniformCalls;
+  g_glFrameCounters.bytesUploaded += bytes;
+}
 
 // Safe versions of various functions that handle GLSL shader attributes
 // and variables: These mainly issue a warning when specified attributes
@@ -153,48 +221,74 @@ inline GLint safe_glGetAttribLocation(const GLuint program, const char varname[]
 }
 
 inline void safe_glUniformMatrix4fv(const GLint handle, const GLfloat data[]) {
-  if (handle >= 0)
+  if (handle >= 0) {
+    countGlUniform(16 * sizeof(GLfloat));
     glUniformMatrix4fv(handle, 1, GL_FALSE, data);
+  }
+}
+
+// count consecutive matrices of a uniform array, from the element at handle
+inline void safe_glUniformMatrix4fv(const GLint handle, const GLsizei count, const GLfloat data[]) {
+  if (handle >= 0 && count > 0) {
+    countGlUniform(count * 16 * sizeof(GLfloat));
+    glUniformMatrix4fv(handle, count, GL_FALSE, data);
+  }
 }
 
 inline void safe_glUniform1i(const GLint handle, const GLint a) {
-  if (handle >= 0)
+  if (handle >= 0) {
+    countGlUniform(sizeof(GLint));
     glUniform1i(handle, a);
+  }
 }
 
 inline void safe_glUniform2i(const GLint handle, const GLint a, const GLint b) {
-  if (handle >= 0)
+  if (handle >= 0) {
+    countGlUniform(2 * sizeof(GLint));
     glUniform2i(handle, a, b);
+  }
 }
 
 inline void safe_glUniform3i(const GLint handle, const GLint a, const GLint b, const GLint c) {
-  if (handle >= 0)
+  if (handle >= 0) {
+    countGlUniform(3 * sizeof(GLint));
     glUniform3i(handle, a, b, c);
+  }
 }
 
 inline void safe_glUniform4i(const GLint handle, const GLint a, const GLint b, const GLint c, const GLint d) {
-  if (handle >= 0)
+  if (handle >= 0) {
+    countGlUniform(4 * sizeof(GLint));
     glUniform4i(handle, a, b, c, d);
+  }
 }
 
 inline void safe_glUniform1f(const GLint handle, const GLfloat a) {
-  if (handle >= 0)
+  if (handle >= 0) {
+    countGlUniform(sizeof(GLfloat));
     glUniform1f(handle, a);
+  }
 }
 
 inline void safe_glUniform2f(const GLint handle, const GLfloat a, const GLfloat b) {
-  if (handle >= 0)
+  if (handle >= 0) {
+    countGlUniform(2 * sizeof(GLfloat));
     glUniform2f(handle, a, b);
+  }
 }
 
 inline void safe_glUniform3f(const GLint handle, const GLfloat a, const GLfloat b, const GLfloat c) {
-  if (handle >= 0)
+  if (handle >= 0) {
+    countGlUniform(3 * sizeof(GLfloat));
     glUniform3f(handle, a, b, c);
+  }
 }
 
 inline void safe_glUniform4f(const GLint handle, const GLfloat a, const GLfloat b, const GLfloat c, const GLfloat d) {
-  if (handle >= 0)
+  if (handle >= 0) {
+    countGlUniform(4 * sizeof(GLfloat));
     glUniform4f(handle, a, b, c, d);
+  }
 }
 
 inline void safe_glEnableVertexAttribArray(const GLint handle) {
@@ -217,6 +311,11 @@ inline void safe_glVertexAttribIPointer(const GLint handle, GLint size, GLenum t
     glVertexAttribIPointer(handle, size, type, stride, pointer);
 }
 
+inline void safe_glVertexAttribDivisor(const GLint handle, GLuint divisor) {
+  if (handle >= 0)
+    glVertexAttribDivisor(handle, divisor);
+}
+
 inline void safe_glVertexAttrib1f(const GLint handle, const GLfloat a) {
   if (handle >= 0)
     glVertexAttrib1f(handle, a);
@@ -0,0 +1,749 @@
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include "gltf.h"
+#include "mappedfile.h"
+#include "matrix4.h"
+#include "quat.h"
+#include "rigtform.h"
+
+using namespace std;
+
+// -------- JSON
+
+// A parsed JSON value. Strings are not copied but point into the source text
+// (escape sequences are left as is, glTF names and keys rarely have any).
+struct JsonValue {
+  enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT };
+
+  Type type;
+  double number;
+  const char* str;
+  size_t len;
+  vector<JsonValue> items;              // array elements or object values
+  vector<pair<const char*, size_t> > keys;  // object keys
+
+  JsonValue() : type(NUL), number(0), str(NULL), len(0) {}
+
+  // Member lookup, NULL when absent or not an object
+  const JsonValue* get(const char* key) const {
+    const size_t keyLen = strlen(key);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (keys[i].second == keyLen && memcmp(keys[i].first, key, keyLen) == 0)
+        return &items[i];
+    }
+    return NULL;
+  }
+
+  int getInt(const char* key, int fallback) const {
+    const JsonValue* v = get(key);
+    return v && v->type == NUMBER ? int(v->number) : fallback;
+  }
+
+  bool isString(const char* s) const {
+    return type == STRING && len == strlen(s) && memcmp(str, s, len) == 0;
+  }
+
+  string toString() const {
+    return string(str, len);
+  }
+};
+
+class JsonParser {
+  const char* p_;
+  const char* end_;
+
+  void fail(const char* what) {
+    throw runtime_error(string("glTF: invalid JSON, ") + what);
+  }
+
+  void skipSpace() {
+    while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r'))
+      ++p_;
+  }
+
+  void expect(char c) {
+    skipSpace();
+    if (p_ >= end_ || *p_ != c)
+      fail("unexpected character");
+    ++p_;
+  }
+
+  void parseString(const char*& str, size_t& len) {
+    expect('"');
+    str = p_;
+    while (p_ < end_ && *p_ != '"') {
+      if (*p_ == '\\')
+        ++p_;
+      ++p_;
+    }
+    if (p_ >= end_)
+      fail("unterminated string");
+    len = p_ - str;
+    ++p_;
+  }
+
+public:
+  JsonParser(const char* text, size_t len) : p_(text), end_(text + len) {}
+
+  void parse(JsonValue& v) {
+    skipSpace();
+    if (p_ >= end_)
+      fail("unexpected end");
+
+    switch (*p_) {
+    case '{':
+      v.type = JsonValue::OBJECT;
+      ++p_;
+      skipSpace();
+      if (p_ < end_ && *p_ == '}') {
+        ++p_;
+        return;
+      }
+      for (;;) {
+        v.keys.push_back(pair<const char*, size_t>());
+        parseString(v.keys.back().first, v.keys.back().second);
+        expect(':');
+        v.items.push_back(JsonValue());
+        parse(v.items.back());
+        skipSpace();
+        if (p_ < end_ && *p_ == ',') {
+          ++p_;
+          continue;
+        }
+        expect('}');
+        return;
+      }
+    case '[':
+      v.type = JsonValue::ARRAY;
+      ++p_;
+      skipSpace();
+      if (p_ < end_ && *p_ == ']') {
+        ++p_;
+        return;
+      }
+      for (;;) {
+        v.items.push_back(JsonValue());
+        parse(v.items.back());
+        skipSpace();
+        if (p_ < end_ && *p_ == ',') {
+          ++p_;
+          continue;
+        }
+        expect(']');
+        return;
+      }
+    case '"':
+      v.type = JsonValue::STRING;
+      parseString(v.str, v.len);
+      return;
+    case 't':
+    case 'f':
+    case 'n':
+      v.type = *p_ == 'n' ? JsonValue::NUL : JsonValue::BOOL;
+      v.number = *p_ == 't';
+      while (p_ < end_ && *p_ >= 'a' && *p_ <= 'z')
+        ++p_;
+      return;
+    default: {
+      v.type = JsonValue::NUMBER;
+      char* numEnd;
+      v.number = strtod(p_, &numEnd);
+      if (numEnd == p_)
+        fail("unexpected character");
+      p_ = numEnd;
+    }
+    }
+  }
+};
+
+// -------- Buffers and accessors
+
+static const int GLTF_BYTE = 5120, GLTF_UNSIGNED_BYTE = 5121, GLTF_SHORT = 5122,
+                 GLTF_UNSIGNED_SHORT = 5123, GLTF_UNSIGNED_INT = 5125, GLTF_FLOAT = 5126;
+
+static int componentSize(int componentType) {
+  switch (componentType) {
+  case GLTF_BYTE: case GLTF_UNSIGNED_BYTE: return 1;
+  case GLTF_SHORT: case GLTF_UNSIGNED_SHORT: return 2;
+  case GLTF_UNSIGNED_INT: case GLTF_FLOAT: return 4;
+  }
+  throw runtime_error("glTF: unknown component type");
+}
+
+static int componentCount(const JsonValue* type) {
+  static const char* const names[] = {"SCALAR", "VEC2", "VEC3", "VEC4", "MAT2", "MAT3", "MAT4"};
+  static const int counts[] = {1, 2, 3, 4, 4, 9, 16};
+  for (int i = 0; i < 7; ++i) {
+    if (type && type->isString(names[i]))
+      return counts[i];
+  }
+  throw runtime_error("glTF: unknown accessor type");
+}
+
+static int decodeBase64(char c) {
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+') return 62;
+  if (c == '/') return 63;
+  return -1;
+}
+
+// Typed view of an accessor, reading elements straight from the buffer
+struct AccessorView {
+  const char* data;
+  size_t stride;
+  int count, components, componentType;
+  bool normalized;
+
+  double get(int i, int c) const {
+    const char* p = data + i * stride + c * componentSize(componentType);
+    switch (componentType) {
+    case GLTF_FLOAT: { float f; memcpy(&f, p, 4); return f; }
+    case GLTF_UNSIGNED_INT: { unsigned int u; memcpy(&u, p, 4); return u; }
+    case GLTF_UNSIGNED_SHORT: {
+      unsigned short u;
+      memcpy(&u, p, 2);
+      return normalized ? u / 65535.0 : u;
+    }
+    case GLTF_SHORT: {
+      short s;
+      memcpy(&s, p, 2);
+      return normalized ? std::max(s / 32767.0, -1.0) : s;
+    }
+    case GLTF_UNSIGNED_BYTE: {
+      const unsigned char u = *reinterpret_cast<const unsigned char*>(p);
+      return normalized ? u / 255.0 : u;
+    }
+    default: {
+      const signed char s = *reinterpret_cast<const signed char*>(p);
+      return normalized ? std::max(s / 127.0, -1.0) : s;
+    }
+    }
+  }
+};
+
+class GltfDocument {
+  JsonValue root_;
+  vector<const char*> buffers_;
+  vector<size_t> bufferSizes_;
+  vector<shared_ptr<MappedFile> > externalFiles_;
+  vector<vector<char> > embeddedBuffers_;  // data: URIs have to be decoded
+
+public:
+  double bytes;
+
+  GltfDocument(const char* filename, const MappedFile& file) : bytes(double(file.getSize())) {
+    const char* data = file.getData();
+    const size_t size = file.getSize();
+    const char* binChunk = NULL;
+    size_t binSize = 0;
+
+    unsigned int header[3];
+    if (size >= 12)
+      memcpy(header, data, 12);
+    if (size >= 12 && memcmp(data, "glTF", 4) == 0) {
+      // GLB: 12 byte header, JSON chunk, optional BIN chunk
+      if (header[1] != 2)
+        throw runtime_error("glTF: only version 2 is supported");
+      size_t offset = 12;
+      const char* json = NULL;
+      size_t jsonSize = 0;
+      while (offset + 8 <= size) {
+        unsigned int chunk[2];
+        memcpy(chunk, data + offset, 8);
+        if (offset + 8 + chunk[0] > size)
+          throw runtime_error("glTF: truncated chunk");
+        if (memcmp(&chunk[1], "JSON", 4) == 0) {
+          json = data + offset + 8;
+          jsonSize = chunk[0];
+        }
+        else if (memcmp(&chunk[1], "BIN\0", 4) == 0) {
+          binChunk = data + offset + 8;
+          binSize = chunk[0];
+        }
+        offset += 8 + chunk[0];
+      }
+      if (json == NULL)
+        throw runtime_error("glTF: missing JSON chunk");
+      JsonParser(json, jsonSize).parse(root_);
+    }
+    else
+      JsonParser(data, size).parse(root_);
+
+    // Resolve buffers: GLB binary chunk, external files (mapped) or base64
+    const string dir(filename, strrchr(filename, '/') ? strrchr(filename, '/') + 1 - filename :
+                               strrchr(filename, '\\') ? strrchr(filename, '\\') + 1 - filename : 0);
+    const JsonValue* buffers = root_.get("buffers");
+    for (size_t i = 0; buffers && i < buffers->items.size(); ++i) {
+      const JsonValue* uri = buffers->items[i].get("uri");
+      if (uri == NULL) {
+        buffers_.push_back(binChunk);
+        bufferSizes_.push_back(binSize);
+      }
+      else if (uri->len > 5 && memcmp(uri->str, "data:", 5) == 0) {
+        const char* b64 = static_cast<const char*>(memchr(uri->str, ',', uri->len));
+        if (b64 == NULL)
+          throw runtime_error("glTF: invalid data URI");
+        ++b64;
+        embeddedBuffers_.push_back(vector<char>());
+        vector<char>& out = embeddedBuffers_.back();
+        out.reserve((uri->str + uri->len - b64) / 4 * 3);
+        unsigned int acc = 0;
+        int bits = 0;
+        for (; b64 < uri->str + uri->len; ++b64) {
+          const int d = decodeBase64(*b64);
+          if (d < 0)
+            continue;
+          acc = (acc << 6) | d;
+          bits += 6;
+          if (bits >= 8) {
+            bits -= 8;
+            out.push_back(char((acc >> bits) & 0xff));
+          }
+        }
+        buffers_.push_back(out.empty() ? NULL : &out[0]);
+        bufferSizes_.push_back(out.size());
+      }
+      else {
+        externalFiles_.push_back(shared_ptr<MappedFile>(new MappedFile((dir + uri->toString()).c_str())));
+        buffers_.push_back(externalFiles_.back()->getData());
+        bufferSizes_.push_back(externalFiles_.back()->getSize());
+        bytes += double(externalFiles_.back()->getSize());
+      }
+    }
+  }
+
+  const JsonValue& root() const {
+    return root_;
+  }
+
+  // Array element of a top level collection, throws if missing
+  const JsonValue& at(const char* collection, int i) const {
+    const JsonValue* c = root_.get(collection);
+    if (c == NULL || i < 0 || i >= (int) c->items.size())
+      throw runtime_error(string("glTF: bad reference into ") + collection);
+    return c->items[i];
+  }
+
+  AccessorView accessor(int i) const {
+    const JsonValue& a = at("accessors", i);
+    if (a.get("sparse"))
+      throw runtime_error("glTF: sparse accessors are not supported");
+
+    AccessorView view;
+    view.count = a.getInt("count", 0);
+    view.components = componentCount(a.get("type"));
+    view.componentType = a.getInt("componentType", GLTF_FLOAT);
+    const JsonValue* normalized = a.get("normalized");
+    view.normalized = normalized && normalized->number != 0;
+
+    const JsonValue& bv = at("bufferViews", a.getInt("bufferView", -1));
+    const int buffer = bv.getInt("buffer", 0);
+    if (buffer < 0 || buffer >= (int) buffers_.size() || buffers_[buffer] == NULL)
+      throw runtime_error("glTF: accessor refers to a missing buffer");
+    const size_t elementSize = size_t(view.components) * componentSize(view.componentType);
+    view.stride = bv.getInt("byteStride", 0) ? bv.getInt("byteStride", 0) : elementSize;
+    const size_t offset = size_t(bv.getInt("byteOffset", 0)) + a.getInt("byteOffset", 0);
+    if (view.count > 0 && offset + (view.count - 1) * view.stride + elementSize > bufferSizes_[buffer])
+      throw runtime_error("glTF: accessor out of buffer bounds");
+    view.data = buffers_[buffer] + offset;
+    return view;
+  }
+};
+
+// -------- Transforms
+
+// Rotation of an orthonormal matrix as a quaternion (Shepperd's method)
+static Quat matrixToQuat(const Matrix4& m) {
+  const double trace = m(0, 0) + m(1, 1) + m(2, 2);
+  if (trace > 0) {
+    const double s = 0.5 / std::sqrt(trace + 1);
+    return Quat(0.25 / s, (m(2, 1) - m(1, 2)) * s, (m(0, 2) - m(2, 0)) * s, (m(1, 0) - m(0, 1)) * s);
+  }
+  if (m(0, 0) > m(1, 1) && m(0, 0) > m(2, 2)) {
+    const double s = 2 * std::sqrt(1 + m(0, 0) - m(1, 1) - m(2, 2));
+    return Quat((m(2, 1) - m(1, 2)) / s, 0.25 * s, (m(0, 1) + m(1, 0)) / s, (m(0, 2) + m(2, 0)) / s);
+  }
+  if (m(1, 1) > m(2, 2)) {
+    const double s = 2 * std::sqrt(1 + m(1, 1) - m(0, 0) - m(2, 2));
+    return Quat((m(0, 2) - m(2, 0)) / s, (m(0, 1) + m(1, 0)) / s, 0.25 * s, (m(1, 2) + m(2, 1)) / s);
+  }
+  const double s = 2 * std::sqrt(1 + m(2, 2) - m(0, 0) - m(1, 1));
+  return Quat((m(1, 0) - m(0, 1)) / s, (m(0, 2) + m(2, 0)) / s, (m(1, 2) + m(2, 1)) / s, 0.25 * s);
+}
+
+static bool g_warnedScale = false;
+
+// Local transform of a node. RigTForm has no scale, so scale is dropped.
+// Throws runtime_error for a matrix, translation or rotation of the wrong
+// size, a matrix with a zero column or a zero rotation.
+static RigTForm nodeTransform(const JsonValue& node) {
+  const JsonValue* matrix = node.get("matrix");
+  if (matrix) {
+    if (matrix->items.size() != 16)
+      throw runtime_error("glTF: node matrix must have 16 numbers");
+    double m[16];
+    for (int i = 0; i < 16; ++i) {
+      m[i] = matrix->items[i].number;
+    }
+    Matrix4 r;
+    r.readFromColumnMajorMatrix(m);
+    for (int c = 0; c < 3; ++c) {
+      const double len = std::sqrt(r(0, c) * r(0, c) + r(1, c) * r(1, c) + r(2, c) * r(2, c));
+      if (!(len > CS175_EPS))
+        throw runtime_error("glTF: node matrix has a zero scale");
+      if (std::abs(len - 1) > 1e-4 && !g_warnedScale) {
+        cerr << "WARN: glTF node scale is ignored" << endl;
+        g_warnedScale = true;
+      }
+      for (int row = 0; row < 3; ++row) {
+        r(row, c) /= len;
+      }
+    }
+    return RigTForm(Cvec3(r(0, 3), r(1, 3), r(2, 3)), UnitQuat(matrixToQuat(r)));
+  }
+
+  Cvec3 t;
+  Quat q;
+  if (const JsonValue* tr = node.get("translation")) {
+    if (tr->items.size() != 3)
+      throw runtime_error("glTF: node translation must have 3 numbers");
+    t = Cvec3(tr->items[0].number, tr->items[1].number, tr->items[2].number);
+  }
+  if (const JsonValue* rot = node.get("rotation")) {
+    if (rot->items.size() != 4)
+      throw runtime_error("glTF: node rotation must have 4 numbers");
+    q = Quat(rot->items[3].number, rot->items[0].number, rot->items[1].number, rot->items[2].number);
+    if (!(norm2(q) > CS175_EPS2))
+      throw runtime_error("glTF: node rotation is zero");
+  }
+  if (node.get("scale") && !g_warnedScale) {
+    cerr << "WARN: glTF node scale is ignored" << endl;
+    g_warnedScale = true;
+  }
+  return RigTForm(t, UnitQuat(q));
+}
+
+// -------- Import
+
+struct SkeletonBuilder {
+  const GltfDocument& doc;
+  Skeleton& skeleton;
+  vector<int> joints;         // node of each joint
+  vector<int> nodeParent;     // parent node of each node, -1 for roots
+  vector<int> jointOfNode;    // joint index of each node, -1 if not a joint
+  vector<Bone*> bones;
+  vector<Matrix4> inverseBind;
+
+  SkeletonBuilder(const GltfDocument& doc, Skeleton& skeleton) : doc(doc), skeleton(skeleton) {}
+
+  // Adds the bone of joint j after its parent bone. Non-joint ancestors are
+  // folded into the transform of the topmost bone.
+  Bone* addJoint(int j) {
+    if (bones[j] != NULL)
+      return bones[j];
+
+    const int node = joints[j];
+    RigTForm transform = nodeTransform(doc.at("nodes", node));
+    Bone* parent = NULL;
+    for (int n = nodeParent[node]; n >= 0; n = nodeParent[n]) {
+      if (jointOfNode[n] >= 0) {
+        parent = addJoint(jointOfNode[n]);
+        break;
+      }
+      transform = nodeTransform(doc.at("nodes", n)) * transform;
+    }
+    bones[j] = skeleton.addBone(j, parent, transform);
+    bones[j]->setOffset(inverseBind[j]);
+    return bones[j];
+  }
+};
+
+// Decodes one triangle primitive into the result, keeping the three largest
+// influences of each vertex. Joints are read only with a skin of jointCount
+// joints, and must be below it, as indices must be below the vertex count.
+static void importPrimitive(const GltfDocument& doc, const JsonValue& prim, int jointCount, GltfImport& result) {
+  if (prim.getInt("mode", 4) != 4)
+    throw runtime_error("glTF: only triangle primitives are supported");
+  const JsonValue* attrs = prim.get("attributes");
+  if (attrs == NULL || attrs->get("POSITION") == NULL)
+    throw runtime_error("glTF: primitive without positions");
+
+  const AccessorView pos = doc.accessor(attrs->getInt("POSITION", -1));
+  if (pos.components != 3)
+    throw runtime_error("glTF: POSITION must be VEC3");
+  const size_t base = result.vertices.size();
+  if (base + pos.count > 65536)
+    throw runtime_error("glTF: mesh has more vertices than 16 bit indices can address");
+
+  result.vertices.resize(base + pos.count);
+  VertexPNB* out = &result.vertices[base];
+  for (int i = 0; i < pos.count; ++i) {
+    out[i].p = Cvec3f(float(pos.get(i, 0)), float(pos.get(i, 1)), float(pos.get(i, 2)));
+    out[i].bw = Cvec3f(1, 0, 0);
+  }
+  if (attrs->get("NORMAL")) {
+    const AccessorView nrm = doc.accessor(attrs->getInt("NORMAL", -1));
+    if (nrm.components != 3)
+      throw runtime_error("glTF: NORMAL must be VEC3");
+    for (int i = 0; i < pos.count && i < nrm.count; ++i) {
+      out[i].n = Cvec3f(float(nrm.get(i, 0)), float(nrm.get(i, 1)), float(nrm.get(i, 2)));
+    }
+  }
+  if (jointCount > 0 && attrs->get("JOINTS_0") && attrs->get("WEIGHTS_0")) {
+    const AccessorView jnt = doc.accessor(attrs->getInt("JOINTS_0", -1));
+    const AccessorView wgt = doc.accessor(attrs->getInt("WEIGHTS_0", -1));
+    if (jnt.components != 4 || wgt.components != 4)
+      throw runtime_error("glTF: JOINTS_0 and WEIGHTS_0 must be VEC4");
+    for (int i = 0; i < pos.count && i < jnt.count && i < wgt.count; ++i) {
+      int names[4];
+      double weights[4];
+      for (int k = 0; k < 4; ++k) {
+        names[k] = int(jnt.get(i, k));
+        weights[k] = wgt.get(i, k);
+        if (names[k] < 0 || names[k] >= jointCount)
+          throw runtime_error("glTF: joint index out of range");
+      }
+      // drop the smallest of the four influences
+      int smallest = 0;
+      for (int k = 1; k < 4; ++k) {
+        if (weights[k] < weights[smallest])
+          smallest = k;
+      }
+      Cvec<int, 3> bn;
+      Cvec3f bw;
+      double sum = 0;
+      for (int k = 0, c = 0; k < 4; ++k) {
+        if (k == smallest)
+          continue;
+        bn[c] = names[k];
+        bw[c] = float(weights[k]);
+        sum += weights[k];
+        ++c;
+      }
+      out[i].bn = bn;
+      out[i].bw = sum > 0 ? bw / float(sum) : Cvec3f(1, 0, 0);
+    }
+  }
+
+  if (prim.get("indices")) {
+    const AccessorView idx = doc.accessor(prim.getInt("indices", -1));
+    result.indices.reserve(result.indices.size() + idx.count);
+    for (int i = 0; i < idx.count; ++i) {
+      const double index = idx.get(i, 0);
+      if (index < 0 || index >= pos.count)
+        throw runtime_error("glTF: vertex index out of range");
+      result.indices.push_back((unsigned short) (base + (unsigned int) index));
+    }
+  }
+  else {
+    for (int i = 0; i < pos.count; ++i) {
+      result.indices.push_back((unsigned short) (base + i));
+    }
+  }
+}
+
+static void importAnimation(const GltfDocument& doc, const JsonValue& anim, const vector<int>& jointOfNode, GltfAnimation& out) {
+  const JsonValue* name = anim.get("name");
+  out.name = name && name->type == JsonValue::STRING ? name->toString() : string("animation");
+  out.duration = 0;
+
+  const JsonValue* channels = anim.get("channels");
+  const JsonValue* samplers = anim.get("samplers");
+  for (size_t c = 0; channels && samplers && c < channels->items.size(); ++c) {
+    const JsonValue& ch = channels->items[c];
+    const JsonValue* target = ch.get("target");
+    const int node = target ? target->getInt("node", -1) : -1;
+    const JsonValue* path = target ? target->get("path") : NULL;
+    if (node < 0 || node >= (int) jointOfNode.size() || jointOfNode[node] < 0 || path == NULL)
+      continue;
+    const bool rotation = path->isString("rotation");
+    if (!rotation && !path->isString("translation"))
+      continue;  // scale and morph weights have no counterpart in Skeleton
+
+    const int s = ch.getInt("sampler", -1);
+    if (s < 0 || s >= (int) samplers->items.size())
+      throw runtime_error("glTF: bad animation sampler");
+    const JsonValue& sampler = samplers->items[s];
+    const JsonValue* interp = sampler.get("interpolation");
+    const bool cubic = interp && interp->isString("CUBICSPLINE");
+
+    out.channels.push_back(GltfChannel());
+    GltfChannel& dst = out.channels.back();
+    dst.bone = jointOfNode[node];
+    dst.rotation = rotation;
+    dst.step = interp && interp->isString("STEP");
+
+    const AccessorView in = doc.accessor(sampler.getInt("input", -1));
+    const AccessorView val = doc.accessor(sampler.getInt("output", -1));
+    dst.times.resize(in.count);
+    dst.values.resize(in.count);
+    for (int k = 0; k < in.count; ++k) {
+      dst.times[k] = float(in.get(k, 0));
+      // cubic splines store (in tangent, value, out tangent), the tangents
+      // are dropped and the curve played back linearly
+      const int e = cubic ? 3 * k + 1 : k;
+      if (rotation)
+        dst.values[k] = Cvec4(val.get(e, 3), val.get(e, 0), val.get(e, 1), val.get(e, 2));
+      else
+        dst.values[k] = Cvec4(val.get(e, 0), val.get(e, 1), val.get(e, 2), 0);
+    }
+    if (!dst.times.empty())
+      out.duration = std::max(out.duration, double(dst.times.back()));
+  }
+}
+
+void importGltf(const char* filename, Skeleton& skeleton, GltfImport& result) {
+  const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+  MappedFile file(filename);
+  GltfDocument doc(filename, file);
+  const JsonValue& root = doc.root();
+
+  const JsonValue* nodes = root.get("nodes");
+  const int nodeCount = nodes ? (int) nodes->items.size() : 0;
+
+  SkeletonBuilder sb(doc, skeleton);
+  sb.nodeParent.assign(nodeCount, -1);
+  sb.jointOfNode.assign(nodeCount, -1);
+  for (int n = 0; n < nodeCount; ++n) {
+    const JsonValue* children = nodes->items[n].get("children");
+    for (size_t c = 0; children && c < children->items.size(); ++c) {
+      const int child = int(children->items[c].number);
+      if (child >= 0 && child < nodeCount)
+        sb.nodeParent[child] = n;
+    }
+  }
+
+  const JsonValue* skins = root.get("skins");
+  if (skins && !skins->items.empty()) {
+    const JsonValue& skin = skins->items[0];
+    const JsonValue* joints = skin.get("joints");
+    for (size_t j = 0; joints && j < joints->items.size(); ++j) {
+      const int node = int(joints->items[j].number);
+      if (node < 0 || node >= nodeCount)
+        throw runtime_error("glTF: bad joint reference");
+      sb.joints.push_back(node);
+      sb.jointOfNode[node] = (int) j;
+    }
+    sb.inverseBind.assign(sb.joints.size(), Matrix4());
+    if (skin.get("inverseBindMatrices")) {
+      const AccessorView ibm = doc.accessor(skin.getInt("inverseBindMatrices", -1));
+      double m[16];
+      for (int j = 0; j < ibm.count && j < (int) sb.joints.size(); ++j) {
+        for (int k = 0; k < 16; ++k) {
+          m[k] = ibm.get(j, k);
+        }
+        sb.inverseBind[j].readFromColumnMajorMatrix(m);
+      }
+    }
+    sb.bones.assign(sb.joints.size(), (Bone*) NULL);
+    for (size_t j = 0; j < sb.joints.size(); ++j) {
+      sb.addJoint((int) j);
+    }
+  }
+  else
+    skeleton.addBone(0, NULL, RigTForm());
+
+  // meshes of the nodes bound to skin 0 (any mesh if there is no skin)
+  vector<bool> meshDone(root.get("meshes") ? root.get("meshes")->items.size() : 0, false);
+  for (int n = 0; n < nodeCount; ++n) {
+    const JsonValue& node = nodes->items[n];
+    const int mesh = node.getInt("mesh", -1);
+    if (mesh < 0 || mesh >= (int) meshDone.size() || meshDone[mesh])
+      continue;
+    if (!sb.joints.empty() && node.getInt("skin", -1) != 0)
+      continue;
+    meshDone[mesh] = true;
+
+    const JsonValue* prims = doc.at("meshes", mesh).get("primitives");
+    for (size_t p = 0; prims && p < prims->items.size(); ++p) {
+      importPrimitive(doc, prims->items[p], (int) sb.joints.size(), result);
+    }
+  }
+
+  const JsonValue* anims = root.get("animations");
+  for (size_t a = 0; anims && a < anims->items.size(); ++a) {
+    result.animations.push_back(GltfAnimation());
+    importAnimation(doc, anims->items[a], sb.jointOfNode, result.animations.back());
+  }
+
+  result.megabytes = doc.bytes / (1024.0 * 1024.0);
+  result.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Shortest path interpolation that stays well defined for equal keys, where
+// slerp's pow would divide by zero. The result is renormalized so that the
+// pose it goes into keeps a unit rotation.
+static UnitQuat interpolateRotation(Quat q0, const Quat& q1, double a) {
+  if (dot(q0, q1) < 0)
+    q0 *= -1;
+  if (dot(q0, q1) > 1 - CS175_EPS)
+    return UnitQuat(q0 * (1 - a) + q1 * a);
+  return UnitQuat(slerp(q0, q1, a));
+}
+
+// Keys k and k1 enclosing t and the blend a between them, 0 for STEP
+// channels or without interpolation
+static void findKeys(const GltfChannel& ch, double t, bool interpolate, size_t& k, size_t& k1, double& a) {
+  const size_t next = upper_bound(ch.times.begin(), ch.times.end(), float(t)) - ch.times.begin();
+  k = next == 0 ? 0 : std::min(next - 1, ch.times.size() - 1);
+  k1 = std::min(k + 1, ch.times.size() - 1);
+  a = 0;
+  if (k1 != k && !ch.step && interpolate)
+    a = std::min(1.0, std::max(0.0, (t - ch.times[k]) / (ch.times[k1] - ch.times[k])));
+}
+
+static UnitQuat sampleRotation(const GltfChannel& ch, size_t k, size_t k1, double a) {
+  const Cvec4& v0 = ch.values[k];
+  const Cvec4& v1 = ch.values[k1];
+  return interpolateRotation(Quat(v0[0], v0[1], v0[2], v0[3]), Quat(v1[0], v1[1], v1[2], v1[3]), a);
+}
+
+static Cvec3 sampleTranslation(const GltfChannel& ch, size_t k, size_t k1, double a) {
+  return Cvec3(ch.values[k]) * (1 - a) + Cvec3(ch.values[k1]) * a;
+}
+
+void sampleGltfAnimation(const GltfAnimation& animation, double t, Skeleton& skeleton,
+                         const std::vector<char>* mask) {
+  for (size_t c = 0; c < animation.channels.size(); ++c) {
+    const GltfChannel& ch = animation.channels[c];
+    if (ch.times.empty() || (mask != NULL && !(*mask)[ch.bone]))
+      continue;
+
+    size_t k, k1;
+    double a;
+    findKeys(ch, t, true, k, k1, a);
+    Bone* bone = skeleton.getNamedBone(ch.bone);
+    if (ch.rotation)
+      bone->setRotate(sampleRotation(ch, k, k1, a));
+    else
+      bone->setTranslate(sampleTranslation(ch, k, k1, a));
+  }
+}
+
+void sampleGltfAnimation(const GltfAnimation& animation, double t, const std::vector<char>& mask,
+                         bool interpolate, RigTForm locals[]) {
+  for (size_t c = 0; c < animation.channels.size(); ++c) {
+    const GltfChannel& ch = animation.channels[c];
+    if (ch.times.empty() || !mask[ch.bone])
+      continue;
+
+    size_t k, k1;
+    double a;
+    findKeys(ch, t, interpolate, k, k1, a);
+    if (ch.rotation)
+      locals[ch.bone].setRotation(sampleRotation(ch, k, k1, a));
+    else
+      locals[ch.bone].setTranslation(sampleTranslation(ch, k, k1, a));
+  }
+}
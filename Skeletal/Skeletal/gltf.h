@@ -0,0 +1,62 @@
+#ifndef GLTF_H
+#define GLTF_H
+
+#include <vector>
+#include <string>
+
+#include "cvec.h"
+#include "vertexpnb.h"
+#include "Skeleton.h"
+
+//--------------------------------------------------------------------------------
+// glTF 2.0 importer for skinned meshes, skeletons and their animations.
+// Both .gltf (with external or embedded buffers) and .glb files are read.
+// Files and external buffers are memory mapped and accessors are decoded
+// straight from the mapping into the output arrays, one primitive at a time.
+//--------------------------------------------------------------------------------
+
+// One animated property of one bone
+struct GltfChannel {
+  int bone;                   // name of the bone in the Skeleton (its joint index)
+  bool rotation;              // rotation, or translation otherwise
+  bool step;                  // STEP interpolation, or LINEAR otherwise
+  std::vector<float> times;   // key times in seconds
+  std::vector<Cvec4> values;  // quaternions as (w,x,y,z) or translations as (x,y,z,0)
+};
+
+struct GltfAnimation {
+  std::string name;
+  double duration;
+  std::vector<GltfChannel> channels;
+};
+
+// Everything an import produces besides the skeleton
+struct GltfImport {
+  std::vector<VertexPNB> vertices;
+  std::vector<unsigned short> indices;  // triangle list
+  std::vector<GltfAnimation> animations;
+
+  double megabytes;                     // size of the file and its external buffers
+  double milliseconds;                  // time the import took
+};
+
+// Imports the first skin of the file into an empty skeleton: bone i is joint
+// i of the skin and uses the skin's inverse bind matrix as offset. The
+// triangles of every mesh bound to that skin are appended to the result,
+// keeping the three largest weights of each vertex. A file without skins
+// yields a single bone that all vertices follow. Throws runtime_error on
+// error.
+void importGltf(const char* filename, Skeleton& skeleton, GltfImport& result);
+
+// Poses the skeleton at time t (in seconds) of the animation. With a mask,
+// only the bones with a nonzero entry are sampled.
+void sampleGltfAnimation(const GltfAnimation& animation, double t, Skeleton& skeleton,
+                         const std::vector<char>* mask = NULL);
+
+// Samples the bones with a nonzero mask entry into their local transforms,
+// leaving the others alone. Without interpolation each channel takes the
+// key at or before t.
+void sampleGltfAnimation(const GltfAnimation& animation, double t, const std::vector<char>& mask,
+                         bool interpolate, RigTForm locals[]);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef GPUMATRIX_H
+#define GPUMATRIX_H
+
+#include <cstring>
+
+#include "matrix4.h"
+#include "fusedmath.h"
+
+// A 4x4 matrix stored the way glUniformMatrix4fv and the shaders take it:
+// column-major floats. Matrix4 stays the type for the CPU math; a
+// GpuMatrix4 is made once from its result, after which sending it or
+// copying it into a buffer needs no transpose or conversion.
+class GpuMatrix4 {
+  float d_[16]; // layout is column-major
+
+public:
+  // The identity
+  GpuMatrix4() {
+    for (int i = 0; i < 16; ++i) {
+      d_[i] = (i % 5) ? 0.0f : 1.0f;
+    }
+  }
+
+  explicit GpuMatrix4(const Matrix4& m) {
+    m.writeToColumnMajorMatrix(d_);
+  }
+
+  // a * b for affine a and b, without forming the double precision product
+  GpuMatrix4(const Matrix4& a, const Matrix4& b) {
+    writeAffineProductColumnMajor(a, b, d_);
+  }
+
+  float operator () (const int row, const int col) const {
+    return d_[(col << 2) + row];
+  }
+
+  // The 16 floats, ready for glUniformMatrix4fv with transpose GL_FALSE
+  const float* data() const {
+    return d_;
+  }
+
+  void writeTo(float m[]) const {
+    std::memcpy(m, d_, sizeof(d_));
+  }
+};
+
+static_assert(sizeof(GpuMatrix4) == 16 * sizeof(float), "GpuMatrix4 must be exactly its 16 floats");
+
+#endif
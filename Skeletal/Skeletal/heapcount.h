@@ -0,0 +1,150 @@
+#ifndef HEAPCOUNT_H
+#define HEAPCOUNT_H
+
+#include <cstdlib>
+#include <atomic>
+#include <algorithm>
+#include <new>
+
+#ifdef _WIN32
+# include <malloc.h>
+#endif
+
+//--------------------------------------------------------------------------------
+// Replaces the global operator new and delete with malloc and free that
+// count the allocations, for getHeapAllocationCount() of framearena.h.
+// Replacing them is a decision of the program, not of a module it links, so
+// this defines them: include it in exactly one source file of an executable,
+// its main file, and in none that another program could link.
+//--------------------------------------------------------------------------------
+
+static std::atomic<long long> g_heapAllocations(0);
+
+long long getHeapAllocationCount() {
+  return g_heapAllocations.load(std::memory_order_relaxed);
+}
+
+// Each form calls this rather than another form, so that compilers pair
+// every new with the free of its delete
+static void* heapCountAlloc(std::size_t bytes) {
+  g_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(bytes ? bytes : 1);
+}
+
+void* operator new (std::size_t bytes) {
+  if (void* p = heapCountAlloc(bytes))
+    return p;
+  throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t bytes) {
+  if (void* p = heapCountAlloc(bytes))
+    return p;
+  throw std::bad_alloc();
+}
+
+void* operator new (std::size_t bytes, const std::nothrow_t&) noexcept {
+  return heapCountAlloc(bytes);
+}
+
+void* operator new[] (std::size_t bytes, const std::nothrow_t&) noexcept {
+  return heapCountAlloc(bytes);
+}
+
+void operator delete (void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete[] (void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete (void* p, const std::nothrow_t&) noexcept {
+  std::free(p);
+}
+
+void operator delete[] (void* p, const std::nothrow_t&) noexcept {
+  std::free(p);
+}
+
+// The sized forms C++14 compilers call must free what malloc returned too
+void operator delete (void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[] (void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+#ifdef __cpp_aligned_new
+// C++17 sends over-aligned types to these forms. They count like the ones
+// above and free with the allocator that served them.
+
+# ifdef _WIN32
+static void* heapCountAlignedAlloc(std::size_t bytes, std::align_val_t alignment) {
+  g_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+  return _aligned_malloc(bytes ? bytes : 1, static_cast<std::size_t>(alignment));
+}
+
+static void heapCountAlignedFree(void* p) {
+  _aligned_free(p);
+}
+# else
+static void* heapCountAlignedAlloc(std::size_t bytes, std::align_val_t alignment) {
+  g_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+  void* p;
+  const std::size_t a = std::max(static_cast<std::size_t>(alignment), sizeof(void*));
+  return posix_memalign(&p, a, bytes ? bytes : 1) == 0 ? p : nullptr;
+}
+
+static void heapCountAlignedFree(void* p) {
+  std::free(p);
+}
+# endif
+
+void* operator new (std::size_t bytes, std::align_val_t alignment) {
+  if (void* p = heapCountAlignedAlloc(bytes, alignment))
+    return p;
+  throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t bytes, std::align_val_t alignment) {
+  if (void* p = heapCountAlignedAlloc(bytes, alignment))
+    return p;
+  throw std::bad_alloc();
+}
+
+void* operator new (std::size_t bytes, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return heapCountAlignedAlloc(bytes, alignment);
+}
+
+void* operator new[] (std::size_t bytes, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return heapCountAlignedAlloc(bytes, alignment);
+}
+
+void operator delete (void* p, std::align_val_t) noexcept {
+  heapCountAlignedFree(p);
+}
+
+void operator delete[] (void* p, std::align_val_t) noexcept {
+  heapCountAlignedFree(p);
+}
+
+void operator delete (void* p, std::size_t, std::align_val_t) noexcept {
+  heapCountAlignedFree(p);
+}
+
+void operator delete[] (void* p, std::size_t, std::align_val_t) noexcept {
+  heapCountAlignedFree(p);
+}
+
+void operator delete (void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+  heapCountAlignedFree(p);
+}
+
+void operator delete[] (void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+  heapCountAlignedFree(p);
+}
+#endif
+
+#endif
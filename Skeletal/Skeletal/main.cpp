@@ -8,6 +8,12 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <map>
+#include <array>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
 #include <stdexcept>
 
 #include <GL/glew.h>
@@ -18,6 +24,30 @@
 #include "matrix4.h"
 #include "rigtform.h"
 #include "geometrymaker.h"
+#include "cylinder.h"
+#include "vertexpnb.h"
+#include "meshoptimizer.h"
+#include "meshfile.h"
+#include "skinpartition.h"
+#include "skinweights.h"
+#include "bounds.h"
+#include "morph.h"
+#include "sparseskin.h"
+#include "animlod.h"
+#include "bonemask.h"
+#include "chainrig.h"
+#include "framearena.h"
+#include "heapcount.h"
+#include "mathbatch.h"
+#include "gpumatrix.h"
+#include "mathbench.h"
+#include "geometrybench.h"
+#include "skeletonbench.h"
+#include "crowdbench.h"
+#include "accuracy.h"
+#include "tracezone.h"
+#include "framestats.h"
+#include "gltf.h"
 #include "ppm.h"
 #include "glsupport.h"
 
@@ -41,6 +71,8 @@ static int g_mouseClickX, g_mouseClickY; // coordinates for mouse click event
 static int g_activeShader = 0;
 static int g_multisample = 0;
 
+static const int g_maxBones = 32;         // size of the uBone palette in basic.vshader
+
 struct ShaderState {
   GlProgram program;
 
@@ -50,8 +82,8 @@ struct ShaderState {
   GLint h_uUseBones;
   GLint h_uModelViewMatrix;
   GLint h_uNormalMatrix;
-  GLint h_uBoneViewMatrix[3];
-  GLint h_uBoneNormalMatrix[3];
+  GLint h_uBoneViewMatrix;    // uBone[0], the arrays are uploaded whole
+  GLint h_uBoneNormalMatrix;  // uBoneNormal[0]
   GLint h_uColor;
 
   // Handles to vertex attributes
@@ -60,7 +92,10 @@ struct ShaderState {
   GLint h_aBoneNames;
   GLint h_aBoneWeights;
 
-  ShaderState(const char* vsfn, const char* fsfn) {
+  // Only basic.vshader draws rigid objects as well and declares
+  // uUseBones, uModelViewMatrix and uNormalMatrix. Without rigidUniforms
+  // their handles are -1, which the safe_glUniform calls ignore.
+  ShaderState(const char* vsfn, const char* fsfn, bool rigidUniforms = true) {
     readAndCompileShader(program, vsfn, fsfn);
 
     const GLuint h = program; // short hand
@@ -69,15 +104,14 @@ struct ShaderState {
     h_uLight = safe_glGetUniformLocation(h, "uLight");
     h_uLight2 = safe_glGetUniformLocation(h, "uLight2");
     h_uProjMatrix = safe_glGetUniformLocation(h, "uProjMatrix");
-	h_uUseBones = safe_glGetUniformLocation(h, "uUseBones");
-    h_uModelViewMatrix = safe_glGetUniformLocation(h, "uModelViewMatrix");
-    h_uNormalMatrix = safe_glGetUniformLocation(h, "uNormalMatrix");
-    h_uBoneViewMatrix[0] = safe_glGetUniformLocation(h, "uBone[0]");
-    h_uBoneViewMatrix[1] = safe_glGetUniformLocation(h, "uBone[1]");
-    h_uBoneViewMatrix[2] = safe_glGetUniformLocation(h, "uBone[2]");
-    h_uBoneNormalMatrix[0] = safe_glGetUniformLocation(h, "uBoneNormal[0]");
-    h_uBoneNormalMatrix[1] = safe_glGetUniformLocation(h, "uBoneNormal[1]");
-    h_uBoneNormalMatrix[2] = safe_glGetUniformLocation(h, "uBoneNormal[2]");
+    h_uUseBones = h_uModelViewMatrix = h_uNormalMatrix = -1;
+    if (rigidUniforms) {
+      h_uUseBones = safe_glGetUniformLocation(h, "uUseBones");
+      h_uModelViewMatrix = safe_glGetUniformLocation(h, "uModelViewMatrix");
+      h_uNormalMatrix = safe_glGetUniformLocation(h, "uNormalMatrix");
+    }
+    h_uBoneViewMatrix = safe_glGetUniformLocation(h, "uBone");
+    h_uBoneNormalMatrix = safe_glGetUniformLocation(h, "uBoneNormal");
 	h_uColor = safe_glGetUniformLocation(h, "uColor");
 
     // Retrieve handles to vertex attributes
@@ -91,6 +125,77 @@ struct ShaderState {
 
 };
 
+// Shader state of morph.vshader, which adds the morph target streams and
+// weights to the skinning uniforms
+struct MorphShaderState : ShaderState {
+  GLint h_uMorphDeltas, h_uMorphRanges;
+  GLint h_uMorphWeights[MORPH_MAX_TARGETS];
+  GLint h_uMorphScales[MORPH_MAX_TARGETS];
+
+  MorphShaderState(const char* vsfn, const char* fsfn) : ShaderState(vsfn, fsfn, false) {
+    const GLuint h = program; // short hand
+
+    h_uMorphDeltas = safe_glGetUniformLocation(h, "uMorphDeltas");
+    h_uMorphRanges = safe_glGetUniformLocation(h, "uMorphRanges");
+    for (int t = 0; t < MORPH_MAX_TARGETS; ++t) {
+      const string index = "[" + to_string(t) + "]";
+      h_uMorphWeights[t] = safe_glGetUniformLocation(h, ("uMorphWeights" + index).c_str());
+      h_uMorphScales[t] = safe_glGetUniformLocation(h, ("uMorphScales" + index).c_str());
+    }
+
+    checkGlErrors();
+  }
+};
+
+// Shader state of the instanced crowd path: skinning palettes come from a
+// buffer texture and model transform, color and palette offset from
+// per-instance attributes
+struct InstancedShaderState {
+  GlProgram program;
+
+  // Handles to uniform variables
+  GLint h_uLight, h_uLight2;
+  GLint h_uProjMatrix;
+  GLint h_uViewMatrix;
+  GLint h_uPalette;
+
+  // Handles to vertex attributes
+  GLint h_aPosition;
+  GLint h_aNormal;
+  GLint h_aBoneNames;
+  GLint h_aBoneWeights;
+
+  // Handles to per instance attributes. aInstanceModel is a mat4 and spans
+  // four consecutive locations
+  GLint h_aInstanceModel;
+  GLint h_aInstanceColor;
+  GLint h_aPaletteBase;
+
+  InstancedShaderState(const char* vsfn, const char* fsfn) {
+    readAndCompileShader(program, vsfn, fsfn);
+
+    const GLuint h = program; // short hand
+
+    // Retrieve handles to uniform variables
+    h_uLight = safe_glGetUniformLocation(h, "uLight");
+    h_uLight2 = safe_glGetUniformLocation(h, "uLight2");
+    h_uProjMatrix = safe_glGetUniformLocation(h, "uProjMatrix");
+    h_uViewMatrix = safe_glGetUniformLocation(h, "uViewMatrix");
+    h_uPalette = safe_glGetUniformLocation(h, "uPalette");
+
+    // Retrieve handles to vertex attributes
+    h_aPosition = safe_glGetAttribLocation(h, "aPosition");
+    h_aNormal = safe_glGetAttribLocation(h, "aNormal");
+    h_aBoneNames = safe_glGetAttribLocation(h, "aBoneNames");
+    h_aBoneWeights = safe_glGetAttribLocation(h, "aBoneWeights");
+    h_aInstanceModel = safe_glGetAttribLocation(h, "aInstanceModel");
+    h_aInstanceColor = safe_glGetAttribLocation(h, "aInstanceColor");
+    h_aPaletteBase = safe_glGetAttribLocation(h, "aPaletteBase");
+
+    checkGlErrors();
+  }
+};
+
 static const int g_numShaders = 2;
 static const char * const g_shaderFiles[g_numShaders][2] = {
   {"./shaders/basic.vshader", "./shaders/diffuse.fshader"},
@@ -98,45 +203,43 @@ static const char * const g_shaderFiles[g_numShaders][2] = {
 };
 static vector<shared_ptr<ShaderState> > g_shaderStates; // our global shader states
 
-// --------- Geometry
-
-// Macro used to obtain relative offset of a field within a struct
-#define FIELD_OFFSET(StructType, field) &(((StructType *)0)->field)
-
-// A vertex with floating point position and normal and bone coordinates
-struct VertexPNB {
-  Cvec3f p, n, bw;
-  Cvec<int,3> bn;
+// Variants of basic.vshader skinning with fewer influences
+static const char * const g_skinShaderFiles[2][g_numShaders][2] = {
+  {{"./shaders/skin1.vshader", "./shaders/diffuse.fshader"},
+   {"./shaders/skin1.vshader", "./shaders/specular.fshader"}},
+  {{"./shaders/skin2.vshader", "./shaders/diffuse.fshader"},
+   {"./shaders/skin2.vshader", "./shaders/specular.fshader"}}
+};
+static vector<shared_ptr<ShaderState> > g_skinShaderStates[2]; // 1 and 2 influences
 
-  VertexPNB() {}
-  VertexPNB(float x, float y, float z,
-           float nx, float ny, float nz)
-    : p(x,y,z), n(nx, ny, nz)
-  {}
+static const char * const g_morphShaderFiles[g_numShaders][2] = {
+  {"./shaders/morph.vshader", "./shaders/diffuse.fshader"},
+  {"./shaders/morph.vshader", "./shaders/specular.fshader"}
+};
+static vector<shared_ptr<MorphShaderState> > g_morphShaderStates; // empty without GL 3.1
 
-  VertexPNB(const SmallVertex& v)
-	  : p(v.pos), n(v.normal), bn(v.boneNames), bw(v.boneWeights)
-  {}
+static const char * const g_instancedShaderFiles[g_numShaders][2] = {
+  {"./shaders/instanced.vshader", "./shaders/diffuse.fshader"},
+  {"./shaders/instanced.vshader", "./shaders/specular.fshader"}
+};
+static vector<shared_ptr<InstancedShaderState> > g_instancedShaderStates; // empty without GL 3.3
 
-  // Define copy constructor and assignment operator from GenericVertex so we can
-  // use make* functions from geometrymaker.h
-  VertexPNB(const GenericVertex& v) {
-    *this = v;
-  }
+// --------- Geometry
 
-  VertexPNB& operator = (const GenericVertex& v) {
-    p = v.pos;
-    n = v.normal;
-    return *this;
-  }
-};
+// Macro used to obtain relative offset of a field within a struct
+#define FIELD_OFFSET(StructType, field) &(((StructType *)0)->field)
 
 struct Geometry {
   GlBufferObject vbo, ibo;
   int vboLen, iboLen;
   int strips;
 
-  Geometry(VertexPNB *vtx, unsigned short *idx, int vboLen, int iboLen,int strip_count = 0) {
+  // Attribute locations a vertex array object was set up for. ShaderStates
+  // whose attributes end up at the same locations share one VAO.
+  typedef array<GLint, 4> VertexLayout;
+  map<VertexLayout, shared_ptr<GlVertexArrayObject> > vaos;
+
+  Geometry(const VertexPNB *vtx, const unsigned short *idx, int vboLen, int iboLen,int strip_count = 0) {
     this->vboLen = vboLen;
     this->iboLen = iboLen;
     this->strips = strip_count;
@@ -149,22 +252,43 @@ struct Geometry {
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned short) * iboLen, idx, GL_STATIC_DRAW);
   }
 
-  void draw(const ShaderState& curSS) {
+  // Returns the VAO matching the attribute layout of curSS, recording the
+  // attribute pointers and the ibo binding into it on first use
+  GLuint getVao(const ShaderState& curSS) {
+    const VertexLayout layout = {{curSS.h_aPosition, curSS.h_aNormal, curSS.h_aBoneNames, curSS.h_aBoneWeights}};
+    shared_ptr<GlVertexArrayObject>& vao = vaos[layout];
+    if (vao)
+      return *vao;
+
+    vao.reset(new GlVertexArrayObject());
+    glBindVertexArray(*vao);
+    setupAttribs(layout);
+    glBindVertexArray(0);
+    return *vao;
+  }
+
+  // Records the vertex attributes and the ibo into the currently bound VAO
+  void setupAttribs(const VertexLayout& layout) {
     // Enable the attributes used by our shader
-    safe_glEnableVertexAttribArray(curSS.h_aPosition);
-    safe_glEnableVertexAttribArray(curSS.h_aNormal);
-    safe_glEnableVertexAttribArray(curSS.h_aBoneNames);
-    safe_glEnableVertexAttribArray(curSS.h_aBoneWeights);
+    safe_glEnableVertexAttribArray(layout[0]);
+    safe_glEnableVertexAttribArray(layout[1]);
+    safe_glEnableVertexAttribArray(layout[2]);
+    safe_glEnableVertexAttribArray(layout[3]);
 
     // bind vbo
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    safe_glVertexAttribPointer(curSS.h_aPosition, 3, GL_FLOAT, GL_FALSE, sizeof(VertexPNB), FIELD_OFFSET(VertexPNB, p));
-    safe_glVertexAttribPointer(curSS.h_aNormal, 3, GL_FLOAT, GL_FALSE, sizeof(VertexPNB), FIELD_OFFSET(VertexPNB, n));
-    safe_glVertexAttribIPointer(curSS.h_aBoneNames, 3, GL_INT, sizeof(VertexPNB), FIELD_OFFSET(VertexPNB, bn));
-    safe_glVertexAttribPointer(curSS.h_aBoneWeights, 3, GL_FLOAT, GL_FALSE, sizeof(VertexPNB), FIELD_OFFSET(VertexPNB, bw));
+    safe_glVertexAttribPointer(layout[0], 3, GL_FLOAT, GL_FALSE, sizeof(VertexPNB), FIELD_OFFSET(VertexPNB, p));
+    safe_glVertexAttribPointer(layout[1], 3, GL_FLOAT, GL_FALSE, sizeof(VertexPNB), FIELD_OFFSET(VertexPNB, n));
+    safe_glVertexAttribIPointer(layout[2], 3, GL_INT, sizeof(VertexPNB), FIELD_OFFSET(VertexPNB, bn));
+    safe_glVertexAttribPointer(layout[3], 3, GL_FLOAT, GL_FALSE, sizeof(VertexPNB), FIELD_OFFSET(VertexPNB, bw));
 
-    // bind ibo
+    // bind ibo, the binding is part of the VAO state
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+  }
+
+  void draw(const ShaderState& curSS) {
+    glBindVertexArray(getVao(curSS));
+    countGlDraw(strips > 0 ? strips : 1);
 
     // draw!
     if(strips > 0)
@@ -174,25 +298,320 @@ struct Geometry {
     else
       glDrawElements(GL_TRIANGLES, iboLen, GL_UNSIGNED_SHORT, 0);
 
-    // Disable the attributes used by our shader
-    safe_glDisableVertexAttribArray(curSS.h_aPosition);
-    safe_glDisableVertexAttribArray(curSS.h_aNormal);
-    safe_glDisableVertexAttribArray(curSS.h_aBoneNames);
-    safe_glDisableVertexAttribArray(curSS.h_aBoneWeights);
+    glBindVertexArray(0);
+  }
+
+  // Uploads the vertices at the given sorted indices, with one
+  // glBufferSubData per run of nearby vertices
+  void updateVertices(const VertexPNB *vtx, const vector<int>& indices) {
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    for (size_t k = 0; k < indices.size();) {
+      const int first = indices[k];
+      int last = first;
+      while (++k < indices.size() && indices[k] - last <= 8)
+        last = indices[k];
+      glBufferSubData(GL_ARRAY_BUFFER, sizeof(VertexPNB) * first, sizeof(VertexPNB) * (last - first + 1), vtx + first);
+      countGlUpload(sizeof(VertexPNB) * (last - first + 1));
+    }
+  }
+
+  // Draws `count' indices of a triangle list starting at index `first'
+  void drawTriangles(const ShaderState& curSS, int first, int count) {
+    glBindVertexArray(getVao(curSS));
+    countGlDraw();
+    glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_SHORT, (const GLvoid*) (first * sizeof(unsigned short)));
+    glBindVertexArray(0);
+  }
+};
+
+// Per instance data of a crowd member, streamed as instanced attributes
+struct InstanceData {
+  GLfloat model[16];  // column-major model matrix
+  Cvec3f color;
+  GLint paletteBase;  // index of the first bone of the member's palette
+};
+
+// A crowd of skinned instances of one Geometry drawn with a single
+// glDrawElementsInstanced. All palettes live in one buffer texture; members
+// posed alike can share a palette through their palette offset.
+struct Crowd {
+  GlBufferObject instanceVbo, paletteTbo;
+  GlTexture paletteTex;
+  shared_ptr<Geometry> geometry;
+  int boneCount;
+
+  vector<InstanceData> instances;
+  vector<Matrix4> models;        // model matrix of each instance
+  vector<InstanceData> visible;  // instances that passed culling this frame
+  vector<GLfloat> palettes;      // boneCount*12 floats per palette
+
+  typedef array<GLint, 7> InstanceLayout;
+  map<InstanceLayout, shared_ptr<GlVertexArrayObject> > vaos;
+
+  Crowd(const shared_ptr<Geometry>& geometry, int boneCount, int paletteCount)
+    : geometry(geometry), boneCount(boneCount), palettes(paletteCount * boneCount * 12) {
+    glBindTexture(GL_TEXTURE_BUFFER, paletteTex);
+    glBindBuffer(GL_TEXTURE_BUFFER, paletteTbo);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(GLfloat) * palettes.size(), NULL, GL_STREAM_DRAW);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, paletteTbo);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+  }
+
+  // Returns the VAO matching the attribute layout of curSS, built on first
+  // use from the geometry's attributes plus the per instance ones
+  GLuint getVao(const InstancedShaderState& curSS) {
+    const InstanceLayout layout = {{curSS.h_aPosition, curSS.h_aNormal, curSS.h_aBoneNames, curSS.h_aBoneWeights,
+                                    curSS.h_aInstanceModel, curSS.h_aInstanceColor, curSS.h_aPaletteBase}};
+    shared_ptr<GlVertexArrayObject>& vao = vaos[layout];
+    if (vao)
+      return *vao;
+
+    vao.reset(new GlVertexArrayObject());
+    glBindVertexArray(*vao);
+    const Geometry::VertexLayout meshLayout = {{layout[0], layout[1], layout[2], layout[3]}};
+    geometry->setupAttribs(meshLayout);
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+    for (int c = 0; c < 4 && curSS.h_aInstanceModel >= 0; ++c) {
+      glEnableVertexAttribArray(curSS.h_aInstanceModel + c);
+      glVertexAttribPointer(curSS.h_aInstanceModel + c, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                            FIELD_OFFSET(InstanceData, model[4 * c]));
+      glVertexAttribDivisor(curSS.h_aInstanceModel + c, 1);
+    }
+    safe_glEnableVertexAttribArray(curSS.h_aInstanceColor);
+    safe_glVertexAttribPointer(curSS.h_aInstanceColor, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), FIELD_OFFSET(InstanceData, color));
+    safe_glVertexAttribDivisor(curSS.h_aInstanceColor, 1);
+    safe_glEnableVertexAttribArray(curSS.h_aPaletteBase);
+    safe_glVertexAttribIPointer(curSS.h_aPaletteBase, 1, GL_INT, sizeof(InstanceData), FIELD_OFFSET(InstanceData, paletteBase));
+    safe_glVertexAttribDivisor(curSS.h_aPaletteBase, 1);
+
+    glBindVertexArray(0);
+    return *vao;
+  }
+
+  void addInstance(const Matrix4& model, const Cvec3f& color, int palette) {
+    InstanceData d;
+    GpuMatrix4(model).writeTo(d.model);
+    d.color = color;
+    d.paletteBase = palette * boneCount;
+    instances.push_back(d);
+    models.push_back(model);
+  }
+
+  // Stores the first three rows of each bone matrix, which is all an affine
+  // matrix needs
+  void setPalette(int palette, const Matrix4 bones[]) {
+    GLfloat* dst = &palettes[palette * boneCount * 12];
+    for (int b = 0; b < boneCount; ++b) {
+      for (int i = 0; i < 12; ++i) {
+        *dst++ = GLfloat(bones[b][i]);
+      }
+    }
+  }
+
+  // Keeps the instances whose palette bounds, moved by their model matrix,
+  // intersect the frustum and sends them. Returns the number kept.
+  int cullInstances(const Frustum& frustum, const vector<Aabb>& paletteBounds) {
+    visible.clear();
+    for (size_t i = 0; i < instances.size(); ++i) {
+      const Aabb& bounds = paletteBounds[instances[i].paletteBase / boneCount];
+      if (!frustum.isOutside(transformAabb(models[i], bounds)))
+        visible.push_back(instances[i]);
+    }
+
+    if (!visible.empty()) {
+      glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+      glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceData) * visible.size(), &visible[0], GL_STREAM_DRAW);
+      countGlUpload(sizeof(InstanceData) * visible.size());
+    }
+    return (int) visible.size();
+  }
+
+  // Sends all palettes in one go, orphaning last frame's storage
+  void uploadPalettes() {
+    glBindBuffer(GL_TEXTURE_BUFFER, paletteTbo);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(GLfloat) * palettes.size(), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(GLfloat) * palettes.size(), &palettes[0]);
+    countGlUpload(sizeof(GLfloat) * palettes.size());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  }
+
+  void draw(const InstancedShaderState& curSS) {
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, paletteTex);
+    safe_glUniform1i(curSS.h_uPalette, 0);
+
+    glBindVertexArray(getVao(curSS));
+    const int count = (int) visible.size();
+    const int iboLen = geometry->iboLen, strips = geometry->strips;
+    countGlDraw(strips > 0 ? strips : 1);
+    if(strips > 0)
+      for(int s = 0;s < strips;s++)
+        glDrawElementsInstanced(GL_TRIANGLE_STRIP, iboLen/strips, GL_UNSIGNED_SHORT,
+             (const GLvoid*) (s*iboLen/strips*sizeof(unsigned short)), count);
+    else
+      glDrawElementsInstanced(GL_TRIANGLES, iboLen, GL_UNSIGNED_SHORT, 0, count);
+    glBindVertexArray(0);
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+  }
+};
+
+// The streams of a MorphSet in buffer textures, for morph.vshader
+struct MorphBuffers {
+  GlBufferObject deltaTbo, rangeTbo;
+  GlTexture deltaTex, rangeTex;
+
+  explicit MorphBuffers(const MorphSet& morphs) {
+    vector<short> deltas;
+    vector<int> ranges;
+    morphs.buildGpuStreams(deltas, ranges);
+    deltas.resize(max<size_t>(deltas.size(), 8));  // no empty buffers
+
+    glBindTexture(GL_TEXTURE_BUFFER, deltaTex);
+    glBindBuffer(GL_TEXTURE_BUFFER, deltaTbo);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(short) * deltas.size(), &deltas[0], GL_STATIC_DRAW);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA16I, deltaTbo);
+
+    glBindTexture(GL_TEXTURE_BUFFER, rangeTex);
+    glBindBuffer(GL_TEXTURE_BUFFER, rangeTbo);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(int) * ranges.size(), &ranges[0], GL_STATIC_DRAW);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32I, rangeTbo);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+  }
+
+  // Binds the streams to texture units 0 and 1 and sends the weights
+  void bind(const MorphShaderState& curSS, const MorphSet& morphs, const float weights[]) {
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, deltaTex);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, rangeTex);
+    glActiveTexture(GL_TEXTURE0);
+    safe_glUniform1i(curSS.h_uMorphDeltas, 0);
+    safe_glUniform1i(curSS.h_uMorphRanges, 1);
+    for (int t = 0; t < MORPH_MAX_TARGETS; ++t) {
+      const bool active = t < morphs.getTargetCount();
+      safe_glUniform1f(curSS.h_uMorphWeights[t], active ? weights[t] : 0);
+      if (active)
+        safe_glUniform2f(curSS.h_uMorphScales[t], morphs.getTarget(t).positionScale, morphs.getTarget(t).normalScale);
+    }
+  }
+};
+
+// GPU time of whole frames from GL_TIME_ELAPSED queries. A frame takes the
+// next of a few queries and the ones the GPU is done with are read back
+// later, so the CPU never waits for a result.
+struct GpuFrameTimer {
+  static const int QUERY_COUNT = 4;
+  GlQuery queries[QUERY_COUNT];
+  int begun, read;  // queries begun and read back so far
+
+  GpuFrameTimer() : begun(0), read(0) {}
+
+  // Returns false, leaving the frame untimed, when every query is in flight
+  bool begin() {
+    if (begun - read == QUERY_COUNT)
+      return false;
+    glBeginQuery(GL_TIME_ELAPSED, queries[begun % QUERY_COUNT]);
+    return true;
+  }
+
+  void end() {
+    glEndQuery(GL_TIME_ELAPSED);
+    ++begun;
+  }
+
+  // Adds the times of the frames the GPU has finished to stats
+  void collect(FrameStats& stats) {
+    for (; read < begun; ++read) {
+      const GLuint query = queries[read % QUERY_COUNT];
+      GLint available = 0;
+      glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available)
+        return;
+      GLuint64 ns = 0;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+      stats.addGpuFrame(ns / 1e6);
+    }
   }
 };
 
 // Vertex buffer and index buffer associated with the ground and surface geometry
 static shared_ptr<Geometry> g_ground, g_surface;
 static shared_ptr<Skeleton> g_skeleton;
+static shared_ptr<Crowd> g_crowd;
+
+// Bones of the surface drawn per palette, empty when the surface fits the
+// palette in one draw
+static vector<SkinPartition> g_surfacePartitions;
+static int g_paletteSize = g_maxBones;  // bones a partition may use (-palette)
+
+// Influences per vertex of the surface, after pruning
+static int g_surfaceInfluences = 3;
+// Bind space box of the vertices of each bone of the surface, for culling
+static vector<Aabb> g_surfaceBoneBounds;
+// Bones the vertices of the surface follow, plus their ancestors. Only
+// these are sampled, evaluated and uploaded.
+static BoneMask g_surfaceBones;
+static vector<int> g_skeletonParents;  // parent name of each bone, -1 for roots
+// Beyond these eye distances the surface is skinned with fewer influences
+static const double g_twoInfluenceDistance = 8.0, g_oneInfluenceDistance = 16.0;
+
+// Morph targets of the procedural surface, applied on the CPU or the GPU
+enum MorphMode { MORPH_OFF, MORPH_CPU, MORPH_GPU };
+static int g_morphMode = MORPH_OFF;
+static bool g_morphTimerRunning = false;
+static MorphSet g_morphs;
+static float g_morphWeights[MORPH_MAX_TARGETS];
+static shared_ptr<MorphApplier> g_morphApplier;  // CPU path
+static shared_ptr<MorphBuffers> g_morphBuffers;  // GPU path, null without GL 3.1
+
+// Poses, blend scratch space and palettes of the frame being drawn, all
+// released by display() once it is done
+static FrameArena g_frameArena(64 * 1024);
+static long long g_frameHeapAllocations = 0;  // operator new calls of the last frame
+static size_t g_frameArenaUsed = 0;           // arena bytes of the last frame
+
+// Frame time percentiles and work counters, shown by 'o' and logged to the
+// file of -stats every g_frameStatsReportFrames frames
+static FrameStats g_frameStats(300);
+static const int g_frameStatsReportFrames = 60;
+static long long g_frameStatsFrame = 0;
+static FrameCounters g_frameCounters;       // of the frame being drawn
+static vector<string> g_frameStatsLines;    // the overlay's text
+static bool g_showFrameStats = false;
+static shared_ptr<GpuFrameTimer> g_gpuTimer;         // null without timer queries
+static shared_ptr<FrameStatsLog> g_frameStatsLog;    // null without -stats
 
 // --------- Scene
 
-static const Cvec3 g_light1(2.0, 3.0, 14.0), g_light2(-2, -3.0, -5.0);  // define two lights positions in world space
+static constexpr Cvec3 g_light1(2.0, 3.0, 14.0), g_light2(-2, -3.0, -5.0);  // define two lights positions in world space
 static RigTForm g_skyRbt(Cvec3(0.0, 0.25, 4.0));
 static RigTForm g_objectRbt[1] = {RigTForm(Cvec3(0,-1,0))};  // One surface
 static Cvec3f g_objectColors[1] = {Cvec3f(0, 0, 1)};
 
+static const char* g_meshFile = NULL;  // baked mesh to draw instead of the procedural surface (-mesh)
+static const char* g_gltfFile = NULL;  // glTF asset to draw instead of the procedural character (-gltf)
+static const char* g_traceFile = NULL;  // written with the recorded zones at exit (-trace)
+static const char* g_statsFile = NULL;  // frame statistics log (-stats)
+static GltfImport g_gltf;              // animations of the imported asset
+
+static bool g_showCrowd = false;
+static const int g_crowdRows = 100, g_crowdCols = 100;  // 10k characters
+static const double g_crowdSpacing = 1.0;
+
+// Every member of the crowd plays g_crowdClip, offset in time, with its own
+// palette and at the animation LOD of its projected size
+static AnimRig g_crowdRig;
+static GltfAnimation g_crowdClip;
+static vector<Aabb> g_crowdPoseBounds;    // bounds of each member's last pose
+static double g_crowdTime = 0;            // seconds
+static const double g_crowdPhase = 0.37;  // time offset between neighbours
+static int g_crowdFrame = 0;
+static bool g_crowdTimerRunning = false;
+static AnimLodStats g_animLodStats;       // summed over g_animLodReportFrames
+static const int g_animLodReportFrames = 100;
+
 ///////////////// END OF G L O B A L S //////////////////////////////////////////////////
 
 static void initGround() {
@@ -207,40 +626,156 @@ static void initGround() {
   g_ground.reset(new Geometry(&vtx[0], &idx[0], 4, 6));
 }
 
-Cvec3f makeCylinderV(float s,float t) { return Cvec3f(0.4*cos(s),2*t,0.4*sin(s)); }
-Cvec3f makeCylinderN(float s,float t) { return Cvec3f(cos(s),0.0,sin(s)); }
-Cvec<int, 3> makeCylinderBN(float s, float t) { return Cvec<int, 3>(0, 1, 2); }
-Cvec3f makeCylinderBW(float s,float t) 
-{
-	if (t < 1.0 / 4)
-		return Cvec3f(1.0, 0.0, 0.0);
-	if (t < 5.0 / 12)
-		return Cvec3f(2.5 - 6 * t, -1.5 + 6 * t, 0.0);
-	if (t < 7.0 / 12)
-		return Cvec3f(0.0, 1.0, 0.0);
-	if (t < 3.0 / 4)
-		return Cvec3f(0.0, 4.5 - 6 * t, -3.5 + 6 * t);
-	return Cvec3f(0.0, 0.0, 1.0);
-}
-static void initSurface() {
+// Generates and optimizes the skinned cylinder
+static void makeCylinderMesh(vector<VertexPNB>& vtx, vector<unsigned short>& idx, int& strips) {
   int ibLen, vbLen;
   int sliceCount = 20;
   getSurfaceVbIbLen(20,true,sliceCount,false,vbLen, ibLen);
 
-  // Temporary storage for surface geometry
-  vector<VertexPNB> vtx(vbLen);
-  vector<unsigned short> idx(ibLen);
+  vtx.resize(vbLen);
+  idx.resize(ibLen);
+
+  makeSurfaceParallel(0.0,2*CS175_PI/20,20,true,0.0,1.0/sliceCount,sliceCount,false,
+                      CylinderMaker(), vtx.begin(), idx.begin());
+
+  strips = sliceCount;
+  // pruning first lets the optimizer weld vertices that only differed in
+  // their unused bones
+  printInfluenceStats("surface", pruneInfluences(vtx));
+  printMeshOptimizeStats("surface", optimizeMesh(vtx, idx, strips));
+}
+
+// A bulge around the middle joint and a pinch at the top. Only the
+// vertices of those bands end up in the targets.
+static void makeCylinderMorphs(const vector<VertexPNB>& vtx, MorphSet& morphs) {
+  vector<VertexPNB> bulge(vtx), pinch(vtx);
+  for (size_t i = 0; i < vtx.size(); ++i) {
+    const float y = vtx[i].p[1];
+    if (y > 0.5f && y < 1.5f) {
+      const float f = 1 + 0.3f * sin(float(CS175_PI) * (y - 0.5f));
+      bulge[i].p[0] *= f;
+      bulge[i].p[2] *= f;
+    }
+    if (y > 1.6f) {
+      const float f = 1 - 1.25f * (y - 1.6f);
+      pinch[i].p[0] *= f;
+      pinch[i].p[2] *= f;
+    }
+  }
+  morphs.addTarget("bulge", vtx, bulge);
+  morphs.addTarget("pinch", vtx, pinch);
+}
+
+// Writes the procedural surface to a mesh file that can later be loaded
+// with -mesh
+static void bakeSurface(const char* filename) {
+  vector<VertexPNB> vtx;
+  vector<unsigned short> idx;
+  int strips;
+  makeCylinderMesh(vtx, idx, strips);
+  writeMeshFile(filename, MESHFILE_FORMAT_VERTEXPNB, &vtx[0], sizeof(VertexPNB), (unsigned int) vtx.size(),
+                &idx[0], (unsigned int) idx.size(), strips);
+  cout << "Baked surface to " << filename << endl;
+}
+
+// The mapped sections are handed straight to glBufferData, without going
+// through an intermediate copy
+static shared_ptr<Geometry> loadMeshFile(const char* filename) {
+  MappedMeshFile file(filename);
+  const MeshFileHeader& h = file.getHeader();
+  if (h.vertexFormat != MESHFILE_FORMAT_VERTEXPNB || h.vertexStride != sizeof(VertexPNB))
+    throw runtime_error(string("Unsupported vertex format in ") + filename);
+
+  g_surfaceInfluences = countMeshInfluences(static_cast<const VertexPNB*>(file.getVertices()), h.vertexCount);
+  computeBoneBounds(static_cast<const VertexPNB*>(file.getVertices()), h.vertexCount, g_surfaceBoneBounds);
+  markReferencedBones(static_cast<const VertexPNB*>(file.getVertices()), h.vertexCount, g_surfaceBones.used);
+  return shared_ptr<Geometry>(new Geometry(static_cast<const VertexPNB*>(file.getVertices()), file.getIndices(),
+                                           h.vertexCount, h.indexCount, h.stripCount));
+}
+
+// Splits the surface into partitions of at most g_paletteSize bones,
+// replacing the bone names of its vertices by palette slots
+static void partitionSurface(const char* name, vector<VertexPNB>& vtx, vector<unsigned short>& idx, int& strips) {
+  if (strips > 0) {
+    vector<unsigned short> list;
+    stripsToList(&idx[0], (int) idx.size(), strips, list);
+    idx.swap(list);
+    strips = 0;
+  }
+
+  PartitionedSkin skin;
+  partitionSkin(vtx, idx, g_paletteSize, skin);
+  cout << name << ": " << skin.partitions.size() << " partitions of at most " << g_paletteSize << " bones, "
+       << skin.duplicatedVertices << " duplicated vertices (" << vtx.size() << " -> " << skin.vertices.size() << ")" << endl;
+
+  vtx.swap(skin.vertices);
+  idx.swap(skin.indices);
+  g_surfacePartitions.swap(skin.partitions);
+}
+
+// Replaces the procedural character by the skin, mesh and animations of a
+// glTF file
+static void importCharacter(const char* filename) {
+  g_skeleton.reset(new Skeleton());
+  importGltf(filename, *g_skeleton, g_gltf);
+  cout << "Imported " << filename << ": " << g_gltf.megabytes << " MB in " << g_gltf.milliseconds << " ms ("
+       << g_gltf.milliseconds / g_gltf.megabytes << " ms/MB), " << g_skeleton->getBoneCount() << " bones, "
+       << g_gltf.vertices.size() << " vertices, " << g_gltf.animations.size() << " animations" << endl;
+
+  const InfluenceStats influences = pruneInfluences(g_gltf.vertices);
+  printInfluenceStats(filename, influences);
+  g_surfaceInfluences = influences.maxInfluences;
+
+  int strips = 0;
+  printMeshOptimizeStats(filename, optimizeMesh(g_gltf.vertices, g_gltf.indices, strips));
+  computeBoneBounds(&g_gltf.vertices[0], (int) g_gltf.vertices.size(), g_surfaceBoneBounds);
+  markReferencedBones(&g_gltf.vertices[0], (int) g_gltf.vertices.size(), g_surfaceBones.used);
+  if (g_skeleton->getBoneCount() > g_paletteSize)
+    partitionSurface(filename, g_gltf.vertices, g_gltf.indices, strips);
+  g_surface.reset(new Geometry(&g_gltf.vertices[0], &g_gltf.indices[0], (int) g_gltf.vertices.size(), (int) g_gltf.indices.size()));
+
+  // the GPU has its copy now
+  vector<VertexPNB>().swap(g_gltf.vertices);
+  vector<unsigned short>().swap(g_gltf.indices);
+}
+
+static void initSurface() {
+  if (g_gltfFile != NULL) {
+    importCharacter(g_gltfFile);
+    return;
+  }
 
-  makeSurface(0.0,2*CS175_PI/20,20,true,0.0,1.0/sliceCount,sliceCount,false,
-              makeCylinderV,makeCylinderN, makeCylinderBN, makeCylinderBW, 
-              vtx.begin(), idx.begin());
+  if (g_meshFile != NULL)
+    g_surface = loadMeshFile(g_meshFile);
+  else {
+    // Temporary storage for surface geometry
+    vector<VertexPNB> vtx;
+    vector<unsigned short> idx;
+    int strips;
+    makeCylinderMesh(vtx, idx, strips);
+    g_surfaceInfluences = countMeshInfluences(&vtx[0], (int) vtx.size());
+    computeBoneBounds(&vtx[0], (int) vtx.size(), g_surfaceBoneBounds);
+    markReferencedBones(&vtx[0], (int) vtx.size(), g_surfaceBones.used);
+    if (g_paletteSize < 3)  // the procedural skeleton has 3 bones
+      partitionSurface("surface", vtx, idx, strips);
+    g_surface.reset(new Geometry(&vtx[0], &idx[0], (int) vtx.size(), (int) idx.size(), strips));
+
+    // morph the final vertices, so that targets survive any reordering
+    makeCylinderMorphs(vtx, g_morphs);
+    g_morphApplier.reset(new MorphApplier(vtx));
+    // the bone boxes hold the bind pose; grow them to hold any morph of it
+    const float morphReach = g_morphs.getMaxPositionDelta();
+    for (size_t b = 0; b < g_surfaceBoneBounds.size(); ++b)
+      g_surfaceBoneBounds[b].grow(morphReach);
+    if (!g_morphShaderStates.empty())
+      g_morphBuffers.reset(new MorphBuffers(g_morphs));
+  }
 
-  g_surface.reset(new Geometry(&vtx[0], &idx[0], vbLen, ibLen,sliceCount));
   g_skeleton.reset(new Skeleton());
 
-  Bone* added = g_skeleton->addBone(0, NULL, RigTForm());
-  added = g_skeleton->addBone(1, added, RigTForm(Cvec3(0.0, 2.0 / 3, 0.0)));
-  added = g_skeleton->addBone(2, added, RigTForm(Cvec3(0.0, 2.0 / 3, 0.0)));
+  Bone* added = NULL;
+  for (int b = 0; b < g_chainBoneCount; ++b)
+    added = g_skeleton->addBone(b, added, g_chainBindPose[b]);
 
 
   // Now tweak the bones
@@ -248,31 +783,26 @@ static void initSurface() {
 }
 
 // takes a projection matrix and send to the the shaders
-static void sendProjectionMatrix(const ShaderState& curSS, const Matrix4& projMatrix) {
-  GLfloat glmatrix[16];
-  projMatrix.writeToColumnMajorMatrix(glmatrix); // send projection matrix
-  safe_glUniformMatrix4fv(curSS.h_uProjMatrix, glmatrix);
+static void sendProjectionMatrix(const ShaderState& curSS, const GpuMatrix4& projMatrix) {
+  safe_glUniformMatrix4fv(curSS.h_uProjMatrix, projMatrix.data()); // send projection matrix
 }
 
-// takes MVM and its normal matrix to the shaders
-static void sendModelViewNormalMatrix(const ShaderState& curSS, const Matrix4& MVM, const Matrix4& NMVM) {
-  GLfloat glmatrix[16];
-  MVM.writeToColumnMajorMatrix(glmatrix); // send MVM
-  safe_glUniformMatrix4fv(curSS.h_uModelViewMatrix, glmatrix);
+// takes a single matrix to the shaders
+static void sendMatrix(const GLint handle, const GpuMatrix4& m) {
+  safe_glUniformMatrix4fv(handle, m.data());
+}
 
-  NMVM.writeToColumnMajorMatrix(glmatrix); // send NMVM
-  safe_glUniformMatrix4fv(curSS.h_uNormalMatrix, glmatrix);
+// takes MVM and its normal matrix to the shaders
+static void sendModelViewNormalMatrix(const ShaderState& curSS, const GpuMatrix4& MVM, const GpuMatrix4& NMVM) {
+  safe_glUniformMatrix4fv(curSS.h_uModelViewMatrix, MVM.data()); // send MVM
+  safe_glUniformMatrix4fv(curSS.h_uNormalMatrix, NMVM.data()); // send NMVM
 }
 
-// takes bone matrices to the shaders
-static void sendBones(const ShaderState& curSS, Matrix4 bones[], Matrix4 normals[],int boneCount) {
-  GLfloat glmatrix[16];
-  for(int n = 0;n < boneCount;n++) {
-	  bones[n].writeToColumnMajorMatrix(glmatrix); // send bones[n]
-	  safe_glUniformMatrix4fv(curSS.h_uBoneViewMatrix[n], glmatrix);
-	  normals[n].writeToColumnMajorMatrix(glmatrix); // send normals[n]
-	  safe_glUniformMatrix4fv(curSS.h_uBoneNormalMatrix[n], glmatrix);
-  }
+// takes bone matrices to the shaders, each array in one call: GpuMatrix4
+// is exactly its 16 floats, so the matrices are contiguous
+static void sendBones(const ShaderState& curSS, const GpuMatrix4 bones[], const GpuMatrix4 normals[],int boneCount) {
+  safe_glUniformMatrix4fv(curSS.h_uBoneViewMatrix, boneCount, bones[0].data()); // send bones
+  safe_glUniformMatrix4fv(curSS.h_uBoneNormalMatrix, boneCount, normals[0].data()); // send normals
 }
 
 // update g_frustFovY from g_frustMinFov, g_windowWidth, and g_windowHeight
@@ -291,13 +821,179 @@ static Matrix4 makeProjectionMatrix() {
            g_frustNear, g_frustFar);
 }
 
+// Members are animated at their level of detail and those outside the view
+// frustum are culled on the CPU, then all palettes
+// are uploaded in one buffer update and the rest is drawn by a single
+// instanced draw call
+static void drawCrowd(const Matrix4& projmat, const Matrix4& invEyeRbt, const Cvec3& eyeLight1, const Cvec3& eyeLight2) {
+  const Frustum frustum(projmat * invEyeRbt);
+  const int boneCount = g_skeleton->getBoneCount();
+  const int memberCount = (int) g_crowd->instances.size();
+  Matrix4* bones = g_frameArena.allocate<Matrix4>(boneCount);
+  Matrix4* models = g_frameArena.allocate<Matrix4>(boneCount);
+  RigTForm* locals = g_frameArena.allocate<RigTForm>(boneCount);
+
+  // members out of view run at the lowest level, which keeps their bounds
+  // fresh enough to notice when they come back in view
+  AnimLodStats& stats = g_animLodStats;
+  {
+    TRACE_ZONE("crowd animation");
+    for (int i = 0; i < memberCount; ++i) {
+      const Aabb bounds = transformAabb(g_crowd->models[i], g_crowdPoseBounds[i]);
+      int level = ANIMLOD_LEVEL_COUNT - 1;
+      if (!frustum.isOutside(bounds)) {
+        const Cvec3 center = Cvec3(invEyeRbt * Cvec4(bounds.getCenter(), 1));
+        level = selectAnimLod(projectedSize(center, bounds.getRadius(), g_frustFovY));
+      }
+      ++stats.instances[level];
+      if (!isAnimLodUpdate(level, i, g_crowdFrame))
+        continue;
+
+      const double t = fmod(g_crowdTime + g_crowdPhase * i, g_crowdClip.duration);
+      const int evaluated = evaluateAnimLod(g_crowdRig, g_crowdClip, t, level, locals, models, bones);
+      stats.bonesEvaluated += evaluated;
+      g_frameCounters.bonesEvaluated += evaluated;
+      ++stats.updates;
+      g_crowd->setPalette(i, bones);
+      g_crowdPoseBounds[i] = skinnedBounds(g_surfaceBoneBounds, bones, boneCount);
+    }
+  }
+  stats.bonesFull += memberCount * boneCount;
+
+  if (++g_crowdFrame % g_animLodReportFrames == 0) {
+    const double frames = g_animLodReportFrames;
+    cout << "Animation LOD per frame: " << stats.updates / frames << " of " << memberCount << " members updated, "
+         << stats.bonesEvaluated / frames << " bones evaluated (" << stats.bonesFull / frames << " without LOD), members per level";
+    for (int l = 0; l < ANIMLOD_LEVEL_COUNT; ++l)
+      cout << (l ? "/" : " ") << stats.instances[l] / frames;
+    cout << endl;
+    stats = AnimLodStats();
+  }
+
+  // cull before uploading anything
+  const int visibleCount = g_crowd->cullInstances(frustum, g_crowdPoseBounds);
+  if (visibleCount == 0)
+    return;
+  g_frameCounters.verticesSkinned += (long long) visibleCount * g_crowd->geometry->vboLen;
+
+  const InstancedShaderState& curSS = *g_instancedShaderStates[g_activeShader];
+  glUseProgram(curSS.program);
+
+  sendMatrix(curSS.h_uProjMatrix, GpuMatrix4(projmat));
+  sendMatrix(curSS.h_uViewMatrix, GpuMatrix4(invEyeRbt));
+  safe_glUniform3f(curSS.h_uLight, eyeLight1[0], eyeLight1[1], eyeLight1[2]);
+  safe_glUniform3f(curSS.h_uLight2, eyeLight2[0], eyeLight2[1], eyeLight2[2]);
+
+  {
+    TRACE_ZONE("crowd upload");
+    g_crowd->uploadPalettes();
+  }
+  {
+    TRACE_ZONE("crowd draw");
+    g_crowd->draw(curSS);
+  }
+
+  glUseProgram(g_shaderStates[g_activeShader]->program);
+}
+
+// Draws the skinned surface, unless its bounds posed by the current
+// skeleton are outside the view frustum. The test runs on the bones alone,
+// before anything is sent to the shaders.
+static void drawSurface(const ShaderState& curSS, const Matrix4& projmat, const Matrix4& invEyeRbt,
+                        const Cvec3& eyeLight1, const Cvec3& eyeLight2) {
+  // bones outside g_surfaceBones are never evaluated, no vertex follows them
+  const int boneCount = g_skeleton->getBoneCount();
+  const vector<int>& order = g_surfaceBones.order;
+  Matrix4* bones = g_frameArena.allocate<Matrix4>(boneCount);
+  Matrix4* models = g_frameArena.allocate<Matrix4>(boneCount);
+  {
+    TRACE_ZONE("pose");
+    evaluateBones(*g_skeleton, g_skeletonParents, order, models, bones);
+    multiplyMatrices(rigTFormToMatrix(g_objectRbt[0]), bones, bones, boneCount);
+    g_frameCounters.bonesEvaluated += (int) order.size();
+  }
+  if (Frustum(projmat * invEyeRbt).isOutside(skinnedBounds(g_surfaceBoneBounds, bones, boneCount)))
+    return;
+
+  // converted to the upload layout once, whichever partitions use them
+  GpuMatrix4* gpuBones = g_frameArena.allocate<GpuMatrix4>(boneCount);
+  GpuMatrix4* gpuNormals = g_frameArena.allocate<GpuMatrix4>(boneCount);
+  {
+    TRACE_ZONE("palette");
+    multiplyMatrices(invEyeRbt, bones, bones, boneCount);
+    for (size_t i = 0; i < order.size(); ++i) {
+      gpuBones[order[i]] = GpuMatrix4(bones[order[i]]);
+      gpuNormals[order[i]] = GpuMatrix4(normalMatrix(bones[order[i]]));
+    }
+  }
+
+  // skin with fewer influences from afar. Weights are sorted, so the
+  // variants use the largest ones.
+  const double eyeDistance = norm(Cvec3(invEyeRbt * Cvec4(g_objectRbt[0].getTranslation(), 1)));
+  int influences = max(1, g_surfaceInfluences);
+  if (eyeDistance > g_oneInfluenceDistance)
+    influences = 1;
+  else if (eyeDistance > g_twoInfluenceDistance)
+    influences = min(influences, 2);
+  const ShaderState& skinSS = g_morphMode == MORPH_GPU ? *g_morphShaderStates[g_activeShader] :
+                              influences < 3 ? *g_skinShaderStates[influences - 1][g_activeShader] : curSS;
+  if (&skinSS != &curSS) {
+    glUseProgram(skinSS.program);
+    sendProjectionMatrix(skinSS, GpuMatrix4(projmat));
+    safe_glUniform3f(skinSS.h_uLight, eyeLight1[0], eyeLight1[1], eyeLight1[2]);
+    safe_glUniform3f(skinSS.h_uLight2, eyeLight2[0], eyeLight2[1], eyeLight2[2]);
+  }
+
+  g_frameCounters.verticesSkinned += g_surface->vboLen;
+  safe_glUniform1i(skinSS.h_uUseBones,1);
+  safe_glUniform3f(skinSS.h_uColor, g_objectColors[0][0], g_objectColors[0][1], g_objectColors[0][2]);
+
+  // blend shapes, before skinning
+  if (g_morphMode == MORPH_CPU) {
+    TRACE_ZONE("morph");
+    g_morphApplier->apply(g_morphs, g_morphWeights);
+    g_surface->updateVertices(&g_morphApplier->getVertices()[0], g_morphApplier->getDirty());
+  }
+  else if (g_morphMode == MORPH_GPU)
+    g_morphBuffers->bind(*g_morphShaderStates[g_activeShader], g_morphs, g_morphWeights);
+  if (g_surfacePartitions.empty()) {
+    {
+      TRACE_ZONE("upload");
+      sendBones(skinSS,gpuBones,gpuNormals,boneCount);
+    }
+    TRACE_ZONE("draw");
+    g_surface->draw(skinSS);
+  }
+  else {
+    // each partition only uploads the bones its palette slots refer to
+    GpuMatrix4 partBones[g_maxBones], partNormals[g_maxBones];
+    for (size_t p = 0; p < g_surfacePartitions.size(); ++p) {
+      const SkinPartition& part = g_surfacePartitions[p];
+      const int slotCount = (int) part.bones.size();
+      {
+        TRACE_ZONE("upload");
+        for (int s = 0; s < slotCount; ++s) {
+          partBones[s] = gpuBones[part.bones[s]];
+          partNormals[s] = gpuNormals[part.bones[s]];
+        }
+        sendBones(skinSS, partBones, partNormals, slotCount);
+      }
+      TRACE_ZONE("draw");
+      g_surface->drawTriangles(skinSS, part.firstIndex, part.indexCount);
+    }
+  }
+  if (&skinSS != &curSS)
+    glUseProgram(curSS.program);
+}
+
 static void drawStuff() {
+  TRACE_ZONE("drawStuff");
   // short hand for current shader state
   const ShaderState& curSS = *g_shaderStates[g_activeShader];
 
   // build & send proj. matrix to vshader
   const Matrix4 projmat = makeProjectionMatrix();
-  sendProjectionMatrix(curSS, projmat);
+  sendProjectionMatrix(curSS, GpuMatrix4(projmat));
 
   // use the skyRbt as the eyeRbt
   const Matrix4 eyeRbt = rigTFormToMatrix(g_skyRbt);
@@ -314,23 +1010,50 @@ static void drawStuff() {
   const Matrix4 groundRbt = Matrix4();  // identity
   Matrix4 MVM = invEyeRbt * groundRbt;
   Matrix4 NMVM = normalMatrix(MVM);
-  sendModelViewNormalMatrix(curSS, MVM, NMVM);
+  sendModelViewNormalMatrix(curSS, GpuMatrix4(MVM), GpuMatrix4(NMVM));
   safe_glUniform1i(curSS.h_uUseBones,0);
   safe_glUniform3f(curSS.h_uColor, 0.1, 0.95, 0.1); // set color
   g_ground->draw(curSS);
 
   // draw shape
   // ==========
-  Matrix4 bones[3];
-  Matrix4 normals[3];
-  for(int n = 0;n < 3;n++) {
-	  bones[n] = invEyeRbt * rigTFormToMatrix(g_objectRbt[0])*g_skeleton->getNamedBone(n)->getBoneMatrix();
-      normals[n] = normalMatrix(bones[n]);
+  drawSurface(curSS, projmat, invEyeRbt, eyeLight1, eyeLight2);
+
+  if (g_showCrowd && g_crowd)
+    drawCrowd(projmat, invEyeRbt, eyeLight1, eyeLight2);
+}
+
+// Adds the frame just drawn to the statistics, summarizing them every
+// g_frameStatsReportFrames frames
+static void recordFrameStats(double cpuMs) {
+  g_frameCounters.drawCalls = g_glFrameCounters.drawCalls;
+  g_frameCounters.uniformUploads = g_glFrameCounters.uniformCalls;
+  g_frameCounters.bytesUploaded = g_glFrameCounters.bytesUploaded;
+  g_frameStats.addFrame(cpuMs, g_frameCounters);
+  if (g_gpuTimer)
+    g_gpuTimer->collect(g_frameStats);
+
+  if (++g_frameStatsFrame % g_frameStatsReportFrames == 0) {
+    const FrameStatsSummary summary = g_frameStats.summarize();
+    formatFrameStats(summary, g_frameStatsLines);
+    if (g_frameStatsLog)
+      g_frameStatsLog->write(glutGet(GLUT_ELAPSED_TIME) / 1000.0, summary);
   }
-  sendBones(curSS,bones,normals,3);
-  safe_glUniform1i(curSS.h_uUseBones,1);
-  safe_glUniform3f(curSS.h_uColor, g_objectColors[0][0], g_objectColors[0][1], g_objectColors[0][2]);
-  g_surface->draw(curSS);
+}
+
+// Writes the statistics in the top left corner with the GLUT bitmap font,
+// which draws at the fixed function raster position
+static void drawFrameStats() {
+  glUseProgram(0);
+  glDisable(GL_DEPTH_TEST);
+  glColor3f(0, 0, 0);
+  for (size_t i = 0; i < g_frameStatsLines.size(); ++i) {
+    glWindowPos2i(8, g_windowHeight - 16 * int(i + 1));
+    for (const char* c = g_frameStatsLines[i].c_str(); *c; ++c)
+      glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *c);
+  }
+  glEnable(GL_DEPTH_TEST);
+  glUseProgram(g_shaderStates[g_activeShader]->program);
 }
 
 static void display() {
@@ -344,9 +1067,30 @@ static void display() {
 	  glDisable(GL_MULTISAMPLE_ARB);
   }
 
-  drawStuff();
-
-  glutSwapBuffers();                                    // show the back buffer (where we rendered stuff)
+  // the CPU time is the frame's work, the GPU time that of its commands;
+  // neither includes waiting for the swap
+  g_frameCounters = FrameCounters();
+  g_glFrameCounters = GlFrameCounters();
+  const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  const bool gpuTimed = g_gpuTimer && g_gpuTimer->begin();
+  const long long allocations = getHeapAllocationCount();
+  {
+    TRACE_ZONE("display");
+    drawStuff();
+    g_frameArenaUsed = g_frameArena.getUsed();
+    g_frameArena.reset();
+  }
+  g_frameHeapAllocations = getHeapAllocationCount() - allocations;
+  if (gpuTimed)
+    g_gpuTimer->end();
+  recordFrameStats(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+  if (g_showFrameStats)
+    drawFrameStats();
+
+  {
+    TRACE_ZONE("swap");
+    glutSwapBuffers();                                    // show the back buffer (where we rendered stuff)
+  }
 
   checkGlErrors();
 }
@@ -367,7 +1111,7 @@ static void motion(const int x, const int y) {
 
   if (g_mouseClickDown) {
 
-	  if (g_mouseLClickButton && !g_mouseRClickButton) { // left button down?
+	  if (g_mouseLClickButton && !g_mouseRClickButton && bn < g_skeleton->getBoneCount()) { // left button down?
 		  //g_objectRbt[0].setRotation(g_objectRbt[0].getRotation()*Quat::makeXRotation(-dy) * Quat::makeYRotation(dx));
 		  g_skeleton->getNamedBone(bn)->rotate(Quat::makeZRotation(-dy)* Quat::makeZRotation(-dx));
 	  }
@@ -404,13 +1148,15 @@ static void mouse(const int button, const int state, const int x, const int y) {
 
 Quat currkey0, currkey1, currkey2;
 
+// The keys are constants, built at compile time
 static void keyFrameAnimate(int x) {
-	Quat key01(Quat::makeZRotation(60));
-	Quat key02 = Quat();
-	Quat key11(Quat::makeZRotation(30));
-	Quat key12(Quat::makeZRotation(-10));
-	Quat key21(Quat::makeZRotation(20));
-	Quat key22(Quat::makeZRotation(10));
+	TRACE_ZONE("animation");
+	static constexpr Quat key01 = Quat::makeConstZRotation(60);
+	static constexpr Quat key02 = Quat();
+	static constexpr Quat key11 = Quat::makeConstZRotation(30);
+	static constexpr Quat key12 = Quat::makeConstZRotation(-10);
+	static constexpr Quat key21 = Quat::makeConstZRotation(20);
+	static constexpr Quat key22 = Quat::makeConstZRotation(10);
 	if (x == 0) {
 		currkey0 = g_skeleton->getNamedBone(0)->getRotation();
 		currkey1 = g_skeleton->getNamedBone(1)->getRotation();
@@ -440,12 +1186,13 @@ static void keyFrameAnimate(int x) {
 }
 
 static void keyFrameAnimate2(int x) {
-	Quat key01(Quat::makeZRotation(60));
-	Quat key02 = Quat();
-	Quat key11(Quat::makeXRotation(30)*Quat::makeYRotation(-20));
-	Quat key12(Quat::makeYRotation(-50));
-	Quat key21(Quat::makeYRotation(20));
-	Quat key22(Quat::makeXRotation(10) * Quat::makeZRotation(90));
+	TRACE_ZONE("animation");
+	static constexpr Quat key01 = Quat::makeConstZRotation(60);
+	static constexpr Quat key02 = Quat();
+	static constexpr Quat key11 = Quat::makeConstXRotation(30)*Quat::makeConstYRotation(-20);
+	static constexpr Quat key12 = Quat::makeConstYRotation(-50);
+	static constexpr Quat key21 = Quat::makeConstYRotation(20);
+	static constexpr Quat key22 = Quat::makeConstXRotation(10) * Quat::makeConstZRotation(90);
 	if (x == 0) {
 		currkey0 = g_skeleton->getNamedBone(0)->getRotation();
 		currkey1 = g_skeleton->getNamedBone(1)->getRotation();
@@ -474,6 +1221,84 @@ static void keyFrameAnimate2(int x) {
 	}
 }
 
+// Plays the first animation of the imported asset in real time
+static void playImportedAnimation(int x) {
+  TRACE_ZONE("animation");
+  const GltfAnimation& anim = g_gltf.animations[0];
+  const double t = x * 0.02;
+  sampleGltfAnimation(anim, std::min(t, anim.duration), *g_skeleton, &g_surfaceBones.used);
+  glutPostRedisplay();
+  if (t < anim.duration)
+    glutTimerFunc(20, playImportedAnimation, x + 1);
+}
+
+// A looping two second sway of every bone about z, for the crowd when the
+// asset brings no animation of its own
+static GltfAnimation makeSwayClip() {
+  static const double amplitudes[] = {15, 30, 20};  // degrees
+  static const double phases[] = {0, 1, 0, -1, 0};
+  GltfAnimation clip;
+  clip.name = "sway";
+  clip.duration = 2;
+  for (int b = 0; b < g_skeleton->getBoneCount(); ++b) {
+    GltfChannel ch;
+    ch.bone = b;
+    ch.rotation = true;
+    ch.step = false;
+    for (int k = 0; k < 5; ++k) {
+      const Quat q = Quat::makeZRotation(phases[k] * amplitudes[b % 3]);
+      ch.times.push_back(float(0.5 * k));
+      ch.values.push_back(Cvec4(q[0], q[1], q[2], q[3]));
+    }
+    clip.channels.push_back(ch);
+  }
+  return clip;
+}
+
+// Advances the crowd's clock while it is shown
+static void animateCrowd(int x) {
+  if (!g_showCrowd) {
+    g_crowdTimerRunning = false;
+    return;
+  }
+  g_crowdTime += 0.02;
+  glutPostRedisplay();
+  glutTimerFunc(20, animateCrowd, x + 1);
+}
+
+// Swings the morph weights while morphing is on
+static void animateMorphs(int x) {
+  if (g_morphMode == MORPH_OFF) {
+    g_morphTimerRunning = false;
+    return;
+  }
+  g_morphWeights[0] = float(0.5 - 0.5 * cos(x * 0.05));
+  g_morphWeights[1] = float(0.5 - 0.5 * cos(x * 0.031));
+  glutPostRedisplay();
+  glutTimerFunc(20, animateMorphs, x + 1);
+}
+
+// Cycles morphing off, on the CPU and on the GPU (when available)
+static void cycleMorphMode() {
+  if (!g_morphApplier)
+    return;
+  if (g_morphMode == MORPH_CPU) {
+    // put the base vertices back
+    const float zeros[MORPH_MAX_TARGETS] = {0};
+    g_morphApplier->apply(g_morphs, zeros);
+    g_surface->updateVertices(&g_morphApplier->getVertices()[0], g_morphApplier->getDirty());
+  }
+  g_morphMode = g_morphMode == MORPH_OFF ? MORPH_CPU :
+                g_morphMode == MORPH_CPU && g_morphBuffers ? MORPH_GPU : MORPH_OFF;
+
+  static const char* const names[] = {"off", "CPU", "GPU"};
+  cout << "Morph targets: " << names[g_morphMode] << endl;
+  if (g_morphMode != MORPH_OFF && !g_morphTimerRunning) {
+    g_morphTimerRunning = true;
+    glutTimerFunc(20, animateMorphs, 0);
+  }
+}
+
 static void keyboard(const unsigned char key, const int x, const int y) {
   switch (key) {
   case 27:
@@ -485,6 +1310,11 @@ static void keyboard(const unsigned char key, const int x, const int y) {
     << "1\t\tDiffuse only\n"
 	<< "2\t\tDiffuse and specular\n"
 	<< "a\t\tAnimate shape\n"
+	<< "c\t\tShow instanced crowd\n"
+	<< "m\t\tMorph targets off, on the CPU, on the GPU\n"
+	<< "f\t\tPrint heap allocations and frame arena use of the last frame\n"
+	<< "t\t\tWrite the recorded timing zones to trace.json\n"
+	<< "o\t\tShow frame time percentiles and counters\n"
     << "drag left mouse to rotate\n" << endl;
     break;
   case 's':
@@ -507,10 +1337,36 @@ static void keyboard(const unsigned char key, const int x, const int y) {
 	  bn = 2;
 	  break;
   case 'k':
-	  glutTimerFunc(20, keyFrameAnimate, 0);
+	  if (!g_gltf.animations.empty())
+		  glutTimerFunc(20, playImportedAnimation, 0);
+	  else if (g_gltfFile == NULL)
+		  glutTimerFunc(20, keyFrameAnimate, 0);
 	  break;
   case 'l':
-	  glutTimerFunc(20, keyFrameAnimate2, 0);
+	  if (g_gltfFile == NULL)
+		  glutTimerFunc(20, keyFrameAnimate2, 0);
+	  break;
+  case 'c':
+	  g_showCrowd = !g_showCrowd && g_crowd;
+	  if (g_showCrowd && !g_crowdTimerRunning) {
+		  g_crowdTimerRunning = true;
+		  glutTimerFunc(20, animateCrowd, 0);
+	  }
+	  break;
+  case 'm':
+	  cycleMorphMode();
+	  break;
+  case 'f':
+	  cout << "Last frame: " << g_frameHeapAllocations << " heap allocations, " << g_frameArenaUsed
+	       << " bytes of frame arena (peak " << g_frameArena.getPeak() << " of " << g_frameArena.getCapacity() << ")" << endl;
+	  break;
+  case 'o':
+	  g_showFrameStats = !g_showFrameStats;
+	  if (g_frameStatsLines.empty())
+		  formatFrameStats(g_frameStats.summarize(), g_frameStatsLines);
+	  break;
+  case 't':
+	  cout << "Wrote " << writeTrace("trace.json") << " zones to trace.json" << endl;
 	  break;
   }
   glutPostRedisplay();
@@ -543,6 +1399,12 @@ static void initGLState() {
   int samples;
   glGetIntegerv(GL_SAMPLES, &samples);
   cout << "Number of samples is " << samples << endl;
+
+  // timer queries are core in 3.3
+  if (GLEW_VERSION_3_3 || GLEW_ARB_timer_query)
+    g_gpuTimer.reset(new GpuFrameTimer());
+  else
+    cerr << "Timer queries are not supported, GPU frame times are not measured" << endl;
 }
 
 static void initShaders() {
@@ -550,15 +1412,159 @@ static void initShaders() {
   for (int i = 0; i < g_numShaders; ++i) {
     g_shaderStates[i].reset(new ShaderState(g_shaderFiles[i][0], g_shaderFiles[i][1]));
   }
+  for (int n = 0; n < 2; ++n) {
+    g_skinShaderStates[n].resize(g_numShaders);
+    for (int i = 0; i < g_numShaders; ++i)
+      g_skinShaderStates[n][i].reset(new ShaderState(g_skinShaderFiles[n][i][0], g_skinShaderFiles[n][i][1], false));
+  }
+
+  // buffer textures are core in 3.1
+  if (GLEW_VERSION_3_1) {
+    g_morphShaderStates.resize(g_numShaders);
+    for (int i = 0; i < g_numShaders; ++i)
+      g_morphShaderStates[i].reset(new MorphShaderState(g_morphShaderFiles[i][0], g_morphShaderFiles[i][1]));
+  }
+
+  // instanced arrays are core in 3.3
+  if (!GLEW_VERSION_3_3) {
+    cerr << "OpenGL 3.3 is not supported, the instanced crowd is disabled" << endl;
+    return;
+  }
+  g_instancedShaderStates.resize(g_numShaders);
+  for (int i = 0; i < g_numShaders; ++i) {
+    g_instancedShaderStates[i].reset(new InstancedShaderState(g_instancedShaderFiles[i][0], g_instancedShaderFiles[i][1]));
+  }
+}
+
+// A grid of g_crowdRows x g_crowdCols characters around the object
+static void initCrowd() {
+  if (g_instancedShaderStates.empty())
+    return;
+  // the instanced shader reads whole skeleton palettes by bone name
+  if (!g_surfacePartitions.empty()) {
+    cerr << "The surface is partitioned, the instanced crowd is disabled" << endl;
+    return;
+  }
+
+  const int boneCount = g_skeleton->getBoneCount();
+  g_crowd.reset(new Crowd(g_surface, boneCount, g_crowdRows * g_crowdCols));
+  for (int r = 0; r < g_crowdRows; ++r) {
+    for (int c = 0; c < g_crowdCols; ++c) {
+      const Cvec3 t((c - g_crowdCols / 2) * g_crowdSpacing, -1, -(r + 1) * g_crowdSpacing);
+      const Cvec3f color(float(r) / g_crowdRows, float(c) / g_crowdCols, 1);
+      g_crowd->addInstance(Matrix4::makeTranslation(t), color, r * g_crowdCols + c);
+    }
+  }
+
+  // pose everybody fully once so all palettes and bounds are valid before
+  // the levels of detail kick in
+  buildAnimRig(*g_skeleton, g_surfaceBones, g_crowdRig);
+  g_crowdClip = g_gltf.animations.empty() ? makeSwayClip() : g_gltf.animations[0];
+  vector<Matrix4> bones(boneCount), models(boneCount);
+  vector<RigTForm> locals(boneCount);
+  g_crowdPoseBounds.resize(g_crowd->instances.size());
+  for (int i = 0; i < (int) g_crowd->instances.size(); ++i) {
+    evaluateAnimLod(g_crowdRig, g_crowdClip, fmod(g_crowdPhase * i, g_crowdClip.duration), 0, &locals[0], &models[0], &bones[0]);
+    g_crowd->setPalette(i, &bones[0]);
+    g_crowdPoseBounds[i] = skinnedBounds(g_surfaceBoneBounds, &bones[0], boneCount);
+  }
+}
+
+// Completes g_surfaceBones once the skeleton is known. Throws
+// runtime_error when the surface follows bones the skeleton does not have.
+static void initSurfaceBones() {
+  if ((int) g_surfaceBones.used.size() > g_skeleton->getBoneCount())
+    throw runtime_error("The surface references more bones than the skeleton has");
+  g_skeleton->getParentNames(g_skeletonParents);
+  finishBoneMask(g_skeletonParents, g_surfaceBones);
+  cout << "The surface uses " << g_surfaceBones.order.size() << " of " << g_skeleton->getBoneCount() << " bones" << endl;
 }
 
 static void initGeometry() {
   initGround();
   initSurface();
+  initSurfaceBones();
+  initCrowd();
+}
+
+// The trace of -trace. ESC leaves through exit(), so this runs from atexit.
+static void writeTraceAtExit() {
+  try {
+    cout << "Wrote " << writeTrace(g_traceFile) << " zones to " << g_traceFile << endl;
+  }
+  catch (const runtime_error& e) {
+    cout << "Exception caught: " << e.what() << endl;
+  }
 }
 
 int main(int argc, char * argv[]) {
   try {
+    // -bake <file> writes the procedural surface and exits, -mesh <file>
+    // draws a baked mesh instead of it and -gltf <file> replaces the whole
+    // character by an imported one. -bench-geometry times the surface
+    // generators, -bench-skinning the CPU skinning kernels and -bench-skeleton
+    // the fixed skeleton against the generic one, -bench-fused the fused
+    // matrix operations against the operators and -bench-math [<file>] every
+    // math operation, writing JSON to the file if given. -bench-crowd
+    // [<characters> [<bones> [<clips> [<frames>]]]] runs the CPU side of a
+    // crowd headless, stage by stage. -check-accuracy compares the fast
+    // paths against the reference ones and exits with 1 if any strays past
+    // its limits. -palette <n> limits the bones drawn at once, partitioning
+    // the procedural or imported surface if it uses more, -trace <file>
+    // writes the timing zones recorded over the run to the file at exit and
+    // -stats <file> logs frame statistics to it, as JSON lines if the name
+    // ends in .json and as CSV otherwise
+    for (int i = 1; i < argc; ++i) {
+      if (strcmp(argv[i], "-bench-geometry") == 0) {
+        benchGeometry();
+        return 0;
+      }
+      if (strcmp(argv[i], "-bench-skinning") == 0) {
+        benchSkinning();
+        return 0;
+      }
+      if (strcmp(argv[i], "-bench-skeleton") == 0) {
+        benchSkeleton();
+        return 0;
+      }
+      if (strcmp(argv[i], "-bench-fused") == 0) {
+        benchFused();
+        return 0;
+      }
+      if (strcmp(argv[i], "-bench-math") == 0) {
+        benchMath(i + 1 < argc ? argv[i + 1] : NULL);
+        return 0;
+      }
+      if (strcmp(argv[i], "-bench-crowd") == 0) {
+        CrowdBenchConfig config = CROWDBENCH_DEFAULTS;
+        int* settings[] = {&config.characters, &config.bones, &config.clips, &config.frames};
+        for (int s = 0; s < 4 && i + 1 + s < argc && argv[i + 1 + s][0] != '-'; ++s)
+          *settings[s] = max(1, atoi(argv[i + 1 + s]));
+        benchCrowd(config);
+        return 0;
+      }
+      if (strcmp(argv[i], "-check-accuracy") == 0)
+        return checkAccuracy(ACCURACY_DEFAULTS) ? 0 : 1;
+      if (strcmp(argv[i], "-bake") == 0) {
+        bakeSurface(i + 1 < argc ? argv[i + 1] : "surface.mesh");
+        return 0;
+      }
+      if (strcmp(argv[i], "-mesh") == 0 && i + 1 < argc)
+        g_meshFile = argv[i + 1];
+      if (strcmp(argv[i], "-gltf") == 0 && i + 1 < argc)
+        g_gltfFile = argv[i + 1];
+      if (strcmp(argv[i], "-palette") == 0 && i + 1 < argc)
+        g_paletteSize = max(1, min(g_maxBones, atoi(argv[i + 1])));
+      if (strcmp(argv[i], "-trace") == 0 && i + 1 < argc)
+        g_traceFile = argv[i + 1];
+      if (strcmp(argv[i], "-stats") == 0 && i + 1 < argc)
+        g_statsFile = argv[i + 1];
+    }
+    if (g_statsFile != NULL)
+      g_frameStatsLog.reset(new FrameStatsLog(g_statsFile));
+    if (g_traceFile != NULL)
+      atexit(writeTraceAtExit);
+
     initGlutState(argc,argv);
 
     glewInit(); // load the OpenGL extensions
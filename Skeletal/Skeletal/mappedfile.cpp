@@ -0,0 +1,63 @@
+#include <string>
+#include <stdexcept>
+
+#ifdef _WIN32
+# define WIN32_LEAN_AND_MEAN
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+#endif
+
+#include "mappedfile.h"
+
+using namespace std;
+
+MappedFile::MappedFile(const char* filename) {
+  const void* base = NULL;
+#ifdef _WIN32
+  file_ = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (file_ == INVALID_HANDLE_VALUE)
+    throw runtime_error(string("Cannot open file ") + filename);
+  LARGE_INTEGER fileSize;
+  GetFileSizeEx(file_, &fileSize);
+  size_ = size_t(fileSize.QuadPart);
+  mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapping_ != NULL)
+    base = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+  if (base == NULL) {
+    if (mapping_ != NULL)
+      CloseHandle(mapping_);
+    CloseHandle(file_);
+    throw runtime_error(string("Cannot map file ") + filename);
+  }
+#else
+  fd_ = open(filename, O_RDONLY);
+  if (fd_ < 0)
+    throw runtime_error(string("Cannot open file ") + filename);
+  struct stat st;
+  fstat(fd_, &st);
+  size_ = size_t(st.st_size);
+  base = size_ > 0 ? mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd_, 0) : MAP_FAILED;
+  if (base == MAP_FAILED) {
+    close(fd_);
+    throw runtime_error(string("Cannot map file ") + filename);
+  }
+  // files are consumed front to back
+  madvise(const_cast<void*>(base), size_, MADV_SEQUENTIAL);
+#endif
+  data_ = static_cast<const char*>(base);
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+  UnmapViewOfFile(data_);
+  CloseHandle(mapping_);
+  CloseHandle(file_);
+#else
+  munmap(const_cast<char*>(data_), size_);
+  close(fd_);
+#endif
+}
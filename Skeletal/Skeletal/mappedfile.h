@@ -0,0 +1,34 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+
+// A read-only memory mapping of a whole file. The data stays valid for the
+// lifetime of the object. Throws runtime_error if the file cannot be mapped.
+class MappedFile {
+  const char* data_;
+  size_t size_;
+#ifdef _WIN32
+  void* file_;
+  void* mapping_;
+#else
+  int fd_;
+#endif
+
+  MappedFile(const MappedFile&);
+  const MappedFile& operator= (const MappedFile&);
+
+public:
+  explicit MappedFile(const char* filename);
+  ~MappedFile();
+
+  const char* getData() const {
+    return data_;
+  }
+
+  size_t getSize() const {
+    return size_;
+  }
+};
+
+#endif
@@ -0,0 +1,425 @@
+#include <cmath>
+
+#if defined(__AVX__)
+#define MATHBATCH_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MATHBATCH_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "mathbatch.h"
+
+using namespace std;
+
+// the kernels read and write the objects as plain arrays of doubles
+static_assert(sizeof(Cvec3) == 3 * sizeof(double), "Cvec3 must be three packed doubles");
+static_assert(sizeof(Cvec4) == 4 * sizeof(double), "Cvec4 must be four packed doubles");
+static_assert(sizeof(Quat) == 4 * sizeof(double), "Quat must be four packed doubles");
+static_assert(sizeof(Matrix4) == 16 * sizeof(double), "Matrix4 must be sixteen packed doubles");
+
+#ifdef MATHBATCH_AVX
+// a * b + c, fused where the target has FMA
+#if defined(__FMA__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define MATHBATCH_MADD(a, b, c) _mm256_fmadd_pd(a, b, c)
+#else
+#define MATHBATCH_MADD(a, b, c) _mm256_add_pd(_mm256_mul_pd(a, b), c)
+#endif
+
+// Column j of a row-major matrix
+static __m256d loadColumn(const double* m, int j) {
+  return _mm256_setr_pd(m[j], m[4 + j], m[8 + j], m[12 + j]);
+}
+#endif
+
+#ifdef MATHBATCH_SSE2
+static __m128d madd(__m128d a, __m128d b, __m128d c) {
+  return _mm_add_pd(_mm_mul_pd(a, b), c);
+}
+#endif
+
+void transformVectors(const Matrix4& m, const Cvec4 in[], Cvec4 out[], int n) {
+  const double* src = reinterpret_cast<const double*>(in);
+  double* dst = reinterpret_cast<double*>(out);
+  const double* md = &m[0];
+  int i = 0;
+#if defined(MATHBATCH_AVX)
+  const __m256d c0 = loadColumn(md, 0), c1 = loadColumn(md, 1), c2 = loadColumn(md, 2), c3 = loadColumn(md, 3);
+  for (; i < n; ++i, src += 4, dst += 4) {
+    __m256d r = _mm256_mul_pd(c0, _mm256_broadcast_sd(src));
+    r = MATHBATCH_MADD(c1, _mm256_broadcast_sd(src + 1), r);
+    r = MATHBATCH_MADD(c2, _mm256_broadcast_sd(src + 2), r);
+    r = MATHBATCH_MADD(c3, _mm256_broadcast_sd(src + 3), r);
+    _mm256_storeu_pd(dst, r);
+  }
+#elif defined(MATHBATCH_SSE2)
+  // columns split in their top (rows 0, 1) and bottom (rows 2, 3) halves
+  __m128d top[4], bottom[4];
+  for (int j = 0; j < 4; ++j) {
+    top[j] = _mm_setr_pd(md[j], md[4 + j]);
+    bottom[j] = _mm_setr_pd(md[8 + j], md[12 + j]);
+  }
+  for (; i < n; ++i, src += 4, dst += 4) {
+    __m128d rt = _mm_setzero_pd(), rb = _mm_setzero_pd();
+    for (int j = 0; j < 4; ++j) {
+      const __m128d v = _mm_set1_pd(src[j]);
+      rt = madd(top[j], v, rt);
+      rb = madd(bottom[j], v, rb);
+    }
+    _mm_storeu_pd(dst, rt);
+    _mm_storeu_pd(dst + 2, rb);
+  }
+#endif
+  for (; i < n; ++i)
+    out[i] = m * in[i];
+}
+
+// out[i] = m * (in[i], 1) for the affine m given by its top three rows as
+// twelve row-major doubles
+static void transformPointsAffine(const double* md, const Cvec3 in[], Cvec3 out[], int n) {
+  const double* src = reinterpret_cast<const double*>(in);
+  double* dst = reinterpret_cast<double*>(out);
+  int i = 0;
+#if defined(MATHBATCH_AVX)
+  const __m256d c0 = _mm256_setr_pd(md[0], md[4], md[8], 0), c1 = _mm256_setr_pd(md[1], md[5], md[9], 0);
+  const __m256d c2 = _mm256_setr_pd(md[2], md[6], md[10], 0), c3 = _mm256_setr_pd(md[3], md[7], md[11], 0);
+  for (; i < n; ++i, src += 3, dst += 3) {
+    __m256d r = MATHBATCH_MADD(c0, _mm256_broadcast_sd(src), c3);
+    r = MATHBATCH_MADD(c1, _mm256_broadcast_sd(src + 1), r);
+    r = MATHBATCH_MADD(c2, _mm256_broadcast_sd(src + 2), r);
+    // three lanes only, the fourth would run into the next point
+    _mm_storeu_pd(dst, _mm256_castpd256_pd128(r));
+    _mm_store_sd(dst + 2, _mm256_extractf128_pd(r, 1));
+  }
+#elif defined(MATHBATCH_SSE2)
+  // two points at a time, one per lane, transposed in and out by unpacks
+  __m128d e[12];
+  for (int k = 0; k < 12; ++k)
+    e[k] = _mm_set1_pd(md[k]);
+  for (; i + 2 <= n; i += 2, src += 6, dst += 6) {
+    const __m128d p0 = _mm_loadu_pd(src), p1 = _mm_loadu_pd(src + 3);
+    const __m128d x = _mm_unpacklo_pd(p0, p1), y = _mm_unpackhi_pd(p0, p1);
+    const __m128d z = _mm_loadh_pd(_mm_load_sd(src + 2), src + 5);
+    const __m128d rx = madd(e[0], x, madd(e[1], y, madd(e[2], z, e[3])));
+    const __m128d ry = madd(e[4], x, madd(e[5], y, madd(e[6], z, e[7])));
+    const __m128d rz = madd(e[8], x, madd(e[9], y, madd(e[10], z, e[11])));
+    _mm_storeu_pd(dst, _mm_unpacklo_pd(rx, ry));
+    _mm_store_sd(dst + 2, rz);
+    _mm_storeu_pd(dst + 3, _mm_unpackhi_pd(rx, ry));
+    _mm_storeh_pd(dst + 5, rz);
+  }
+#endif
+  for (; i < n; ++i, src += 3, dst += 3) {
+    for (int r = 0; r < 3; ++r)
+      dst[r] = md[4 * r] * src[0] + md[4 * r + 1] * src[1] + md[4 * r + 2] * src[2] + md[4 * r + 3];
+  }
+}
+
+void transformPoints(const Matrix4& m, const Cvec3 in[], Cvec3 out[], int n) {
+  transformPointsAffine(&m[0], in, out, n);
+}
+
+// The rotation is applied as the 3x3 matrix of its unit quaternion, made
+// once for the whole array: 9 multiplies a point instead of the 15 of
+// rotating by the quaternion itself
+void transformPoints(const RigTForm& tform, const Cvec3 in[], Cvec3 out[], int n) {
+  const UnitQuat& q = tform.getRotation();
+  const Cvec3& t = tform.getTranslation();
+  const double w = q[0], x = q[1], y = q[2], z = q[3];
+  const double x2 = 2 * x, y2 = 2 * y, z2 = 2 * z;
+  const double xx = x * x2, yy = y * y2, zz = z * z2, xy = x * y2, xz = x * z2, yz = y * z2;
+  const double wx = w * x2, wy = w * y2, wz = w * z2;
+  const double rows[12] = {
+    1 - (yy + zz), xy - wz, xz + wy, t[0],
+    xy + wz, 1 - (xx + zz), yz - wx, t[1],
+    xz - wy, yz + wx, 1 - (xx + yy), t[2]
+  };
+  transformPointsAffine(rows, in, out, n);
+}
+
+#ifdef MATHBATCH_AVX
+// out = a * b, with a given as its sixteen entries and b as its rows. out
+// may be a or b.
+static void multiplyRows(const double* a, const __m256d b[4], double* out) {
+  for (int r = 0; r < 4; ++r) {
+    __m256d row = _mm256_mul_pd(_mm256_broadcast_sd(a + 4 * r), b[0]);
+    row = MATHBATCH_MADD(_mm256_broadcast_sd(a + 4 * r + 1), b[1], row);
+    row = MATHBATCH_MADD(_mm256_broadcast_sd(a + 4 * r + 2), b[2], row);
+    row = MATHBATCH_MADD(_mm256_broadcast_sd(a + 4 * r + 3), b[3], row);
+    _mm256_storeu_pd(out + 4 * r, row);
+  }
+}
+#elif defined(MATHBATCH_SSE2)
+static void multiplyRows(const double* a, const __m128d b[8], double* out) {
+  for (int r = 0; r < 4; ++r) {
+    __m128d left = _mm_setzero_pd(), right = _mm_setzero_pd();
+    for (int j = 0; j < 4; ++j) {
+      const __m128d s = _mm_set1_pd(a[4 * r + j]);
+      left = madd(s, b[2 * j], left);
+      right = madd(s, b[2 * j + 1], right);
+    }
+    _mm_storeu_pd(out + 4 * r, left);
+    _mm_storeu_pd(out + 4 * r + 2, right);
+  }
+}
+#endif
+
+void multiplyMatrices(const Matrix4 a[], const Matrix4 b[], Matrix4 out[], int n) {
+  int i = 0;
+#if defined(MATHBATCH_AVX)
+  for (; i < n; ++i) {
+    const double* bd = &b[i][0];
+    const __m256d rows[4] = {_mm256_loadu_pd(bd), _mm256_loadu_pd(bd + 4), _mm256_loadu_pd(bd + 8), _mm256_loadu_pd(bd + 12)};
+    multiplyRows(&a[i][0], rows, &out[i][0]);
+  }
+#elif defined(MATHBATCH_SSE2)
+  for (; i < n; ++i) {
+    const double* bd = &b[i][0];
+    __m128d rows[8];
+    for (int k = 0; k < 8; ++k)
+      rows[k] = _mm_loadu_pd(bd + 2 * k);
+    multiplyRows(&a[i][0], rows, &out[i][0]);
+  }
+#endif
+  for (; i < n; ++i)
+    out[i] = a[i] * b[i];
+}
+
+void multiplyMatrices(const Matrix4& a, const Matrix4 b[], Matrix4 out[], int n) {
+  int i = 0;
+#if defined(MATHBATCH_AVX)
+  for (; i < n; ++i) {
+    const double* bd = &b[i][0];
+    const __m256d rows[4] = {_mm256_loadu_pd(bd), _mm256_loadu_pd(bd + 4), _mm256_loadu_pd(bd + 8), _mm256_loadu_pd(bd + 12)};
+    multiplyRows(&a[0], rows, &out[i][0]);
+  }
+#elif defined(MATHBATCH_SSE2)
+  for (; i < n; ++i) {
+    const double* bd = &b[i][0];
+    __m128d rows[8];
+    for (int k = 0; k < 8; ++k)
+      rows[k] = _mm_loadu_pd(bd + 2 * k);
+    multiplyRows(&a[0], rows, &out[i][0]);
+  }
+#endif
+  for (; i < n; ++i)
+    out[i] = a * b[i];
+}
+
+void multiplyQuats(const Quat a[], const Quat b[], Quat out[], int n) {
+  int i = 0;
+#if defined(MATHBATCH_AVX)
+  // with a = (w, x, y, z) and b = (bw, bx, by, bz), a * b is
+  //   w * ( bw,  bx,  by,  bz) + x * (-bx,  bw, -bz,  by)
+  // + y * (-by,  bz,  bw, -bx) + z * (-bz, -by,  bx,  bw)
+  const __m256d sx = _mm256_setr_pd(-1, 1, -1, 1);
+  const __m256d sy = _mm256_setr_pd(-1, 1, 1, -1);
+  const __m256d sz = _mm256_setr_pd(-1, -1, 1, 1);
+  for (; i < n; ++i) {
+    const double* ad = reinterpret_cast<const double*>(&a[i]);
+    const __m256d q = _mm256_loadu_pd(reinterpret_cast<const double*>(&b[i]));
+    const __m256d pairs = _mm256_permute_pd(q, 0x5);            // bx bw bz by
+    const __m256d halves = _mm256_permute2f128_pd(q, q, 0x1);   // by bz bw bx
+    const __m256d both = _mm256_permute_pd(halves, 0x5);         // bz by bx bw
+    __m256d r = _mm256_mul_pd(_mm256_broadcast_sd(ad), q);
+    r = MATHBATCH_MADD(_mm256_broadcast_sd(ad + 1), _mm256_mul_pd(pairs, sx), r);
+    r = MATHBATCH_MADD(_mm256_broadcast_sd(ad + 2), _mm256_mul_pd(halves, sy), r);
+    r = MATHBATCH_MADD(_mm256_broadcast_sd(ad + 3), _mm256_mul_pd(both, sz), r);
+    _mm256_storeu_pd(reinterpret_cast<double*>(&out[i]), r);
+  }
+#elif defined(MATHBATCH_SSE2)
+  // the same in halves: (w, x) and (y, z)
+  const __m128d mp = _mm_setr_pd(-1, 1), pm = _mm_setr_pd(1, -1), mm = _mm_set1_pd(-1);
+  for (; i < n; ++i) {
+    const double* ad = reinterpret_cast<const double*>(&a[i]);
+    const double* bd = reinterpret_cast<const double*>(&b[i]);
+    const __m128d lo = _mm_loadu_pd(bd), hi = _mm_loadu_pd(bd + 2);
+    const __m128d loSwap = _mm_shuffle_pd(lo, lo, 1), hiSwap = _mm_shuffle_pd(hi, hi, 1);
+    const __m128d w = _mm_set1_pd(ad[0]), x = _mm_set1_pd(ad[1]), y = _mm_set1_pd(ad[2]), z = _mm_set1_pd(ad[3]);
+    __m128d rlo = _mm_mul_pd(w, lo), rhi = _mm_mul_pd(w, hi);
+    rlo = madd(x, _mm_mul_pd(loSwap, mp), rlo);
+    rlo = madd(y, _mm_mul_pd(hi, mp), rlo);
+    rlo = madd(z, _mm_mul_pd(hiSwap, mm), rlo);
+    rhi = madd(x, _mm_mul_pd(hiSwap, mp), rhi);
+    rhi = madd(y, _mm_mul_pd(lo, pm), rhi);
+    rhi = madd(z, loSwap, rhi);
+    double* dst = reinterpret_cast<double*>(&out[i]);
+    _mm_storeu_pd(dst, rlo);
+    _mm_storeu_pd(dst + 2, rhi);
+  }
+#endif
+  for (; i < n; ++i)
+    out[i] = a[i] * b[i];
+}
+
+// q v q^-1 for any nonzero q = (w, u):
+//   (v (w^2 - u.u) + 2 u (u.v) + 2 w (u x v)) / |q|^2
+static Cvec3 rotateVector(const Quat& q, const Cvec3& v) {
+  const Cvec3 u(q[1], q[2], q[3]);
+  const double uu = dot(u, u), n = q[0] * q[0] + uu;
+  return (v * (q[0] * q[0] - uu) + u * (2 * dot(u, v)) + cross(u, v) * (2 * q[0])) / n;
+}
+
+void rotateVectors(const Quat q[], const Cvec3 in[], Cvec3 out[], int n) {
+  int i = 0;
+#ifdef MATHBATCH_AVX
+  // four rotations at a time, one per lane
+  for (; i + 4 <= n; i += 4) {
+    const Quat* p = q + i;
+    const Cvec3* v = in + i;
+    const __m256d w = _mm256_setr_pd(p[0][0], p[1][0], p[2][0], p[3][0]);
+    const __m256d x = _mm256_setr_pd(p[0][1], p[1][1], p[2][1], p[3][1]);
+    const __m256d y = _mm256_setr_pd(p[0][2], p[1][2], p[2][2], p[3][2]);
+    const __m256d z = _mm256_setr_pd(p[0][3], p[1][3], p[2][3], p[3][3]);
+    const __m256d vx = _mm256_setr_pd(v[0][0], v[1][0], v[2][0], v[3][0]);
+    const __m256d vy = _mm256_setr_pd(v[0][1], v[1][1], v[2][1], v[3][1]);
+    const __m256d vz = _mm256_setr_pd(v[0][2], v[1][2], v[2][2], v[3][2]);
+
+    const __m256d uu = MATHBATCH_MADD(x, x, MATHBATCH_MADD(y, y, _mm256_mul_pd(z, z)));
+    const __m256d ww = _mm256_mul_pd(w, w);
+    const __m256d rn = _mm256_div_pd(_mm256_set1_pd(1), _mm256_add_pd(ww, uu));
+    const __m256d s = _mm256_mul_pd(_mm256_sub_pd(ww, uu), rn);
+    const __m256d two = _mm256_mul_pd(_mm256_set1_pd(2), rn);
+    const __m256d uv = _mm256_mul_pd(MATHBATCH_MADD(x, vx, MATHBATCH_MADD(y, vy, _mm256_mul_pd(z, vz))), two);
+    const __m256d w2 = _mm256_mul_pd(w, two);
+    const __m256d cx = _mm256_sub_pd(_mm256_mul_pd(y, vz), _mm256_mul_pd(z, vy));
+    const __m256d cy = _mm256_sub_pd(_mm256_mul_pd(z, vx), _mm256_mul_pd(x, vz));
+    const __m256d cz = _mm256_sub_pd(_mm256_mul_pd(x, vy), _mm256_mul_pd(y, vx));
+
+    double rx[4], ry[4], rz[4];
+    _mm256_storeu_pd(rx, MATHBATCH_MADD(vx, s, MATHBATCH_MADD(x, uv, _mm256_mul_pd(cx, w2))));
+    _mm256_storeu_pd(ry, MATHBATCH_MADD(vy, s, MATHBATCH_MADD(y, uv, _mm256_mul_pd(cy, w2))));
+    _mm256_storeu_pd(rz, MATHBATCH_MADD(vz, s, MATHBATCH_MADD(z, uv, _mm256_mul_pd(cz, w2))));
+    for (int k = 0; k < 4; ++k)
+      out[i + k] = Cvec3(rx[k], ry[k], rz[k]);
+  }
+#elif defined(MATHBATCH_SSE2)
+  // two rotations at a time, one per lane, transposed in and out by unpacks
+  for (; i + 2 <= n; i += 2) {
+    const double* p = reinterpret_cast<const double*>(q + i);
+    double* v = reinterpret_cast<double*>(out + i);
+    const double* u = reinterpret_cast<const double*>(in + i);
+    const __m128d p0 = _mm_loadu_pd(p), p1 = _mm_loadu_pd(p + 4), p2 = _mm_loadu_pd(p + 2), p3 = _mm_loadu_pd(p + 6);
+    const __m128d w = _mm_unpacklo_pd(p0, p1), x = _mm_unpackhi_pd(p0, p1);
+    const __m128d y = _mm_unpacklo_pd(p2, p3), z = _mm_unpackhi_pd(p2, p3);
+    const __m128d v0 = _mm_loadu_pd(u), v1 = _mm_loadu_pd(u + 3);
+    const __m128d vx = _mm_unpacklo_pd(v0, v1), vy = _mm_unpackhi_pd(v0, v1);
+    const __m128d vz = _mm_loadh_pd(_mm_load_sd(u + 2), u + 5);
+
+    const __m128d uu = madd(x, x, madd(y, y, _mm_mul_pd(z, z)));
+    const __m128d ww = _mm_mul_pd(w, w);
+    const __m128d rn = _mm_div_pd(_mm_set1_pd(1), _mm_add_pd(ww, uu));
+    const __m128d s = _mm_mul_pd(_mm_sub_pd(ww, uu), rn);
+    const __m128d two = _mm_mul_pd(_mm_set1_pd(2), rn);
+    const __m128d uv = _mm_mul_pd(madd(x, vx, madd(y, vy, _mm_mul_pd(z, vz))), two);
+    const __m128d w2 = _mm_mul_pd(w, two);
+    const __m128d cx = _mm_sub_pd(_mm_mul_pd(y, vz), _mm_mul_pd(z, vy));
+    const __m128d cy = _mm_sub_pd(_mm_mul_pd(z, vx), _mm_mul_pd(x, vz));
+    const __m128d cz = _mm_sub_pd(_mm_mul_pd(x, vy), _mm_mul_pd(y, vx));
+
+    const __m128d rx = madd(vx, s, madd(x, uv, _mm_mul_pd(cx, w2)));
+    const __m128d ry = madd(vy, s, madd(y, uv, _mm_mul_pd(cy, w2)));
+    const __m128d rz = madd(vz, s, madd(z, uv, _mm_mul_pd(cz, w2)));
+    _mm_storeu_pd(v, _mm_unpacklo_pd(rx, ry));
+    _mm_store_sd(v + 2, rz);
+    _mm_storeu_pd(v + 3, _mm_unpackhi_pd(rx, ry));
+    _mm_storeh_pd(v + 5, rz);
+  }
+#endif
+  for (; i < n; ++i)
+    out[i] = rotateVector(q[i], in[i]);
+}
+
+void quatsToMatrices(const Quat q[], Matrix4 out[], int n) {
+  int i = 0;
+#ifdef MATHBATCH_AVX
+  // four conversions at a time, one per lane, then scattered to the
+  // matrices; quaternions too short to convert take quatToMatrix's zero
+  for (; i + 4 <= n; i += 4) {
+    const Quat* p = q + i;
+    const __m256d w = _mm256_setr_pd(p[0][0], p[1][0], p[2][0], p[3][0]);
+    const __m256d x = _mm256_setr_pd(p[0][1], p[1][1], p[2][1], p[3][1]);
+    const __m256d y = _mm256_setr_pd(p[0][2], p[1][2], p[2][2], p[3][2]);
+    const __m256d z = _mm256_setr_pd(p[0][3], p[1][3], p[2][3], p[3][3]);
+    const __m256d norm = MATHBATCH_MADD(w, w, MATHBATCH_MADD(x, x, MATHBATCH_MADD(y, y, _mm256_mul_pd(z, z))));
+    const __m256d s = _mm256_div_pd(_mm256_set1_pd(2), norm);
+    const __m256d one = _mm256_set1_pd(1);
+    const __m256d xs = _mm256_mul_pd(x, s), ys = _mm256_mul_pd(y, s), zs = _mm256_mul_pd(z, s);
+    const __m256d xx = _mm256_mul_pd(x, xs), yy = _mm256_mul_pd(y, ys), zz = _mm256_mul_pd(z, zs);
+    const __m256d xy = _mm256_mul_pd(x, ys), xz = _mm256_mul_pd(x, zs), yz = _mm256_mul_pd(y, zs);
+    const __m256d wx = _mm256_mul_pd(w, xs), wy = _mm256_mul_pd(w, ys), wz = _mm256_mul_pd(w, zs);
+
+    double e[9][4];
+    _mm256_storeu_pd(e[0], _mm256_sub_pd(one, _mm256_add_pd(yy, zz)));
+    _mm256_storeu_pd(e[1], _mm256_sub_pd(xy, wz));
+    _mm256_storeu_pd(e[2], _mm256_add_pd(xz, wy));
+    _mm256_storeu_pd(e[3], _mm256_add_pd(xy, wz));
+    _mm256_storeu_pd(e[4], _mm256_sub_pd(one, _mm256_add_pd(xx, zz)));
+    _mm256_storeu_pd(e[5], _mm256_sub_pd(yz, wx));
+    _mm256_storeu_pd(e[6], _mm256_sub_pd(xz, wy));
+    _mm256_storeu_pd(e[7], _mm256_add_pd(yz, wx));
+    _mm256_storeu_pd(e[8], _mm256_sub_pd(one, _mm256_add_pd(xx, yy)));
+    double norms[4];
+    _mm256_storeu_pd(norms, norm);
+
+    for (int k = 0; k < 4; ++k) {
+      Matrix4& m = out[i + k];
+      if (norms[k] < CS175_EPS2) {
+        m = Matrix4(0);
+        continue;
+      }
+      for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c)
+          m(r, c) = e[3 * r + c][k];
+        m(r, 3) = 0;
+        m(3, r) = 0;
+      }
+      m(3, 3) = 1;
+    }
+  }
+#elif defined(MATHBATCH_SSE2)
+  // two conversions at a time, one per lane, each matrix written a half
+  // row at a time; a pair with a quaternion too short to convert goes to
+  // quatToMatrix for its zero
+  const __m128d zero = _mm_setzero_pd(), one = _mm_set1_pd(1);
+  const __m128d rowEnd = _mm_setr_pd(0, 1);
+  for (; i + 2 <= n; i += 2) {
+    const double* p = reinterpret_cast<const double*>(q + i);
+    const __m128d p0 = _mm_loadu_pd(p), p1 = _mm_loadu_pd(p + 4), p2 = _mm_loadu_pd(p + 2), p3 = _mm_loadu_pd(p + 6);
+    const __m128d w = _mm_unpacklo_pd(p0, p1), x = _mm_unpackhi_pd(p0, p1);
+    const __m128d y = _mm_unpacklo_pd(p2, p3), z = _mm_unpackhi_pd(p2, p3);
+    const __m128d norm = madd(w, w, madd(x, x, madd(y, y, _mm_mul_pd(z, z))));
+    if (_mm_movemask_pd(_mm_cmplt_pd(norm, _mm_set1_pd(CS175_EPS2)))) {
+      out[i] = quatToMatrix(q[i]);
+      out[i + 1] = quatToMatrix(q[i + 1]);
+      continue;
+    }
+    const __m128d s = _mm_div_pd(_mm_set1_pd(2), norm);
+    const __m128d xs = _mm_mul_pd(x, s), ys = _mm_mul_pd(y, s), zs = _mm_mul_pd(z, s);
+    const __m128d xx = _mm_mul_pd(x, xs), yy = _mm_mul_pd(y, ys), zz = _mm_mul_pd(z, zs);
+    const __m128d xy = _mm_mul_pd(x, ys), xz = _mm_mul_pd(x, zs), yz = _mm_mul_pd(y, zs);
+    const __m128d wx = _mm_mul_pd(w, xs), wy = _mm_mul_pd(w, ys), wz = _mm_mul_pd(w, zs);
+
+    // the entries of row r, columns 0 and 1, then column 2 with a zero
+    const __m128d e[3][3] = {
+      {_mm_sub_pd(one, _mm_add_pd(yy, zz)), _mm_sub_pd(xy, wz), _mm_add_pd(xz, wy)},
+      {_mm_add_pd(xy, wz), _mm_sub_pd(one, _mm_add_pd(xx, zz)), _mm_sub_pd(yz, wx)},
+      {_mm_sub_pd(xz, wy), _mm_add_pd(yz, wx), _mm_sub_pd(one, _mm_add_pd(xx, yy))}
+    };
+    double* m0 = &out[i][0];
+    double* m1 = &out[i + 1][0];
+    for (int r = 0; r < 3; ++r) {
+      _mm_storeu_pd(m0 + 4 * r, _mm_unpacklo_pd(e[r][0], e[r][1]));
+      _mm_storeu_pd(m0 + 4 * r + 2, _mm_unpacklo_pd(e[r][2], zero));
+      _mm_storeu_pd(m1 + 4 * r, _mm_unpackhi_pd(e[r][0], e[r][1]));
+      _mm_storeu_pd(m1 + 4 * r + 2, _mm_unpackhi_pd(e[r][2], zero));
+    }
+    _mm_storeu_pd(m0 + 12, zero);
+    _mm_storeu_pd(m0 + 14, rowEnd);
+    _mm_storeu_pd(m1 + 12, zero);
+    _mm_storeu_pd(m1 + 14, rowEnd);
+  }
+#endif
+  for (; i < n; ++i)
+    out[i] = quatToMatrix(q[i]);
+}
@@ -0,0 +1,44 @@
+#ifndef MATHBATCH_H
+#define MATHBATCH_H
+
+#include "cvec.h"
+#include "quat.h"
+#include "matrix4.h"
+#include "rigtform.h"
+
+//--------------------------------------------------------------------------------
+// Array versions of the math operators, for when many objects go through
+// the same operation. Each computes what the per object operator does, with
+// an AVX path (using FMA when available), an SSE2 path and a scalar
+// fallback chosen at compile time. rotateVectors and quatsToMatrices work
+// on four elements at a time in AVX builds and two in SSE2 builds.
+//
+// Outputs may be the inputs themselves, element for element, but must not
+// overlap them otherwise.
+//--------------------------------------------------------------------------------
+
+// out[i] = m * in[i]
+void transformVectors(const Matrix4& m, const Cvec4 in[], Cvec4 out[], int n);
+
+// out[i] = Cvec3(m * Cvec4(in[i], 1)), the points moved by an affine matrix
+void transformPoints(const Matrix4& m, const Cvec3 in[], Cvec3 out[], int n);
+
+// out[i] = Cvec3(tform * Cvec4(in[i], 1))
+void transformPoints(const RigTForm& tform, const Cvec3 in[], Cvec3 out[], int n);
+
+// out[i] = a[i] * b[i]
+void multiplyMatrices(const Matrix4 a[], const Matrix4 b[], Matrix4 out[], int n);
+
+// out[i] = a * b[i]
+void multiplyMatrices(const Matrix4& a, const Matrix4 b[], Matrix4 out[], int n);
+
+// out[i] = a[i] * b[i]
+void multiplyQuats(const Quat a[], const Quat b[], Quat out[], int n);
+
+// out[i] = Cvec3(q[i] * Cvec4(in[i], 0)), in[i] rotated by q[i]
+void rotateVectors(const Quat q[], const Cvec3 in[], Cvec3 out[], int n);
+
+// out[i] = quatToMatrix(q[i])
+void quatsToMatrices(const Quat q[], Matrix4 out[], int n);
+
+#endif
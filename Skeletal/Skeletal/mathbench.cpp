@@ -0,0 +1,468 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "mathbench.h"
+#include "mathbatch.h"
+#include "fusedmath.h"
+#include "gpumatrix.h"
+#include "rigtform.h"
+
+using namespace std;
+
+namespace {
+
+// Objects per call; the inputs of all operations stay in the L2 cache
+const int BENCH_COUNT = 256;
+
+// Each measurement is the best of this many trials of about 10 ms
+const int BENCH_TRIALS = 5;
+const double BENCH_TRIAL_NS = 1e7;
+
+struct BenchResult {
+  string group;
+  string name;
+  string baseline;  // the operation this one replaces, empty if none
+  double nsPerOp;
+};
+
+// Inputs built the same way on every run
+struct BenchInputs {
+  vector<Matrix4> rigid;  // rotations and translations
+  vector<Quat> quats;     // of norm 1 to 2, as products drift to
+  vector<UnitQuat> units;
+  vector<RigTForm> tforms;
+  vector<Cvec3> points;
+  vector<Cvec4> vectors;
+
+  BenchInputs() {
+    for (int i = 0; i < BENCH_COUNT; ++i) {
+      const Quat q = Quat::makeXRotation(7.0 * i) * Quat::makeYRotation(13.0 * i) * Quat::makeZRotation(3.0 * i);
+      const Cvec3 t(0.01 * i, 1 - 0.02 * i, 0.5);
+      tforms.push_back(RigTForm(t, q));
+      rigid.push_back(rigTFormToMatrix(tforms.back()));
+      quats.push_back(q * (1 + (i % 8) / 8.0));
+      units.push_back(UnitQuat::assumeUnit(q));
+      points.push_back(Cvec3(i % 5 - 2.0, i % 7 - 3.0, i % 3 - 1.0));
+      vectors.push_back(Cvec4(points.back(), i % 2));
+    }
+  }
+};
+
+// The operations as they were before the fast paths, kept as the baselines
+// they are measured against
+
+// Matrix4 * Matrix4 accumulating into a zeroed result
+Matrix4 multiplyIntoZero(const Matrix4& a, const Matrix4& b) {
+  Matrix4 r(0);
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      for (int k = 0; k < 4; ++k)
+        r(i, k) += a(i, j) * b(j, k);
+    }
+  }
+  return r;
+}
+
+// Matrix4::writeToColumnMajorMatrix through a transposed copy
+void writeTransposedCopy(const Matrix4& a, float m[]) {
+  const Matrix4 t = transpose(a);
+  for (int i = 0; i < 16; ++i)
+    m[i] = float(t[i]);
+}
+
+// Quat * Cvec4 as the product q (0, v) q^-1
+Cvec4 rotateByProduct(const Quat& q, const Cvec4& a) {
+  const Quat r = q * (Quat(0, a[0], a[1], a[2]) * inv(q));
+  return Cvec4(r[1], r[2], r[3], a[3]);
+}
+
+// Read after every trial, so no result can be optimized away
+volatile double g_benchSink;
+
+// Best ns per operation of f, which does opsPerCall operations a call
+template <class F>
+double timeOps(F f, int opsPerCall) {
+  typedef chrono::steady_clock Clock;
+  long long calls = 1;
+  double elapsed = 0;
+  for (;;) {
+    const Clock::time_point start = Clock::now();
+    for (long long c = 0; c < calls; ++c)
+      f();
+    elapsed = chrono::duration<double, nano>(Clock::now() - start).count();
+    if (elapsed > BENCH_TRIAL_NS / 8)
+      break;
+    calls *= 2;
+  }
+  calls = max(1LL, (long long) (calls * BENCH_TRIAL_NS / elapsed));
+
+  double best = 0;
+  for (int trial = 0; trial < BENCH_TRIALS; ++trial) {
+    const Clock::time_point start = Clock::now();
+    for (long long c = 0; c < calls; ++c)
+      f();
+    const double ns = chrono::duration<double, nano>(Clock::now() - start).count() / (double(calls) * opsPerCall);
+    best = trial == 0 ? ns : min(best, ns);
+  }
+  return best;
+}
+
+class MathBench {
+  vector<BenchResult> results_;
+  string group_;
+
+public:
+  void setGroup(const char* group) {
+    group_ = group;
+  }
+
+  template <class F>
+  void add(const char* name, const char* baseline, F f, int opsPerCall = BENCH_COUNT) {
+    BenchResult r = {group_, name, baseline, timeOps(f, opsPerCall)};
+    results_.push_back(r);
+  }
+
+  // ns per op of the baseline of r, or 0 when it has none
+  double getBaselineNs(const BenchResult& r) const {
+    for (size_t i = 0; i < results_.size(); ++i) {
+      if (!r.baseline.empty() && results_[i].group == r.group && results_[i].name == r.baseline)
+        return results_[i].nsPerOp;
+    }
+    return 0;
+  }
+
+  void print() const {
+    for (size_t i = 0; i < results_.size(); ++i) {
+      const BenchResult& r = results_[i];
+      cout << left << setw(10) << r.group << setw(36) << r.name << right << fixed << setprecision(2)
+           << setw(9) << r.nsPerOp << " ns/op " << setw(9) << 1e3 / r.nsPerOp << " Mops/s";
+      const double baseline = getBaselineNs(r);
+      if (baseline > 0)
+        cout << "  " << baseline / r.nsPerOp << "x " << r.baseline;
+      cout << endl;
+    }
+    cout.unsetf(ios::floatfield);
+  }
+
+  void writeJson(const char* filename) const {
+    ofstream out(filename);
+    if (!out)
+      throw runtime_error(string("Cannot write ") + filename);
+    out << "{\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results_.size(); ++i) {
+      const BenchResult& r = results_[i];
+      out << (i ? ",\n" : "\n") << "    {\"group\": \"" << r.group << "\", \"name\": \"" << r.name
+          << "\", \"ns_per_op\": " << r.nsPerOp << ", \"ops_per_s\": " << 1e9 / r.nsPerOp;
+      const double baseline = getBaselineNs(r);
+      if (baseline > 0)
+        out << ", \"baseline\": \"" << r.baseline << "\", \"speedup\": " << baseline / r.nsPerOp;
+      out << "}";
+    }
+    out << "\n  ]\n}\n";
+    if (!out)
+      throw runtime_error(string("Cannot write ") + filename);
+  }
+};
+
+} // namespace
+
+void benchMath(const char* jsonFile) {
+  const int n = BENCH_COUNT, last = BENCH_COUNT - 1;
+  const BenchInputs in;
+  vector<Matrix4> outM(n);
+  vector<Quat> outQ(n);
+  vector<UnitQuat> outU(n);
+  vector<RigTForm> outT(n);
+  vector<Cvec3> out3(n);
+  vector<Cvec4> out4(n);
+  vector<GpuMatrix4> outG(n);
+  vector<float> outF(16 * n);
+  vector<double> outD(n);
+  const vector<GpuMatrix4> gpu(in.rigid.begin(), in.rigid.end());
+
+  MathBench bench;
+  bench.setGroup("Cvec");
+  bench.add("dot", "", [&] {
+    for (int i = 0; i < n; ++i)
+      outD[i] = dot(in.points[i], in.points[last - i]);
+    g_benchSink = outD[0];
+  });
+  bench.add("cross", "", [&] {
+    for (int i = 0; i < n; ++i)
+      out3[i] = cross(in.points[i], in.points[last - i]);
+    g_benchSink = out3[0][0];
+  });
+  bench.add("normalize", "", [&] {
+    for (int i = 0; i < n; ++i)
+      out4[i] = normalize(in.vectors[i] + Cvec4(1));
+    g_benchSink = out4[0][0];
+  });
+
+  bench.setGroup("Matrix4");
+  bench.add("multiply into zero", "", [&] {
+    for (int i = 0; i < n; ++i)
+      outM[i] = multiplyIntoZero(in.rigid[i], in.rigid[last - i]);
+    g_benchSink = outM[0][0];
+  });
+  bench.add("multiply", "multiply into zero", [&] {
+    for (int i = 0; i < n; ++i)
+      outM[i] = in.rigid[i] * in.rigid[last - i];
+    g_benchSink = outM[0][0];
+  });
+  bench.add("multiplyAffineInto", "multiply into zero", [&] {
+    for (int i = 0; i < n; ++i)
+      multiplyAffineInto(in.rigid[i], in.rigid[last - i], outM[i]);
+    g_benchSink = outM[0][0];
+  });
+  vector<Matrix4> reversed(in.rigid.rbegin(), in.rigid.rend());
+  bench.add("multiplyMatrices", "multiply into zero", [&] {
+    multiplyMatrices(&in.rigid[0], &reversed[0], &outM[0], n);
+    g_benchSink = outM[0][0];
+  });
+  bench.add("inv", "", [&] {
+    for (int i = 0; i < n; ++i)
+      outM[i] = inv(in.rigid[i]);
+    g_benchSink = outM[0][0];
+  });
+  bench.add("normalMatrix", "", [&] {
+    for (int i = 0; i < n; ++i)
+      outM[i] = normalMatrix(in.rigid[i]);
+    g_benchSink = outM[0][0];
+  });
+  bench.add("transpose", "", [&] {
+    for (int i = 0; i < n; ++i)
+      outM[i] = transpose(in.rigid[i]);
+    g_benchSink = outM[0][0];
+  });
+  bench.add("write transposed copy", "", [&] {
+    for (int i = 0; i < n; ++i)
+      writeTransposedCopy(in.rigid[i], &outF[16 * i]);
+    g_benchSink = outF[0];
+  });
+  bench.add("writeToColumnMajorMatrix", "write transposed copy", [&] {
+    for (int i = 0; i < n; ++i)
+      in.rigid[i].writeToColumnMajorMatrix(&outF[16 * i]);
+    g_benchSink = outF[0];
+  });
+  bench.add("GpuMatrix4 writeTo", "write transposed copy", [&] {
+    for (int i = 0; i < n; ++i)
+      gpu[i].writeTo(&outF[16 * i]);
+    g_benchSink = outF[0];
+  });
+  bench.add("multiply and write", "", [&] {
+    for (int i = 0; i < n; ++i)
+      (in.rigid[i] * in.rigid[last - i]).writeToColumnMajorMatrix(&outF[16 * i]);
+    g_benchSink = outF[0];
+  });
+  bench.add("writeAffineProductColumnMajor", "multiply and write", [&] {
+    for (int i = 0; i < n; ++i)
+      writeAffineProductColumnMajor(in.rigid[i], in.rigid[last - i], &outF[16 * i]);
+    g_benchSink = outF[0];
+  });
+  bench.add("GpuMatrix4 of product", "multiply and write", [&] {
+    for (int i = 0; i < n; ++i)
+      outG[i] = GpuMatrix4(in.rigid[i], in.rigid[last - i]);
+    g_benchSink = outG[0](0, 0);
+  });
+  bench.add("transform point", "", [&] {
+    for (int i = 0; i < n; ++i)
+      out3[i] = Cvec3(in.rigid[0] * Cvec4(in.points[i], 1));
+    g_benchSink = out3[0][0];
+  });
+  bench.add("transformPoints", "transform point", [&] {
+    transformPoints(in.rigid[0], &in.points[0], &out3[0], n);
+    g_benchSink = out3[0][0];
+  });
+  bench.add("transform vector", "", [&] {
+    for (int i = 0; i < n; ++i)
+      out4[i] = in.rigid[0] * in.vectors[i];
+    g_benchSink = out4[0][0];
+  });
+  bench.add("transformVectors", "transform vector", [&] {
+    transformVectors(in.rigid[0], &in.vectors[0], &out4[0], n);
+    g_benchSink = out4[0][0];
+  });
+
+  bench.setGroup("Quat");
+  bench.add("multiply", "", [&] {
+    for (int i = 0; i < n; ++i)
+      outQ[i] = in.quats[i] * in.quats[last - i];
+    g_benchSink = outQ[0][0];
+  });
+  bench.add("UnitQuat multiply", "multiply", [&] {
+    for (int i = 0; i < n; ++i)
+      outU[i] = in.units[i] * in.units[last - i];
+    g_benchSink = outU[0][0];
+  });
+  vector<Quat> reversedQ(in.quats.rbegin(), in.quats.rend());
+  bench.add("multiplyQuats", "multiply", [&] {
+    multiplyQuats(&in.quats[0], &reversedQ[0], &outQ[0], n);
+    g_benchSink = outQ[0][0];
+  });
+  bench.add("quatToMatrix", "", [&] {
+    for (int i = 0; i < n; ++i)
+      outM[i] = quatToMatrix(in.quats[i]);
+    g_benchSink = outM[0][0];
+  });
+  bench.add("quatToMatrix UnitQuat", "quatToMatrix", [&] {
+    for (int i = 0; i < n; ++i)
+      outM[i] = quatToMatrix(in.units[i]);
+    g_benchSink = outM[0][0];
+  });
+  bench.add("quatsToMatrices", "quatToMatrix", [&] {
+    quatsToMatrices(&in.quats[0], &outM[0], n);
+    g_benchSink = outM[0][0];
+  });
+  bench.add("slerp", "", [&] {
+    for (int i = 0; i < n; ++i)
+      outQ[i] = slerp(in.units[i], in.units[last - i], 0.25);
+    g_benchSink = outQ[0][0];
+  });
+  bench.add("rotate q v q^-1", "", [&] {
+    for (int i = 0; i < n; ++i)
+      out3[i] = Cvec3(rotateByProduct(in.quats[i], Cvec4(in.points[i], 0)));
+    g_benchSink = out3[0][0];
+  });
+  bench.add("rotate by matrix", "rotate q v q^-1", [&] {
+    for (int i = 0; i < n; ++i)
+      out3[i] = Cvec3(quatToMatrix(in.quats[i]) * Cvec4(in.points[i], 0));
+    g_benchSink = out3[0][0];
+  });
+  bench.add("rotate", "rotate q v q^-1", [&] {
+    for (int i = 0; i < n; ++i)
+      out3[i] = Cvec3(in.quats[i] * Cvec4(in.points[i], 0));
+    g_benchSink = out3[0][0];
+  });
+  bench.add("UnitQuat rotate", "rotate q v q^-1", [&] {
+    for (int i = 0; i < n; ++i)
+      out3[i] = Cvec3(in.units[i] * Cvec4(in.points[i], 0));
+    g_benchSink = out3[0][0];
+  });
+  bench.add("rotateVectors", "rotate q v q^-1", [&] {
+    rotateVectors(&in.quats[0], &in.points[0], &out3[0], n);
+    g_benchSink = out3[0][0];
+  });
+
+  bench.setGroup("RigTForm");
+  bench.add("compose", "", [&] {
+    for (int i = 0; i < n; ++i)
+      outT[i] = in.tforms[i] * in.tforms[last - i];
+    g_benchSink = outT[0].getTranslation()[0];
+  });
+  bench.add("inv", "", [&] {
+    for (int i = 0; i < n; ++i)
+      outT[i] = inv(in.tforms[i]);
+    g_benchSink = outT[0].getTranslation()[0];
+  });
+  bench.add("rigTFormToMatrix", "", [&] {
+    for (int i = 0; i < n; ++i)
+      outM[i] = rigTFormToMatrix(in.tforms[i]);
+    g_benchSink = outM[0][0];
+  });
+  bench.add("parent * rigTFormToMatrix", "", [&] {
+    for (int i = 0; i < n; ++i)
+      outM[i] = in.rigid[last - i] * rigTFormToMatrix(in.tforms[i]);
+    g_benchSink = outM[0][0];
+  });
+  bench.add("composeRigidInto", "parent * rigTFormToMatrix", [&] {
+    for (int i = 0; i < n; ++i)
+      composeRigidInto(in.rigid[last - i], in.tforms[i], outM[i]);
+    g_benchSink = outM[0][0];
+  });
+  bench.add("transform point", "", [&] {
+    for (int i = 0; i < n; ++i)
+      out3[i] = Cvec3(in.tforms[0] * Cvec4(in.points[i], 1));
+    g_benchSink = out3[0][0];
+  });
+  bench.add("transformPoints", "transform point", [&] {
+    transformPoints(in.tforms[0], &in.points[0], &out3[0], n);
+    g_benchSink = out3[0][0];
+  });
+
+  bench.print();
+  if (jsonFile != NULL) {
+    bench.writeJson(jsonFile);
+    cout << "Wrote " << jsonFile << endl;
+  }
+}
+
+void benchFused() {
+  const int n = 64, reps = 200000;
+  vector<RigTForm> locals(n);
+  vector<Matrix4> offsets(n), models(n);
+  for (int b = 0; b < n; ++b) {
+    locals[b] = RigTForm(Cvec3(0.1 * b, 1, 0), Quat::makeZRotation(3 * b) * Quat::makeXRotation(b));
+    offsets[b] = Matrix4::makeTranslation(Cvec3(0, -b, 0.5));
+  }
+  const Matrix4 invEyeRbt = inv(rigTFormToMatrix(RigTForm(Cvec3(0, 0.25, 4), Quat::makeYRotation(30))));
+  vector<float> uploads[2];
+  for (int variant = 0; variant < 2; ++variant)
+    uploads[variant].resize(16 * n);
+
+  double nanoseconds[2];
+  for (int variant = 0; variant < 2; ++variant) {
+    float* out = &uploads[variant][0];
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+      locals[r % n].setRotation(Quat::makeXRotation(r % 90));
+      if (variant == 0) {
+        Matrix4 model;
+        for (int b = 0; b < n; ++b) {
+          model = model * rigTFormToMatrix(locals[b]);
+          (invEyeRbt * (model * offsets[b])).writeToColumnMajorMatrix(out + 16 * b);
+        }
+      }
+      else {
+        Matrix4 bone;
+        for (int b = 0; b < n; ++b) {
+          composeRigidInto(b ? models[b - 1] : Matrix4(), locals[b], models[b]);
+          multiplyAffineInto(models[b], offsets[b], bone);
+          writeAffineProductColumnMajor(invEyeRbt, bone, out + 16 * b);
+        }
+      }
+    }
+    nanoseconds[variant] = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / (double(reps) * n);
+  }
+
+  for (int i = 0; i < 16 * n; ++i) {
+    if (abs(uploads[0][i] - uploads[1][i]) > 1e-4f * (1 + abs(uploads[0][i])))
+      throw runtime_error("Fused and operator evaluations differ");
+  }
+  cout << "Pose and upload per bone: " << nanoseconds[0] << " ns with operators, "
+       << nanoseconds[1] << " ns fused" << endl;
+
+  // blending translations toward a target pose, as blendPoses does, each
+  // blend starting from the last
+  vector<Cvec3> to(n), blends[2];
+  for (int b = 0; b < n; ++b)
+    to[b] = Cvec3(0.1 * b, 1, 0.1 * (n - b));
+  for (int variant = 0; variant < 2; ++variant) {
+    blends[variant].assign(n, Cvec3(0, 1, 0));
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+      const double w = (r % 100) / 1000.0;
+      for (int b = 0; b < n; ++b) {
+        if (variant == 0)
+          blends[0][b] = blends[0][b] * (1 - w) + to[b] * w;
+        else {
+          for (int i = 0; i < 3; ++i)
+            blends[1][b][i] = blends[1][b][i] * (1 - w) + to[b][i] * w;
+        }
+      }
+    }
+    nanoseconds[variant] = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / (double(reps) * n);
+  }
+  for (int b = 0; b < n; ++b) {
+    if (norm2(blends[0][b] - blends[1][b]) > 1e-6 * (1 + norm2(blends[0][b])))
+      throw runtime_error("Component and operator blends differ");
+  }
+  cout << "Translation blend per bone: " << nanoseconds[0] << " ns with operators, "
+       << nanoseconds[1] << " ns a component at a time" << endl;
+}
@@ -0,0 +1,26 @@
+#ifndef MATHBENCH_H
+#define MATHBENCH_H
+
+//--------------------------------------------------------------------------------
+// Micro-benchmarks for cvec.h, quat.h, matrix4.h and rigtform.h. Every fast
+// path added over those headers (the mathbatch.h kernels, the fusedmath.h
+// operations, UnitQuat and GpuMatrix4) is timed next to the operation it
+// replaces, and reported as a speedup over it. The pre-series forms of the
+// rewritten operators are kept as those baselines. Nothing here uses GL, so
+// the suite runs anywhere the math compiles: the math_bench target of
+// CMakeLists.txt runs it without the app.
+//--------------------------------------------------------------------------------
+
+// Prints ns/op and ops/s of every operation. Unless jsonFile is NULL, also
+// writes them there as JSON, for tracking across builds. Throws
+// runtime_error when the file cannot be written.
+void benchMath(const char* jsonFile);
+
+// Times a bone chain posed and uploaded the way drawSurface does it, once
+// with the Matrix4 operators and once with the fused operations, each
+// writing column-major floats for glUniformMatrix4fv, and a translation
+// blend with the Cvec operators against one a component at a time. Throws
+// runtime_error if the two ways disagree.
+void benchFused();
+
+#endif
@@ -0,0 +1,23 @@
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+#include "mathbench.h"
+
+using namespace std;
+
+// The math benchmarks on their own, without the app's window or GL:
+// math_bench [<file>] runs the micro-benchmarks, writing the results to the
+// file as JSON if given, as -bench-math does, then the fused pose and
+// upload of -bench-fused
+int main(int argc, char* argv[]) {
+  try {
+    benchMath(argc > 1 ? argv[1] : NULL);
+    benchFused();
+    return 0;
+  }
+  catch (const runtime_error& e) {
+    cout << "Exception caught: " << e.what() << endl;
+    return -1;
+  }
+}
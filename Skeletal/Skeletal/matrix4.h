@@ -5,6 +5,7 @@
 #include <cmath>
 
 #include "cvec.h"
+#include "constmath.h"
 
 // Forward declaration of Matrix4 and transpose since those are used below
 class Matrix4;
@@ -12,41 +13,53 @@ Matrix4 transpose(const Matrix4& m);
 
 // A 4x4 Matrix.
 // To get the element at ith row and jth column, use a(i,j)
+// Construction, element access, products and the make* functions without
+// a projection are constexpr, except the rotations by an angle, which take
+// std::sin and std::cos; makeConst*Rotation are their constexpr forms.
 class Matrix4 {
   double d_[16]; // layout is row-major
 
+  // entry (i, k) of *this * m
+  constexpr double rowTimesColumn(const int i, const Matrix4& m, const int k) const {
+    return (*this)(i,0) * m(0,k) + (*this)(i,1) * m(1,k) + (*this)(i,2) * m(2,k) + (*this)(i,3) * m(3,k);
+  }
+
 public:
-  double &operator () (const int row, const int col) {
+  constexpr double &operator () (const int row, const int col) {
     return d_[(row << 2) + col];
   }
 
-  const double &operator () (const int row, const int col) const {
+  constexpr const double &operator () (const int row, const int col) const {
     return d_[(row << 2) + col];
   }
 
-  double& operator [] (const int i) {
+  constexpr double& operator [] (const int i) {
     return d_[i];
   }
 
-  const double& operator [] (const int i) const {
+  constexpr const double& operator [] (const int i) const {
     return d_[i];
   }
 
-  Matrix4() {
-    for (int i = 0; i < 16; ++i) {
-      d_[i] = 0;
-    }
+  constexpr Matrix4() : d_() {
     for (int i = 0; i < 4; ++i) {
       (*this)(i,i) = 1;
     }
   }
 
-  Matrix4(const double a) {
+  constexpr Matrix4(const double a) : d_() {
     for (int i = 0; i < 16; ++i) {
       d_[i] = a;
     }
   }
 
+  // The entries row by row
+  constexpr Matrix4(const double m00, const double m01, const double m02, const double m03,
+                    const double m10, const double m11, const double m12, const double m13,
+                    const double m20, const double m21, const double m22, const double m23,
+                    const double m30, const double m31, const double m32, const double m33)
+    : d_{m00, m01, m02, m03, m10, m11, m12, m13, m20, m21, m22, m23, m30, m31, m32, m33} {}
+
   template <class T>
   Matrix4& readFromColumnMajorMatrix(const T m[]) {
     for (int i = 0; i < 16; ++i) {
@@ -57,69 +70,66 @@ public:
 
   template <class T>
   void writeToColumnMajorMatrix(T m[]) const {
-    Matrix4 t = transpose(*this);
-    for (int i = 0; i < 16; ++i) {
-      m[i] = T(t.d_[i]);
+    for (int i = 0; i < 4; ++i) {
+      for (int j = 0; j < 4; ++j) {
+        m[(j << 2) + i] = T(d_[(i << 2) + j]);
+      }
     }
   }
 
-  Matrix4& operator += (const Matrix4& m) {
+  constexpr Matrix4& operator += (const Matrix4& m) {
     for (int i = 0; i < 16; ++i) {
       d_[i] += m.d_[i];
     }
     return *this;
   }
 
-  Matrix4& operator -= (const Matrix4& m) {
+  constexpr Matrix4& operator -= (const Matrix4& m) {
     for (int i = 0; i < 16; ++i) {
       d_[i] -= m.d_[i];
     }
     return *this;
   }
 
-  Matrix4& operator *= (const double a) {
+  constexpr Matrix4& operator *= (const double a) {
     for (int i = 0; i < 16; ++i) {
       d_[i] *= a;
     }
     return *this;
   }
 
-  Matrix4& operator *= (const Matrix4& a) {
+  constexpr Matrix4& operator *= (const Matrix4& a) {
     return *this = *this * a;
   }
 
-  Matrix4 operator + (const Matrix4& a) const {
+  constexpr Matrix4 operator + (const Matrix4& a) const {
     return Matrix4(*this) += a;
   }
 
-  Matrix4 operator - (const Matrix4& a) const {
+  constexpr Matrix4 operator - (const Matrix4& a) const {
     return Matrix4(*this) -= a;
   }
 
-  Matrix4 operator * (const double a) const {
+  constexpr Matrix4 operator * (const double a) const {
     return Matrix4(*this) *= a;
   }
 
-  Cvec4 operator * (const Cvec4& v) const {
-    Cvec4 r(0);
+  // each entry is written once, so the compiler drops the initialization of
+  // the result
+  constexpr Cvec4 operator * (const Cvec4& v) const {
+    Cvec4 r;
     for (int i = 0; i < 4; ++i) {
-      for (int j = 0; j < 4; ++j) {
-        r[i] += (*this)(i,j) * v(j);
-      }
+      r[i] = (*this)(i,0) * v(0) + (*this)(i,1) * v(1) + (*this)(i,2) * v(2) + (*this)(i,3) * v(3);
     }
     return r;
   }
 
-  Matrix4 operator * (const Matrix4& m) const {
-    Matrix4 r(0);
-    for (int i = 0; i < 4; ++i) {
-      for (int j = 0; j < 4; ++j) {
-        for (int k = 0; k < 4; ++k) {
-          r(i,k) += (*this)(i,j) * m(j,k);
-        }
-      }
-    }
-    return r;
+  // built entry by entry, with no zeroed result to fill in
+  constexpr Matrix4 operator * (const Matrix4& m) const {
+    return Matrix4(rowTimesColumn(0, m, 0), rowTimesColumn(0, m, 1), rowTimesColumn(0, m, 2), rowTimesColumn(0, m, 3),
+                   rowTimesColumn(1, m, 0), rowTimesColumn(1, m, 1), rowTimesColumn(1, m, 2), rowTimesColumn(1, m, 3),
+                   rowTimesColumn(2, m, 0), rowTimesColumn(2, m, 1), rowTimesColumn(2, m, 2), rowTimesColumn(2, m, 3),
+                   rowTimesColumn(3, m, 0), rowTimesColumn(3, m, 1), rowTimesColumn(3, m, 2), rowTimesColumn(3, m, 3));
   }
 
 
@@ -135,7 +145,21 @@ public:
     return makeZRotation(std::cos(ang * CS175_PI/180), std::sin(ang * CS175_PI/180));
   }
 
-  static Matrix4 makeXRotation(const double c, const double s) {
+  // The same for angles known at compile time. The series of constmath.h
+  // cost more than std::sin and std::cos when they run.
+  constexpr static Matrix4 makeConstXRotation(const double ang) {
+    return makeXRotation(cosDegrees(ang), sinDegrees(ang));
+  }
+
+  constexpr static Matrix4 makeConstYRotation(const double ang) {
+    return makeYRotation(cosDegrees(ang), sinDegrees(ang));
+  }
+
+  constexpr static Matrix4 makeConstZRotation(const double ang) {
+    return makeZRotation(cosDegrees(ang), sinDegrees(ang));
+  }
+
+  constexpr static Matrix4 makeXRotation(const double c, const double s) {
     Matrix4 r;
     r(1,1) = r(2,2) = c;
     r(1,2) = -s;
@@ -143,7 +167,7 @@ public:
     return r;
   }
 
-  static Matrix4 makeYRotation(const double c, const double s) {
+  constexpr static Matrix4 makeYRotation(const double c, const double s) {
     Matrix4 r;
     r(0,0) = r(2,2) = c;
     r(0,2) = s;
@@ -151,7 +175,7 @@ public:
     return r;
   }
 
-  static Matrix4 makeZRotation(const double c, const double s) {
+  constexpr static Matrix4 makeZRotation(const double c, const double s) {
     Matrix4 r;
     r(0,0) = r(1,1) = c;
     r(0,1) = -s;
@@ -159,7 +183,7 @@ public:
     return r;
   }
 
-  static Matrix4 makeTranslation(const Cvec3& t) {
+  constexpr static Matrix4 makeTranslation(const Cvec3& t) {
     Matrix4 r;
     for (int i = 0; i < 3; ++i) {
       r(i,3) = t[i];
@@ -167,7 +191,7 @@ public:
     return r;
   }
 
-  static Matrix4 makeScale(const Cvec3& s) {
+  constexpr static Matrix4 makeScale(const Cvec3& s) {
     Matrix4 r;
     for (int i = 0; i < 3; ++i) {
       r(i,i) = s[i];
@@ -219,8 +243,8 @@ public:
 
 };
 
-inline bool isAffine(const Matrix4& m) {
-  return std::abs(m[15]-1) + std::abs(m[14]) + std::abs(m[13]) + std::abs(m[12]) < CS175_EPS;
+constexpr bool isAffine(const Matrix4& m) {
+  return constAbs(m[15]-1) + constAbs(m[14]) + constAbs(m[13]) + constAbs(m[12]) < CS175_EPS;
 }
 
 inline double norm2(const Matrix4& m) {
@@ -0,0 +1,62 @@
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <stdexcept>
+
+#include "meshfile.h"
+
+using namespace std;
+
+static const char MESHFILE_MAGIC[4] = {'S', 'K', 'M', 'B'};
+
+static unsigned int alignUp(unsigned int offset) {
+  return (offset + MESHFILE_ALIGNMENT - 1) / MESHFILE_ALIGNMENT * MESHFILE_ALIGNMENT;
+}
+
+static void writePadding(ofstream& f, unsigned int offset) {
+  static const char zeros[MESHFILE_ALIGNMENT] = {0};
+  f.write(zeros, alignUp(offset) - offset);
+}
+
+void writeMeshFile(const char* filename, unsigned int vertexFormat,
+                   const void* vertices, unsigned int vertexStride, unsigned int vertexCount,
+                   const unsigned short* indices, unsigned int indexCount, unsigned int stripCount) {
+  MeshFileHeader h;
+  memcpy(h.magic, MESHFILE_MAGIC, 4);
+  h.version = MESHFILE_VERSION;
+  h.vertexFormat = vertexFormat;
+  h.vertexStride = vertexStride;
+  h.vertexCount = vertexCount;
+  h.indexCount = indexCount;
+  h.stripCount = stripCount;
+  h.vertexOffset = alignUp(sizeof(MeshFileHeader));
+  h.indexOffset = alignUp(h.vertexOffset + vertexStride * vertexCount);
+
+  ofstream f(filename, ios::binary);
+  if (!f)
+    throw runtime_error(string("Cannot open file ") + filename);
+
+  f.write(reinterpret_cast<const char*>(&h), sizeof(h));
+  writePadding(f, sizeof(h));
+  f.write(static_cast<const char*>(vertices), vertexStride * vertexCount);
+  writePadding(f, h.vertexOffset + vertexStride * vertexCount);
+  f.write(reinterpret_cast<const char*>(indices), sizeof(unsigned short) * indexCount);
+
+  if (!f)
+    throw runtime_error(string("Cannot write file ") + filename);
+}
+
+MappedMeshFile::MappedMeshFile(const char* filename)
+  : file_(filename) {
+  const MeshFileHeader& h = getHeader();
+  const size_t size = file_.getSize();
+  const bool valid = size >= sizeof(MeshFileHeader) &&
+                     memcmp(h.magic, MESHFILE_MAGIC, 4) == 0 &&
+                     h.version == MESHFILE_VERSION &&
+                     h.vertexOffset % MESHFILE_ALIGNMENT == 0 &&
+                     h.indexOffset % MESHFILE_ALIGNMENT == 0 &&
+                     h.vertexOffset + size_t(h.vertexStride) * h.vertexCount <= h.indexOffset &&
+                     h.indexOffset + sizeof(unsigned short) * h.indexCount <= size;
+  if (!valid)
+    throw runtime_error(string("Invalid mesh file ") + filename);
+}
@@ -0,0 +1,62 @@
+#ifndef MESHFILE_H
+#define MESHFILE_H
+
+#include <cstddef>
+
+#include "mappedfile.h"
+
+//--------------------------------------------------------------------------------
+// Binary mesh container. Vertex and index sections are stored exactly as the
+// GPU consumes them, so a mapped file can be handed to glBufferData as is.
+//--------------------------------------------------------------------------------
+
+// Every section starts on a multiple of this many bytes from the start of
+// the file (the mapping itself is page aligned)
+static const unsigned int MESHFILE_ALIGNMENT = 64;
+static const unsigned int MESHFILE_VERSION = 1;
+
+// Vertex layouts a file can hold
+enum MeshFileVertexFormat {
+  MESHFILE_FORMAT_VERTEXPNB = 1   // VertexPNB of main.cpp: p, n, bw as float[3], bn as int[3]
+};
+
+struct MeshFileHeader {
+  char magic[4];              // "SKMB"
+  unsigned int version;
+  unsigned int vertexFormat;  // one of MeshFileVertexFormat
+  unsigned int vertexStride;  // bytes per vertex
+  unsigned int vertexCount;
+  unsigned int indexCount;    // 16 bit indices
+  unsigned int stripCount;    // 0 for a triangle list, as for Geometry
+  unsigned int vertexOffset;  // byte offset of the vertex section
+  unsigned int indexOffset;   // byte offset of the index section
+};
+
+// Writes a mesh file. Throws runtime_error on error.
+void writeMeshFile(const char* filename, unsigned int vertexFormat,
+                   const void* vertices, unsigned int vertexStride, unsigned int vertexCount,
+                   const unsigned short* indices, unsigned int indexCount, unsigned int stripCount);
+
+// A read-only memory mapping of a mesh file. The pointers stay valid for the
+// lifetime of the object. Throws runtime_error if the file cannot be mapped
+// or is not a valid mesh file.
+class MappedMeshFile {
+  MappedFile file_;
+
+public:
+  explicit MappedMeshFile(const char* filename);
+
+  const MeshFileHeader& getHeader() const {
+    return *reinterpret_cast<const MeshFileHeader*>(file_.getData());
+  }
+
+  const void* getVertices() const {
+    return file_.getData() + getHeader().vertexOffset;
+  }
+
+  const unsigned short* getIndices() const {
+    return reinterpret_cast<const unsigned short*>(file_.getData() + getHeader().indexOffset);
+  }
+};
+
+#endif
@@ -0,0 +1,261 @@
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <cassert>
+
+#include "meshoptimizer.h"
+
+using namespace std;
+
+void printMeshOptimizeStats(const char* name, const MeshOptimizeStats& s) {
+  cout << "Mesh " << name << ": "
+       << s.vertsBefore << " -> " << s.vertsAfter << " vertices, "
+       << s.trisBefore << " -> " << s.trisAfter << " triangles"
+       << (s.convertedToList ? " (strips converted to list)" : "") << ", "
+       << "ACMR " << s.acmrBefore << " -> " << s.acmrAfter << ", "
+       << "ATVR " << s.atvrBefore << " -> " << s.atvrAfter << endl;
+}
+
+static bool isDegenerate(unsigned short a, unsigned short b, unsigned short c) {
+  return a == b || b == c || a == c;
+}
+
+void stripsToList(const unsigned short* strips, int iboLen, int stripCount, vector<unsigned short>& list) {
+  assert(stripCount > 0 && iboLen % stripCount == 0);
+  const int stripLen = iboLen / stripCount;
+
+  list.clear();
+  list.reserve((stripLen - 2) * stripCount * 3);
+  for (int s = 0; s < stripCount; ++s) {
+    const unsigned short* strip = strips + s * stripLen;
+    for (int i = 0; i + 2 < stripLen; ++i) {
+      unsigned short a = strip[i], b = strip[i + 1], c = strip[i + 2];
+      if (isDegenerate(a, b, c))
+        continue;
+      // every other triangle of a strip has its winding flipped
+      if (i & 1)
+        std::swap(a, b);
+      list.push_back(a);
+      list.push_back(b);
+      list.push_back(c);
+    }
+  }
+}
+
+int countTriangles(const unsigned short* idx, int idxLen, int stripCount) {
+  int tris = 0;
+  if (stripCount > 0) {
+    const int stripLen = idxLen / stripCount;
+    for (int s = 0; s < stripCount; ++s) {
+      for (int i = s * stripLen; i + 2 < (s + 1) * stripLen; ++i) {
+        tris += !isDegenerate(idx[i], idx[i + 1], idx[i + 2]);
+      }
+    }
+  }
+  else {
+    for (int i = 0; i + 2 < idxLen; i += 3) {
+      tris += !isDegenerate(idx[i], idx[i + 1], idx[i + 2]);
+    }
+  }
+  return tris;
+}
+
+int countCacheMisses(const unsigned short* idx, int idxLen, int vertexCount, int cacheSize) {
+  // A vertex is in the FIFO iff fewer than cacheSize misses happened since it
+  // was last inserted, so storing the insertion "time" is enough.
+  vector<int> insertedAt(vertexCount, -cacheSize - 1);
+  int misses = 0;
+  for (int i = 0; i < idxLen; ++i) {
+    const int v = idx[i];
+    if (misses - insertedAt[v] > cacheSize) {
+      insertedAt[v] = misses;
+      ++misses;
+    }
+  }
+  return misses;
+}
+
+// -------- Forsyth vertex cache optimization
+
+static const int FORSYTH_CACHE_SIZE = 32;
+static const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+static const float FORSYTH_LAST_TRI_SCORE = 0.75f;
+static const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+static const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+static float forsythVertexScore(int cachePos, int liveTris) {
+  if (liveTris == 0)
+    return -1.0f;   // no triangle needs this vertex any more
+
+  float score = 0.0f;
+  if (cachePos >= 0) {
+    if (cachePos < 3) {
+      // the vertices of the last triangle get a fixed score, otherwise the
+      // algorithm would favour re-using them in the very same order
+      score = FORSYTH_LAST_TRI_SCORE;
+    }
+    else {
+      const float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+      score = std::pow(1.0f - (cachePos - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+    }
+  }
+  // bonus for vertices with few remaining triangles so lone triangles get
+  // cleared rather than left for later
+  score += FORSYTH_VALENCE_BOOST_SCALE * std::pow(float(liveTris), -FORSYTH_VALENCE_BOOST_POWER);
+  return score;
+}
+
+void optimizeVertexCache(vector<unsigned short>& idx, int vertexCount) {
+  const int triCount = (int) idx.size() / 3;
+  if (triCount == 0)
+    return;
+
+  // vertex -> triangle adjacency, stored CSR-style
+  vector<int> liveTris(vertexCount, 0), adjStart(vertexCount + 1, 0);
+  for (size_t i = 0; i < idx.size(); ++i) {
+    ++liveTris[idx[i]];
+  }
+  for (int v = 0; v < vertexCount; ++v) {
+    adjStart[v + 1] = adjStart[v] + liveTris[v];
+  }
+  vector<int> adj(idx.size()), adjFill(adjStart.begin(), adjStart.end() - 1);
+  for (int t = 0; t < triCount; ++t) {
+    for (int k = 0; k < 3; ++k) {
+      adj[adjFill[idx[3 * t + k]]++] = t;
+    }
+  }
+
+  vector<int> cachePos(vertexCount, -1);
+  vector<float> vertScore(vertexCount);
+  for (int v = 0; v < vertexCount; ++v) {
+    vertScore[v] = forsythVertexScore(-1, liveTris[v]);
+  }
+  vector<float> triScore(triCount);
+  vector<char> triAdded(triCount, 0);
+  for (int t = 0; t < triCount; ++t) {
+    triScore[t] = vertScore[idx[3 * t]] + vertScore[idx[3 * t + 1]] + vertScore[idx[3 * t + 2]];
+  }
+
+  vector<unsigned short> out;
+  out.reserve(idx.size());
+  int cache[FORSYTH_CACHE_SIZE + 3], cacheLen = 0;
+  int bestTri = -1, scanFrom = 0;
+
+  for (int emitted = 0; emitted < triCount; ++emitted) {
+    if (bestTri < 0) {
+      // nothing adjacent to the cache is left: fall back to a linear scan
+      // for the best remaining triangle
+      float best = -1.0f;
+      for (int t = scanFrom; t < triCount; ++t) {
+        if (!triAdded[t] && triScore[t] > best) {
+          best = triScore[t];
+          bestTri = t;
+        }
+      }
+      while (triAdded[scanFrom])
+        ++scanFrom;
+    }
+
+    // emit the triangle and push its vertices to the front of the cache
+    triAdded[bestTri] = 1;
+    int newCache[FORSYTH_CACHE_SIZE + 3], newLen = 0;
+    for (int k = 0; k < 3; ++k) {
+      const int v = idx[3 * bestTri + k];
+      out.push_back((unsigned short) v);
+      newCache[newLen++] = v;
+
+      // remove the triangle from the vertex' live list
+      int* first = &adj[adjStart[v]];
+      int* last = first + liveTris[v];
+      for (int* it = first; it != last; ++it) {
+        if (*it == bestTri) {
+          *it = *(last - 1);
+          break;
+        }
+      }
+      --liveTris[v];
+    }
+    for (int i = 0; i < cacheLen; ++i) {
+      const int v = cache[i];
+      if (v != newCache[0] && v != newCache[1] && v != newCache[2])
+        newCache[newLen++] = v;
+    }
+
+    // rescore everything in the (possibly overflowing) cache; vertices
+    // pushed out get their position reset
+    for (int i = 0; i < newLen; ++i) {
+      const int v = newCache[i];
+      cachePos[v] = i < FORSYTH_CACHE_SIZE ? i : -1;
+      const float newScore = forsythVertexScore(cachePos[v], liveTris[v]);
+      const float diff = newScore - vertScore[v];
+      vertScore[v] = newScore;
+      for (int j = adjStart[v]; j < adjStart[v] + liveTris[v]; ++j) {
+        triScore[adj[j]] += diff;
+      }
+    }
+    cacheLen = std::min(newLen, FORSYTH_CACHE_SIZE);
+    std::memcpy(cache, newCache, cacheLen * sizeof(int));
+
+    // the next triangle is the best one touching the cache
+    bestTri = -1;
+    float best = -1.0f;
+    for (int i = 0; i < cacheLen; ++i) {
+      const int v = cache[i];
+      for (int j = adjStart[v]; j < adjStart[v] + liveTris[v]; ++j) {
+        const int t = adj[j];
+        if (triScore[t] > best) {
+          best = triScore[t];
+          bestTri = t;
+        }
+      }
+    }
+  }
+
+  idx.swap(out);
+}
+
+int computeFetchRemap(const vector<unsigned short>& idx, int vertexCount, vector<int>& remap) {
+  remap.assign(vertexCount, -1);
+  int next = 0;
+  for (size_t i = 0; i < idx.size(); ++i) {
+    if (remap[idx[i]] < 0)
+      remap[idx[i]] = next++;
+  }
+  return next;
+}
+
+// FNV-1a over the raw bytes of a vertex
+static unsigned int hashBytes(const unsigned char* p, size_t len) {
+  unsigned int h = 2166136261u;
+  for (size_t i = 0; i < len; ++i) {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  return h;
+}
+
+int computeWeldRemap(const void* vertices, int vertexCount, size_t stride, vector<int>& remap) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(vertices);
+
+  // open addressing table of vertex ids, kept at most half full
+  size_t tableSize = 1;
+  while (tableSize < size_t(vertexCount) * 2)
+    tableSize <<= 1;
+  vector<int> table(tableSize, -1);
+
+  remap.assign(vertexCount, -1);
+  int unique = 0;
+  for (int v = 0; v < vertexCount; ++v) {
+    const unsigned char* p = bytes + v * stride;
+    size_t slot = hashBytes(p, stride) & (tableSize - 1);
+    while (table[slot] >= 0 && std::memcmp(bytes + table[slot] * stride, p, stride) != 0)
+      slot = (slot + 1) & (tableSize - 1);
+
+    if (table[slot] < 0) {
+      table[slot] = v;
+      remap[v] = unique++;
+    }
+    else
+      remap[v] = remap[table[slot]];
+  }
+  return unique;
+}
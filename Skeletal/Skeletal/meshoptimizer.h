@@ -0,0 +1,121 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <vector>
+#include <cstddef>
+
+//--------------------------------------------------------------------------------
+// Mesh optimization stage run between the make* generators in geometrymaker.h
+// and the Geometry upload: welds duplicate vertices, converts triangle strips
+// to lists, reorders triangles for the post-transform vertex cache and
+// reorders vertices for fetch locality.
+//--------------------------------------------------------------------------------
+
+// Number of entries of the simulated FIFO post-transform cache used to compute
+// ACMR/ATVR. 32 is a conservative figure for current hardware.
+static const int MESHOPT_CACHE_SIZE = 32;
+
+// Statistics reported by optimizeMesh. ACMR is the average number of vertex
+// shader invocations per triangle (lower is better, 0.5 is the ideal for a
+// regular grid) and ATVR the number of invocations per unique vertex (1.0 is
+// ideal).
+struct MeshOptimizeStats {
+  int vertsBefore, vertsAfter;
+  int trisBefore, trisAfter;
+  double acmrBefore, acmrAfter;
+  double atvrBefore, atvrAfter;
+  bool convertedToList;
+};
+
+// Prints before/after figures in a single line
+void printMeshOptimizeStats(const char* name, const MeshOptimizeStats& stats);
+
+// Converts `stripCount' triangle strips of equal length stored back to back
+// into an indexed triangle list. Degenerate triangles are dropped and winding
+// is preserved.
+void stripsToList(const unsigned short* strips, int iboLen, int stripCount, std::vector<unsigned short>& list);
+
+// Simulates a FIFO cache of `cacheSize' entries over an index stream. Returns
+// the number of cache misses. Works on strips as well as on lists since only
+// the order of references matters.
+int countCacheMisses(const unsigned short* idx, int idxLen, int vertexCount, int cacheSize);
+
+// Number of non-degenerate triangles described by an index stream
+int countTriangles(const unsigned short* idx, int idxLen, int stripCount);
+
+// Reorders the triangles of an indexed triangle list in place using Tom
+// Forsyth's linear-speed vertex cache optimization.
+void optimizeVertexCache(std::vector<unsigned short>& idx, int vertexCount);
+
+// Builds a remap table that renumbers vertices in order of first reference
+// by the index list. Unreferenced vertices are mapped to -1. Returns the
+// number of referenced vertices.
+int computeFetchRemap(const std::vector<unsigned short>& idx, int vertexCount, std::vector<int>& remap);
+
+// Builds a remap table that maps bitwise identical vertices onto the first
+// occurence, found by hashing the raw vertex bytes. The new numbering is
+// compact. Returns the number of unique vertices.
+int computeWeldRemap(const void* vertices, int vertexCount, size_t stride, std::vector<int>& remap);
+
+// Applies a remap table produced by computeFetchRemap or computeWeldRemap
+template<typename Vertex>
+void remapMesh(std::vector<Vertex>& vtx, std::vector<unsigned short>& idx,
+               const std::vector<int>& remap, int newCount) {
+  std::vector<Vertex> out(newCount);
+  for (size_t i = 0; i < vtx.size(); ++i) {
+    if (remap[i] >= 0)
+      out[remap[i]] = vtx[i];
+  }
+  vtx.swap(out);
+  for (size_t i = 0; i < idx.size(); ++i) {
+    idx[i] = (unsigned short) remap[idx[i]];
+  }
+}
+
+// Runs the whole pipeline on a mesh produced by the make* functions.
+// `stripCount' is the number of strips idx holds (as passed to Geometry), or 0
+// for a triangle list. Strips are converted to a list whenever that lowers
+// the number of draw calls or the ACMR; on return stripCount is updated
+// accordingly. Vertex is required to be a plain struct without padding so
+// that duplicates can be detected bytewise.
+template<typename Vertex>
+MeshOptimizeStats optimizeMesh(std::vector<Vertex>& vtx, std::vector<unsigned short>& idx, int& stripCount) {
+  MeshOptimizeStats stats;
+  stats.vertsBefore = (int) vtx.size();
+  stats.trisBefore = countTriangles(&idx[0], (int) idx.size(), stripCount);
+  const int missesBefore = countCacheMisses(&idx[0], (int) idx.size(), (int) vtx.size(), MESHOPT_CACHE_SIZE);
+  stats.acmrBefore = double(missesBefore) / stats.trisBefore;
+  stats.atvrBefore = double(missesBefore) / stats.vertsBefore;
+
+  std::vector<int> remap;
+  int count = computeWeldRemap(&vtx[0], (int) vtx.size(), sizeof(Vertex), remap);
+  if (count < (int) vtx.size())
+    remapMesh(vtx, idx, remap, count);
+
+  std::vector<unsigned short> list;
+  if (stripCount > 0)
+    stripsToList(&idx[0], (int) idx.size(), stripCount, list);
+  else
+    list = idx;
+  optimizeVertexCache(list, (int) vtx.size());
+
+  const int listMisses = countCacheMisses(&list[0], (int) list.size(), (int) vtx.size(), MESHOPT_CACHE_SIZE);
+  const int stripMisses = countCacheMisses(&idx[0], (int) idx.size(), (int) vtx.size(), MESHOPT_CACHE_SIZE);
+  stats.convertedToList = stripCount > 0 && (stripCount > 1 || listMisses < stripMisses);
+  if (stripCount == 0 || stats.convertedToList) {
+    idx.swap(list);
+    stripCount = 0;
+  }
+
+  count = computeFetchRemap(idx, (int) vtx.size(), remap);
+  remapMesh(vtx, idx, remap, count);
+
+  stats.vertsAfter = (int) vtx.size();
+  stats.trisAfter = countTriangles(&idx[0], (int) idx.size(), stripCount);
+  const int missesAfter = countCacheMisses(&idx[0], (int) idx.size(), (int) vtx.size(), MESHOPT_CACHE_SIZE);
+  stats.acmrAfter = double(missesAfter) / stats.trisAfter;
+  stats.atvrAfter = double(missesAfter) / stats.vertsAfter;
+  return stats;
+}
+
+#endif
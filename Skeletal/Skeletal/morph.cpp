@@ -0,0 +1,166 @@
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MORPH_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "morph.h"
+
+using namespace std;
+
+// the six deltas of a MorphDelta are added to the six floats starting at p
+static_assert(offsetof(VertexPNB, n) == offsetof(VertexPNB, p) + 3 * sizeof(float),
+              "VertexPNB::n must follow VertexPNB::p");
+
+static short quantize(float x, float scale) {
+  return (short) floor(x / scale + 0.5f);
+}
+
+void MorphSet::addTarget(const string& name, const vector<VertexPNB>& base,
+                         const vector<VertexPNB>& target, float epsilon) {
+  if (vertexCount_ == 0)
+    vertexCount_ = (int) base.size();
+  if ((int) base.size() != vertexCount_ || target.size() != base.size())
+    throw runtime_error("Morph target " + name + " does not match the base mesh");
+  if ((int) targets_.size() == MORPH_MAX_TARGETS)
+    throw runtime_error("Too many morph targets");
+
+  MorphTarget t;
+  t.name = name;
+  float maxPosition = 0, maxNormal = 0;
+  for (int i = 0; i < vertexCount_; ++i) {
+    const Cvec3f dp = target[i].p - base[i].p, dn = target[i].n - base[i].n;
+    float moved = 0;
+    for (int j = 0; j < 3; ++j) {
+      moved = max(moved, max(abs(dp[j]), abs(dn[j])));
+      maxPosition = max(maxPosition, abs(dp[j]));
+      maxNormal = max(maxNormal, abs(dn[j]));
+    }
+    if (moved > epsilon)
+      t.vertices.push_back(i);
+  }
+
+  // one scale per stream and target, spreading the largest delta over the
+  // whole 16 bit range
+  t.positionScale = maxPosition > 0 ? maxPosition / 32767 : 1;
+  t.normalScale = maxNormal > 0 ? maxNormal / 32767 : 1;
+  t.deltas.resize(t.vertices.size());
+  for (size_t k = 0; k < t.vertices.size(); ++k) {
+    const int i = t.vertices[k];
+    MorphDelta& d = t.deltas[k];
+    for (int j = 0; j < 3; ++j) {
+      d.d[j] = quantize(target[i].p[j] - base[i].p[j], t.positionScale);
+      d.d[3 + j] = quantize(target[i].n[j] - base[i].n[j], t.normalScale);
+    }
+    d.d[6] = d.d[7] = 0;
+  }
+  targets_.push_back(t);
+}
+
+float MorphSet::getMaxPositionDelta() const {
+  float sum = 0;
+  for (size_t t = 0; t < targets_.size(); ++t) {
+    int largest = 0;
+    for (size_t i = 0; i < targets_[t].deltas.size(); ++i) {
+      for (int j = 0; j < 3; ++j)
+        largest = max(largest, abs((int) targets_[t].deltas[i].d[j]));
+    }
+    sum += largest * targets_[t].positionScale;
+  }
+  return sum;
+}
+
+void MorphSet::buildGpuStreams(vector<short>& deltas, vector<int>& ranges) const {
+  ranges.assign(2 * vertexCount_, 0);
+  for (size_t t = 0; t < targets_.size(); ++t) {
+    for (size_t k = 0; k < targets_[t].vertices.size(); ++k)
+      ++ranges[2 * targets_[t].vertices[k] + 1];
+  }
+  int first = 0;
+  for (int i = 0; i < vertexCount_; ++i) {
+    ranges[2 * i] = first;
+    first += ranges[2 * i + 1];
+  }
+
+  deltas.resize(8 * first);
+  vector<int> next(vertexCount_);
+  for (int i = 0; i < vertexCount_; ++i)
+    next[i] = ranges[2 * i];
+  for (size_t t = 0; t < targets_.size(); ++t) {
+    for (size_t k = 0; k < targets_[t].vertices.size(); ++k) {
+      const short* d = targets_[t].deltas[k].d;
+      short* dst = &deltas[8 * next[targets_[t].vertices[k]]++];
+      dst[0] = d[0]; dst[1] = d[1]; dst[2] = d[2]; dst[3] = (short) t;
+      dst[4] = d[3]; dst[5] = d[4]; dst[6] = d[5]; dst[7] = 0;
+    }
+  }
+}
+
+// Adds the deltas of a target, scaled by its weight, to the vertices it moves
+static void addDeltas(const MorphTarget& t, float weight, VertexPNB* vertices) {
+  const float ps = weight * t.positionScale, ns = weight * t.normalScale;
+  const int count = (int) t.vertices.size();
+#ifdef MORPH_SSE2
+  // one delta per iteration: its eight shorts are widened to two float
+  // vectors, p.xyz n.x and n.yz plus padding
+  const __m128 scaleLo = _mm_setr_ps(ps, ps, ps, ns);
+  const __m128 scaleHi = _mm_setr_ps(ns, ns, 0, 0);
+  for (int k = 0; k < count; ++k) {
+    const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.deltas[k].d));
+    const __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(d, d), 16));
+    const __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(d, d), 16));
+    float* f = &vertices[t.vertices[k]].p[0];
+    _mm_storeu_ps(f, _mm_add_ps(_mm_loadu_ps(f), _mm_mul_ps(lo, scaleLo)));
+    const __m128 n = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(f + 4));
+    _mm_storel_pi(reinterpret_cast<__m64*>(f + 4), _mm_add_ps(n, _mm_mul_ps(hi, scaleHi)));
+  }
+#else
+  for (int k = 0; k < count; ++k) {
+    const short* d = t.deltas[k].d;
+    VertexPNB& v = vertices[t.vertices[k]];
+    for (int j = 0; j < 3; ++j) {
+      v.p[j] += ps * d[j];
+      v.n[j] += ns * d[3 + j];
+    }
+  }
+#endif
+}
+
+void MorphApplier::apply(const MorphSet& morphs, const float weights[]) {
+  dirty_.clear();
+
+  // restore what the last apply moved
+  for (size_t k = 0; k < touched_.size(); ++k) {
+    const int i = touched_[k];
+    morphed_[i].p = base_[i].p;
+    morphed_[i].n = base_[i].n;
+    isDirty_[i] = 1;
+    dirty_.push_back(i);
+  }
+  touched_.clear();
+
+  for (int t = 0; t < morphs.getTargetCount(); ++t) {
+    if (weights[t] == 0)
+      continue;
+    const MorphTarget& target = morphs.getTarget(t);
+    addDeltas(target, weights[t], &morphed_[0]);
+    touched_.insert(touched_.end(), target.vertices.begin(), target.vertices.end());
+    for (size_t k = 0; k < target.vertices.size(); ++k) {
+      const int i = target.vertices[k];
+      if (!isDirty_[i]) {
+        isDirty_[i] = 1;
+        dirty_.push_back(i);
+      }
+    }
+  }
+
+  sort(touched_.begin(), touched_.end());
+  touched_.erase(unique(touched_.begin(), touched_.end()), touched_.end());
+  sort(dirty_.begin(), dirty_.end());
+  for (size_t k = 0; k < dirty_.size(); ++k)
+    isDirty_[dirty_[k]] = 0;
+}
@@ -0,0 +1,96 @@
+#ifndef MORPH_H
+#define MORPH_H
+
+#include <vector>
+#include <string>
+
+#include "vertexpnb.h"
+
+//--------------------------------------------------------------------------------
+// Sparse morph targets (blend shapes). A target only stores the vertices it
+// moves, each as a position and normal delta quantized to 16 bits. Targets
+// are applied to the bind pose before skinning, either on the CPU by
+// MorphApplier or in morph.vshader from the streams of buildGpuStreams.
+//--------------------------------------------------------------------------------
+
+static const int MORPH_MAX_TARGETS = 16;  // size of the weight arrays in morph.vshader
+
+// Quantized delta of one vertex: p and n are contiguous in VertexPNB, so the
+// six deltas apply to six consecutive floats. Padded to 16 bytes for SIMD
+// loads.
+struct MorphDelta {
+  short d[8];  // position xyz, normal xyz, 2 unused
+};
+
+struct MorphTarget {
+  std::string name;
+  std::vector<int> vertices;        // sorted indices of the moved vertices
+  std::vector<MorphDelta> deltas;   // delta of each of them
+  float positionScale;              // dequantized delta = d * scale
+  float normalScale;
+};
+
+class MorphSet {
+  std::vector<MorphTarget> targets_;
+  int vertexCount_;
+
+public:
+  explicit MorphSet(int vertexCount = 0) : vertexCount_(vertexCount) {}
+
+  // Adds the difference between the base mesh and the same mesh in the
+  // target shape, keeping the vertices whose position or normal moved by
+  // more than epsilon. Throws runtime_error if the meshes do not match or
+  // there are already MORPH_MAX_TARGETS targets.
+  void addTarget(const std::string& name, const std::vector<VertexPNB>& base,
+                 const std::vector<VertexPNB>& target, float epsilon = 1e-5f);
+
+  int getVertexCount() const {
+    return vertexCount_;
+  }
+
+  int getTargetCount() const {
+    return (int) targets_.size();
+  }
+
+  const MorphTarget& getTarget(int i) const {
+    return targets_[i];
+  }
+
+  // Streams for morph.vshader, grouped by vertex: four shorts per texel,
+  // two texels per delta (position and target index, then normal), and for
+  // each vertex its first delta and delta count. Vertices no target moves
+  // have a count of 0.
+  void buildGpuStreams(std::vector<short>& deltas, std::vector<int>& ranges) const;
+
+  // Farthest any vertex can move along an axis with every weight in [0,1]:
+  // the sum over targets of each one's largest position delta
+  float getMaxPositionDelta() const;
+};
+
+// Keeps a morphed copy of a base mesh. Only the vertices moved last time or
+// this time are restored and morphed, and only those need uploading.
+class MorphApplier {
+  std::vector<VertexPNB> base_, morphed_;
+  std::vector<int> touched_;  // vertices morphed by the last apply
+  std::vector<int> dirty_;    // vertices changed by the last apply
+  std::vector<char> isDirty_;
+
+public:
+  explicit MorphApplier(const std::vector<VertexPNB>& base)
+    : base_(base), morphed_(base), isDirty_(base.size(), 0) {}
+
+  // Morphs the base by weights[i] of every target i. Targets with a zero
+  // weight cost nothing.
+  void apply(const MorphSet& morphs, const float weights[]);
+
+  const std::vector<VertexPNB>& getVertices() const {
+    return morphed_;
+  }
+
+  // Sorted indices of the vertices the last apply changed
+  const std::vector<int>& getDirty() const {
+    return dirty_;
+  }
+};
+
+#endif
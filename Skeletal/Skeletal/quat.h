@@ -2,116 +2,117 @@
 #define QUAT_H
 
 #include <iostream>
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 
 #include "cvec.h"
 #include "matrix4.h"
+#include "constmath.h"
 
 // Forward declarations used in the definition of Quat;
 class Quat;
-double dot(const Quat& q, const Quat& p);
-double norm2(const Quat& q);
-Quat inv(const Quat& q);
+class UnitQuat;
+constexpr double dot(const Quat& q, const Quat& p);
+constexpr double norm2(const Quat& q);
+constexpr Quat inv(const Quat& q);
 Quat normalize(const Quat& q);
-Matrix4 quatToMatrix(const Quat& q);
+constexpr Matrix4 quatToMatrix(const Quat& q);
 
+// Everything but normalize, pow, slerp and the make*Rotation functions is
+// constexpr, so key poses given by literal angles, such as
+// Quat::makeConstZRotation(60), are built at compile time
 class Quat {
   Cvec4 q_;  // layout is: q_[0]==w, q_[1]==x, q_[2]==y, q_[3]==z
 
 public:
-  double operator [] (const int i) const {
+  constexpr double operator [] (const int i) const {
     return q_[i];
   }
 
-  double& operator [] (const int i) {
+  constexpr double& operator [] (const int i) {
     return q_[i];
   }
 
-  double operator () (const int i) const {
+  constexpr double operator () (const int i) const {
     return q_[i];
   }
 
-  double& operator () (const int i) {
+  constexpr double& operator () (const int i) {
     return q_[i];
   }
 
-  Quat() : q_(1,0,0,0) {}
-  Quat(const double w, const Cvec3& v) : q_(w, v[0], v[1], v[2]) {}
-  Quat(const double w, const double x, const double y, const double z) : q_(w, x,y,z) {}
+  constexpr Quat() : q_(1,0,0,0) {}
+  constexpr Quat(const double w, const Cvec3& v) : q_(w, v[0], v[1], v[2]) {}
+  constexpr Quat(const double w, const double x, const double y, const double z) : q_(w, x,y,z) {}
 
-  Quat& operator += (const Quat& a) {
+  constexpr Quat& operator += (const Quat& a) {
     q_ += a.q_;
     return *this;
   }
 
-  Quat& operator -= (const Quat& a) {
+  constexpr Quat& operator -= (const Quat& a) {
     q_ -= a.q_;
     return *this;
   }
 
-  Quat& operator *= (const double a) {
+  constexpr Quat& operator *= (const double a) {
     q_ *= a;
     return *this;
   }
 
-  Quat& operator /= (const double a) {
+  constexpr Quat& operator /= (const double a) {
     q_ /= a;
     return *this;
   }
 
-  Quat operator + (const Quat& a) const {
+  constexpr Quat operator + (const Quat& a) const {
     return Quat(*this) += a;
   }
 
-  Quat operator - (const Quat& a) const {
+  constexpr Quat operator - (const Quat& a) const {
     return Quat(*this) -= a;
   }
 
-  Quat operator * (const double a) const {
+  constexpr Quat operator * (const double a) const {
     return Quat(*this) *= a;
   }
 
-  Quat operator / (const double a) const {
+  constexpr Quat operator / (const double a) const {
     return Quat(*this) /= a;
   }
 
-  Quat operator * (const Quat& a) const {
+  constexpr Quat operator * (const Quat& a) const {
     const Cvec3 u(q_[1], q_[2], q_[3]), v(a.q_[1], a.q_[2], a.q_[3]);
     return Quat(q_[0]*a.q_[0] - dot(u, v), (v*q_[0] + u*a.q_[0]) + cross(u, v));
   }
 
-  Cvec4 operator * (const Cvec4& a) const {
-    const Quat r = *this * (Quat(0, a[0], a[1], a[2]) * inv(*this));
-    return Cvec4(r[1], r[2], r[3], a[3]);
+  // q (0, v) q^-1 expanded, for q = (w, u):
+  // (v (w^2 - u.u) + 2 u (u.v) + 2 w (u x v)) / |q|^2
+  constexpr Cvec4 operator * (const Cvec4& a) const {
+    const Cvec3 u(q_[1], q_[2], q_[3]), v(a[0], a[1], a[2]);
+    const double uu = dot(u, u), n = q_[0] * q_[0] + uu;
+    assert(n > CS175_EPS2);
+    const Cvec3 r = v * (q_[0] * q_[0] - uu) + u * (2 * dot(u, v)) + cross(u, v) * (2 * q_[0]);
+    return Cvec4(r / n, a[3]);
   }
 
-  static Quat makeXRotation(const double ang) {
-    Quat r;
-    const double h = 0.5 * ang * CS175_PI/180;
-    r.q_[1] = std::sin(h);
-    r.q_[0] = std::cos(h);
-    return r;
-  }
+  static UnitQuat makeXRotation(const double ang);
 
-  static Quat makeYRotation(const double ang) {
-    Quat r;
-    const double h = 0.5 * ang * CS175_PI/180;
-    r.q_[2] = std::sin(h);
-    r.q_[0] = std::cos(h);
-    return r;
-  }
+  static UnitQuat makeYRotation(const double ang);
 
-  static Quat makeZRotation(const double ang) {
-    Quat r;
-    const double h = 0.5 * ang * CS175_PI/180;
-    r.q_[3] = std::sin(h);
-    r.q_[0] = std::cos(h);
-    return r;
-  }
+  static UnitQuat makeZRotation(const double ang);
+
+  // The same for angles known at compile time, through the series of
+  // constmath.h, which cost more than std::sin and std::cos when they run
+  static constexpr UnitQuat makeConstXRotation(const double ang);
+
+  static constexpr UnitQuat makeConstYRotation(const double ang);
+
+  static constexpr UnitQuat makeConstZRotation(const double ang);
 };
 
-inline double dot(const Quat& q, const Quat& p) {
+constexpr double dot(const Quat& q, const Quat& p) {
   double s = 0.0;
   for (int i = 0; i < 4; ++i) {
     s += q(i) * p(i);
@@ -119,11 +120,11 @@ inline double dot(const Quat& q, const Quat& p) {
   return s;
 }
 
-inline double norm2(const Quat& q) {
+constexpr double norm2(const Quat& q) {
   return dot(q, q);
 }
 
-inline Quat inv(const Quat& q) {
+constexpr Quat inv(const Quat& q) {
   const double n = norm2(q);
   assert(n > CS175_EPS2);
   return Quat(q(0), -q(1), -q(2), -q(3)) * (1.0/n);
@@ -133,7 +134,7 @@ inline Quat normalize(const Quat& q) {
   return q / std::sqrt(norm2(q));
 }
 
-inline Matrix4 quatToMatrix(const Quat& q) {
+constexpr Matrix4 quatToMatrix(const Quat& q) {
   Matrix4 r;
   const double n = norm2(q);
   if (n < CS175_EPS2)
@@ -154,10 +155,115 @@ inline Matrix4 quatToMatrix(const Quat& q) {
   return r;
 }
 
+// A quaternion known to have unit length, such as the result of normalize()
+// or makeXRotation(). Rotating by it skips the division by the norm and its
+// inverse is its conjugate. It converts to Quat wherever one is expected.
+class UnitQuat {
+  Quat q_;
+
+  struct Trusted {};
+  constexpr UnitQuat(const Quat& q, Trusted) : q_(q) {}
+
+public:
+  constexpr UnitQuat() {}
+
+  // q must not be zero: it has no direction to normalize to
+  explicit UnitQuat(const Quat& q) : q_(normalize(q)) {
+    assert(norm2(q) > CS175_EPS2);
+  }
+
+  // Wraps a quaternion the caller knows to be unit, without normalizing it
+  static constexpr UnitQuat assumeUnit(const Quat& q) {
+    assert(norm2(q) > 1 - 1e-6 && norm2(q) < 1 + 1e-6);
+    return UnitQuat(q, Trusted());
+  }
+
+  constexpr operator const Quat& () const {
+    return q_;
+  }
+
+  constexpr double operator [] (const int i) const {
+    return q_[i];
+  }
+
+  constexpr UnitQuat operator * (const UnitQuat& a) const {
+    return UnitQuat(q_ * a.q_, Trusted());
+  }
+
+  // v + w t + u x t with t = 2 u x v, for q = (w, u): 15 multiplications
+  // and 15 additions, written out so that no Cvec3 is built
+  constexpr Cvec4 operator * (const Cvec4& a) const {
+    const double w = q_[0], x = q_[1], y = q_[2], z = q_[3];
+    const double tx = 2 * (y * a[2] - z * a[1]);
+    const double ty = 2 * (z * a[0] - x * a[2]);
+    const double tz = 2 * (x * a[1] - y * a[0]);
+    return Cvec4(a[0] + w * tx + (y * tz - z * ty),
+                 a[1] + w * ty + (z * tx - x * tz),
+                 a[2] + w * tz + (x * ty - y * tx), a[3]);
+  }
+
+  friend constexpr UnitQuat inv(const UnitQuat& q) {
+    return UnitQuat(Quat(q[0], -q[1], -q[2], -q[3]), Trusted());
+  }
+};
+
+// A unit quaternion times any other is a plain Quat, as Quat * UnitQuat is
+constexpr Quat operator * (const UnitQuat& q, const Quat& a) {
+  return static_cast<const Quat&>(q) * a;
+}
+
+inline UnitQuat Quat::makeXRotation(const double ang) {
+  const double h = 0.5 * ang * CS175_PI/180;
+  return UnitQuat::assumeUnit(Quat(std::cos(h), std::sin(h), 0, 0));
+}
+
+inline UnitQuat Quat::makeYRotation(const double ang) {
+  const double h = 0.5 * ang * CS175_PI/180;
+  return UnitQuat::assumeUnit(Quat(std::cos(h), 0, std::sin(h), 0));
+}
+
+inline UnitQuat Quat::makeZRotation(const double ang) {
+  const double h = 0.5 * ang * CS175_PI/180;
+  return UnitQuat::assumeUnit(Quat(std::cos(h), 0, 0, std::sin(h)));
+}
+
+constexpr UnitQuat Quat::makeConstXRotation(const double ang) {
+  return UnitQuat::assumeUnit(Quat(cosDegrees(0.5 * ang), sinDegrees(0.5 * ang), 0, 0));
+}
+
+constexpr UnitQuat Quat::makeConstYRotation(const double ang) {
+  return UnitQuat::assumeUnit(Quat(cosDegrees(0.5 * ang), 0, sinDegrees(0.5 * ang), 0));
+}
+
+constexpr UnitQuat Quat::makeConstZRotation(const double ang) {
+  return UnitQuat::assumeUnit(Quat(cosDegrees(0.5 * ang), 0, 0, sinDegrees(0.5 * ang)));
+}
+
+constexpr Matrix4 quatToMatrix(const UnitQuat& q) {
+  const double w = q[0], x = q[1], y = q[2], z = q[3];
+  const double x2 = 2 * x, y2 = 2 * y, z2 = 2 * z;
+  const double xx = x * x2, yy = y * y2, zz = z * z2, xy = x * y2, xz = x * z2, yz = y * z2;
+  const double wx = w * x2, wy = w * y2, wz = w * z2;
+  Matrix4 r;
+  r(0, 0) = 1 - (yy + zz);
+  r(0, 1) = xy - wz;
+  r(0, 2) = xz + wy;
+  r(1, 0) = xy + wz;
+  r(1, 1) = 1 - (xx + zz);
+  r(1, 2) = yz - wx;
+  r(2, 0) = xz - wy;
+  r(2, 1) = yz + wx;
+  r(2, 2) = 1 - (xx + yy);
+  return r;
+}
+
 inline Quat pow(const Quat& q,double p)
 {
-	double angle = std::acos(q(0));
+	double angle = std::acos(std::min(1.0, std::max(-1.0, q(0))));
 	double s = std::sin(angle);
+	// q is 1 or -1, no rotation: the axis is undefined and q^p rotates as q
+	if (std::abs(s) < CS175_EPS)
+		return q;
 	double k1 = q(1)/s;
 	double k2 = q(2)/s;
 	double k3 = q(3)/s;
@@ -7,73 +7,99 @@
 #include "matrix4.h"
 #include "quat.h"
 
+// The rotation is kept as a UnitQuat: a Quat given to the constructors or
+// setRotation is normalized there, once, so that rotating, composing,
+// inverting and converting all take UnitQuat's paths, without the norm.
+// Construction from a translation or a UnitQuat, access and composition
+// are constexpr, like Quat.
 class RigTForm {
-  Cvec3 t_; // translation component
-  Quat r_;  // rotation component represented as a quaternion
+  Cvec3 t_;     // translation component
+  UnitQuat r_;  // rotation component represented as a unit quaternion
 
 public:
-  RigTForm() : t_(0) {
-    assert(norm2(Quat(1,0,0,0) - r_) < CS175_EPS2);
+  constexpr RigTForm() : t_(0) {
   }
 
-  RigTForm(const Cvec3& t, const Quat& r): t_(t),r_(r) {
+  RigTForm(const Cvec3& t, const Quat& r) : t_(t), r_(r) {
   }
 
-  explicit RigTForm(const Cvec3& t) : t_(t) {
+  constexpr RigTForm(const Cvec3& t, const UnitQuat& r) : t_(t), r_(r) {
+  }
+
+  constexpr explicit RigTForm(const Cvec3& t) : t_(t) {
   }
 
   explicit RigTForm(const Quat& r) : r_(r) {
   }
 
-  Cvec3 getTranslation() const {
+  constexpr explicit RigTForm(const UnitQuat& r) : r_(r) {
+  }
+
+  constexpr Cvec3 getTranslation() const {
     return t_;
   }
 
-  Quat getRotation() const {
+  constexpr UnitQuat getRotation() const {
     return r_;
   }
 
-  RigTForm& setTranslation(const Cvec3& t) {
+  constexpr RigTForm& setTranslation(const Cvec3& t) {
     t_ = t;
     return *this;
   }
 
   RigTForm& setRotation(const Quat& r) {
+    r_ = UnitQuat(r);
+    return *this;
+  }
+
+  constexpr RigTForm& setRotation(const UnitQuat& r) {
     r_ = r;
     return *this;
   }
 
-  Cvec4 operator * (const Cvec4& a) const {
-	  return Matrix4::makeTranslation(t_)*quatToMatrix(r_)*a;
+  // Rotates a by r_ without building a matrix, then translates it by t_ if
+  // it is a point (a[3] == 1)
+  constexpr Cvec4 operator * (const Cvec4& a) const {
+	  const Cvec4 r = r_ * a;
+	  return Cvec4(r[0] + t_[0] * a[3], r[1] + t_[1] * a[3], r[2] + t_[2] * a[3], a[3]);
   }
 
-  RigTForm operator * (const RigTForm& a) const {
-	  return RigTForm(t_ + Cvec3(r_*Cvec4(a.getTranslation())),r_*a.getRotation());
+  // The product of the rotations is not renormalized: a single product
+  // stays unit to rounding, and what accumulates products renormalizes
+  constexpr RigTForm operator * (const RigTForm& a) const {
+	  return RigTForm(t_ + Cvec3(r_*Cvec4(a.t_)), r_ * a.r_);
   }
 };
 
-inline RigTForm inv(const RigTForm& tform) {
-	Quat i = inv(tform.getRotation());
+constexpr RigTForm inv(const RigTForm& tform) {
+	const UnitQuat i = inv(tform.getRotation());
 	return RigTForm(-Cvec3(i*Cvec4(tform.getTranslation())), i);
 }
 
-inline RigTForm transFact(const RigTForm& tform) {
+constexpr RigTForm transFact(const RigTForm& tform) {
   return RigTForm(tform.getTranslation());
 }
 
-inline RigTForm linFact(const RigTForm& tform) {
+constexpr RigTForm linFact(const RigTForm& tform) {
   return RigTForm(tform.getRotation());
 }
 
-inline Matrix4 rigTFormToMatrix(const RigTForm& tform) {
-	return Matrix4::makeTranslation(tform.getTranslation())*quatToMatrix(tform.getRotation());
+// The rotation matrix with the translation written into its last column,
+// which is what multiplying by a translation matrix would give
+constexpr Matrix4 rigTFormToMatrix(const RigTForm& tform) {
+	Matrix4 m = quatToMatrix(tform.getRotation());
+	const Cvec3 t = tform.getTranslation();
+	for (int i = 0; i < 3; ++i)
+		m(i, 3) = t[i];
+	return m;
 }
-
+
 inline RigTForm interpolate(const RigTForm& q0, const RigTForm& q1, const double a) {
 	Cvec3 t = q0.getTranslation() * (1 - a) + q1.getTranslation() * a;
 	Quat r = slerp(q0.getRotation(), q1.getRotation(), a);
 
 	return RigTForm(t, r);
-}
-
-#endif
+}
+
+#endif
@@ -0,0 +1,61 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include "crowdbench.h"
+#include "accuracy.h"
+#include "geometrybench.h"
+#include "skeletonbench.h"
+#include "heapcount.h"
+
+using namespace std;
+
+// The app's headless benchmarks and checks on their own, with no window,
+// GPU or GL:
+//   skeletal_bench -bench-geometry -bench-skinning -bench-skeleton
+//   skeletal_bench -bench-crowd [<characters> [<bones> [<clips> [<frames>]]]]
+//   skeletal_bench -check-accuracy
+// take the app's arguments of the same name. With no argument all run.
+// Exits with 1 if the accuracy check fails.
+int main(int argc, char* argv[]) {
+  try {
+    bool geometry = argc < 2, skinning = argc < 2, skeleton = argc < 2;
+    bool crowd = argc < 2, accuracy = argc < 2;
+    CrowdBenchConfig config = CROWDBENCH_DEFAULTS;
+    for (int i = 1; i < argc; ++i) {
+      if (strcmp(argv[i], "-bench-crowd") == 0) {
+        crowd = true;
+        int* settings[] = {&config.characters, &config.bones, &config.clips, &config.frames};
+        for (int s = 0; s < 4 && i + 1 < argc && argv[i + 1][0] != '-'; ++s)
+          *settings[s] = max(1, atoi(argv[++i]));
+      }
+      else if (strcmp(argv[i], "-check-accuracy") == 0)
+        accuracy = true;
+      else if (strcmp(argv[i], "-bench-geometry") == 0)
+        geometry = true;
+      else if (strcmp(argv[i], "-bench-skinning") == 0)
+        skinning = true;
+      else if (strcmp(argv[i], "-bench-skeleton") == 0)
+        skeleton = true;
+      else
+        throw runtime_error(string("Unknown argument ") + argv[i]);
+    }
+    if (geometry)
+      benchGeometry();
+    if (skinning)
+      benchSkinning();
+    if (skeleton)
+      benchSkeleton();
+    if (crowd)
+      benchCrowd(config);
+    if (accuracy && !checkAccuracy(ACCURACY_DEFAULTS))
+      return 1;
+    return 0;
+  }
+  catch (const runtime_error& e) {
+    cout << "Exception caught: " << e.what() << endl;
+    return -1;
+  }
+}
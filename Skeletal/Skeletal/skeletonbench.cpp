@@ -0,0 +1,84 @@
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "skeletonbench.h"
+#include "bonemask.h"
+#include "fixedskeleton.h"
+#include "Skeleton.h"
+
+using namespace std;
+
+namespace {
+
+// The procedural rig of initSurface, and a humanoid like tree of 20 bones
+// (spine and head, two arms, two legs)
+typedef FixedSkeleton<-1, 0, 1> ChainSkeleton;
+typedef FixedSkeleton<-1, 0, 1, 2, 3, 2, 5, 6, 7, 2, 9, 10, 11, 0, 13, 14, 0, 16, 17, 15> HumanoidSkeleton;
+
+// Times the bone matrices of one skeleton topology computed per bone
+// through the parent pointers (as drawSurface used to), by evaluateBones
+// and by the fixed skeleton
+template <typename Fixed>
+void benchFixedSkeleton(const char* name) {
+  const int n = Fixed::BONE_COUNT;
+  RigTForm transforms[Fixed::BONE_COUNT];
+  Skeleton skeleton;
+  vector<Bone*> added(n);
+  for (int b = 0; b < n; ++b) {
+    const int parent = Fixed::getParent(b);
+    transforms[b] = RigTForm(Cvec3(0.1 * b, 2.0 / 3, 0), Quat::makeZRotation(5.0 * b));
+    added[b] = skeleton.addBone(b, parent >= 0 ? added[parent] : NULL, transforms[b]);
+  }
+  Fixed fixed(transforms);
+  BoneMask all;
+  all.used.assign(n, 1);
+  vector<int> parents;
+  skeleton.getParentNames(parents);
+  finishBoneMask(parents, all);
+
+  vector<Matrix4> models(n), bones[3];
+  for (int variant = 0; variant < 3; ++variant)
+    bones[variant].resize(n);
+  const int reps = 4000000 / n;
+  double nanoseconds[3];
+  for (int variant = 0; variant < 3; ++variant) {
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+      // pose one bone per pass, as an animation would
+      const Quat q = Quat::makeXRotation(r % 90);
+      if (variant == 0) {
+        skeleton.getNamedBone(r % n)->setRotate(q);
+        for (int b = 0; b < n; ++b)
+          bones[0][b] = skeleton.getNamedBone(b)->getBoneMatrix();
+      }
+      else if (variant == 1) {
+        skeleton.getNamedBone(r % n)->setRotate(q);
+        evaluateBones(skeleton, parents, all.order, &models[0], &bones[1][0]);
+      }
+      else {
+        fixed.setRotate(r % n, q);
+        fixed.evaluate(&models[0], &bones[2][0]);
+      }
+    }
+    nanoseconds[variant] = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / reps;
+  }
+
+  // all variants saw the same poses
+  for (int variant = 1; variant < 3; ++variant) {
+    for (int b = 0; b < n; ++b) {
+      if (norm2(bones[variant][b] - bones[0][b]) > CS175_EPS2)
+        throw runtime_error("Skeleton evaluations differ");
+    }
+  }
+  cout << name << " (" << n << " bones): " << nanoseconds[0] << " ns per bone walk, "
+       << nanoseconds[1] << " ns evaluateBones, " << nanoseconds[2] << " ns fixed skeleton" << endl;
+}
+
+} // namespace
+
+void benchSkeleton() {
+  benchFixedSkeleton<ChainSkeleton>("Chain");
+  benchFixedSkeleton<HumanoidSkeleton>("Humanoid");
+}
@@ -0,0 +1,15 @@
+#ifndef SKELETONBENCH_H
+#define SKELETONBENCH_H
+
+//--------------------------------------------------------------------------------
+// Benchmark of computing bone matrices: per bone through the parent
+// pointers, by evaluateBones and by a FixedSkeleton, for the procedural rig
+// and a humanoid like tree of 20 bones. The skeletal_bench target of
+// CMakeLists.txt runs it without the app.
+//--------------------------------------------------------------------------------
+
+// Prints the ns per pass of each way. Throws runtime_error if they
+// disagree.
+void benchSkeleton();
+
+#endif
@@ -0,0 +1,157 @@
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <stdexcept>
+
+#include "skinpartition.h"
+
+using namespace std;
+
+// Sorted names of the bones a triangle is weighted to
+static vector<int> triangleBones(const vector<VertexPNB>& vertices, const unsigned short* tri) {
+  vector<int> bones;
+  for (int i = 0; i < 3; ++i) {
+    const VertexPNB& v = vertices[tri[i]];
+    for (int j = 0; j < 3; ++j) {
+      if (v.bw[j] > 0)
+        bones.push_back(v.bn[j]);
+    }
+  }
+  sort(bones.begin(), bones.end());
+  bones.erase(unique(bones.begin(), bones.end()), bones.end());
+  return bones;
+}
+
+void partitionSkin(const vector<VertexPNB>& vertices, const vector<unsigned short>& indices,
+                   int paletteSize, PartitionedSkin& result) {
+  const int triCount = int(indices.size() / 3);
+
+  // Bones of each triangle, and triangles of each bone
+  vector<vector<int> > triBones(triCount);
+  vector<vector<int> > boneTris;
+  size_t maxCost = 0;
+  for (int t = 0; t < triCount; ++t) {
+    triBones[t] = triangleBones(vertices, &indices[3 * t]);
+    if (int(triBones[t].size()) > paletteSize)
+      throw runtime_error("A triangle references " + to_string(triBones[t].size()) +
+                          " bones, more than the palette size of " + to_string(paletteSize));
+    maxCost = max(maxCost, triBones[t].size());
+    for (size_t i = 0; i < triBones[t].size(); ++i) {
+      const int b = triBones[t][i];
+      if (b >= int(boneTris.size()))
+        boneTris.resize(b + 1);
+      boneTris[b].push_back(t);
+    }
+  }
+
+  // cost[t] is the number of bones triangle t would add to the open
+  // partition. buckets[c] holds the triangles whose cost was c when they were
+  // pushed; stale entries are skipped when popped.
+  vector<int> partitionOf(triCount, -1), cost(triCount);
+  vector<vector<int> > buckets(maxCost + 1);
+  vector<int> boneSlot(boneTris.size(), -1);
+  vector<vector<int> > partitionTris;
+  int assigned = 0, seed = 0;
+
+  result.partitions.clear();
+  while (assigned < triCount) {
+    const int p = int(result.partitions.size());
+    result.partitions.push_back(SkinPartition());
+    partitionTris.push_back(vector<int>());
+    SkinPartition& part = result.partitions.back();
+
+    for (size_t c = 0; c < buckets.size(); ++c)
+      buckets[c].clear();
+    for (int t = 0; t < triCount; ++t) {
+      if (partitionOf[t] < 0) {
+        cost[t] = int(triBones[t].size());
+        buckets[cost[t]].push_back(t);
+      }
+    }
+    // Seed with the first remaining triangle so partitions follow the
+    // original (cache optimized) order
+    while (partitionOf[seed] >= 0)
+      ++seed;
+    int next = seed;
+
+    while (next >= 0) {
+      partitionOf[next] = p;
+      partitionTris[p].push_back(next);
+      ++assigned;
+
+      for (size_t i = 0; i < triBones[next].size(); ++i) {
+        const int b = triBones[next][i];
+        if (boneSlot[b] >= 0)
+          continue;
+        boneSlot[b] = int(part.bones.size());
+        part.bones.push_back(b);
+        for (size_t j = 0; j < boneTris[b].size(); ++j) {
+          const int t = boneTris[b][j];
+          if (partitionOf[t] < 0)
+            buckets[--cost[t]].push_back(t);
+        }
+      }
+
+      // Cheapest remaining triangle that still fits. All valid entries of a
+      // bucket share its cost, so the first bucket that does not fit ends
+      // the search.
+      next = -1;
+      for (size_t c = 0; c < buckets.size() && next < 0; ++c) {
+        if (part.bones.size() + c > size_t(paletteSize))
+          break;
+        vector<int>& bucket = buckets[c];
+        while (!bucket.empty() && next < 0) {
+          const int t = bucket.back();
+          bucket.pop_back();
+          if (partitionOf[t] < 0 && cost[t] == int(c))
+            next = t;
+        }
+      }
+    }
+
+    for (size_t i = 0; i < part.bones.size(); ++i)
+      boneSlot[part.bones[i]] = -1;
+  }
+
+  // Emit each partition with its own copy of the vertices it uses, bone
+  // names replaced by palette slots
+  vector<int> vertexPartition(vertices.size(), -1), vertexRemap(vertices.size());
+  int usedVertices = 0;
+  result.vertices.clear();
+  result.indices.clear();
+  for (size_t p = 0; p < result.partitions.size(); ++p) {
+    SkinPartition& part = result.partitions[p];
+    for (size_t i = 0; i < part.bones.size(); ++i)
+      boneSlot[part.bones[i]] = int(i);
+
+    vector<int>& tris = partitionTris[p];
+    sort(tris.begin(), tris.end());
+    part.firstIndex = int(result.indices.size());
+    part.indexCount = int(3 * tris.size());
+
+    for (size_t i = 0; i < tris.size(); ++i) {
+      for (int k = 0; k < 3; ++k) {
+        const int v = indices[3 * tris[i] + k];
+        if (vertexPartition[v] != int(p)) {
+          if (vertexPartition[v] < 0)
+            ++usedVertices;
+          vertexPartition[v] = int(p);
+          vertexRemap[v] = int(result.vertices.size());
+          VertexPNB w = vertices[v];
+          for (int j = 0; j < 3; ++j)
+            w.bn[j] = w.bw[j] > 0 ? boneSlot[w.bn[j]] : 0;
+          result.vertices.push_back(w);
+        }
+        result.indices.push_back((unsigned short)vertexRemap[v]);
+      }
+    }
+
+    for (size_t i = 0; i < part.bones.size(); ++i)
+      boneSlot[part.bones[i]] = -1;
+  }
+
+  if (result.vertices.size() > 65536)
+    throw runtime_error("Partitioned mesh has " + to_string(result.vertices.size()) +
+                        " vertices, too many for 16 bit indices");
+  result.duplicatedVertices = int(result.vertices.size()) - usedVertices;
+}
@@ -0,0 +1,36 @@
+#ifndef SKINPARTITION_H
+#define SKINPARTITION_H
+
+#include <vector>
+
+#include "vertexpnb.h"
+
+//--------------------------------------------------------------------------------
+// Splits a skinned triangle list into partitions that each reference at most
+// paletteSize bones, so meshes with more bones than the shader palette holds
+// can be drawn one partition at a time.
+//--------------------------------------------------------------------------------
+
+struct SkinPartition {
+  std::vector<int> bones;  // bone name uploaded to each palette slot
+  int firstIndex;          // range of the partition in the index list
+  int indexCount;
+};
+
+struct PartitionedSkin {
+  std::vector<VertexPNB> vertices;      // bn holds palette slots, not bone names
+  std::vector<unsigned short> indices;  // triangle list, partition after partition
+  std::vector<SkinPartition> partitions;
+  int duplicatedVertices;               // vertices shared by several partitions
+};
+
+// Greedily grows one partition at a time from a seed triangle, always taking
+// the remaining triangle that adds the fewest new bones. Triangles sharing
+// bones tend to be neighbours, which keeps partitions compact and the number
+// of vertices duplicated along their borders low. Bones with zero weight are
+// ignored. Throws runtime_error if a single triangle needs more than
+// paletteSize bones.
+void partitionSkin(const std::vector<VertexPNB>& vertices, const std::vector<unsigned short>& indices,
+                   int paletteSize, PartitionedSkin& result);
+
+#endif
@@ -0,0 +1,66 @@
+#include <iostream>
+#include <algorithm>
+
+#include "skinweights.h"
+
+using namespace std;
+
+InfluenceStats pruneInfluences(vector<VertexPNB>& vertices, float threshold, int maxInfluences) {
+  InfluenceStats stats = {{0, 0, 0, 0}, 0, 0};
+
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    VertexPNB& v = vertices[i];
+
+    // sort the three influences by decreasing weight
+    int order[3] = {0, 1, 2};
+    sort(order, order + 3, [&v](int a, int b) { return v.bw[a] > v.bw[b]; });
+
+    int bn[3];
+    float bw[3], sum = 0;
+    int count = 0;
+    for (int j = 0; j < 3; ++j) {
+      const float w = v.bw[order[j]];
+      if (w <= 0)
+        continue;
+      if (w < threshold || count == maxInfluences) {
+        ++stats.weightsPruned;
+        continue;
+      }
+      bn[count] = v.bn[order[j]];
+      bw[count] = w;
+      sum += w;
+      ++count;
+    }
+
+    // keep the largest weight of a vertex whose weights were all below the
+    // threshold
+    if (count == 0 && v.bw[order[0]] > 0) {
+      bn[0] = v.bn[order[0]];
+      bw[0] = sum = v.bw[order[0]];
+      count = 1;
+      --stats.weightsPruned;
+    }
+
+    const int first = count > 0 ? bn[0] : v.bn[0];
+    for (int j = 0; j < 3; ++j) {
+      v.bn[j] = j < count ? bn[j] : first;
+      v.bw[j] = j < count ? bw[j] / sum : 0;
+    }
+    ++stats.vertices[count];
+    stats.maxInfluences = max(stats.maxInfluences, count);
+  }
+  return stats;
+}
+
+int countMeshInfluences(const VertexPNB* vertices, int count) {
+  int influences = 0;
+  for (int i = 0; i < count && influences < 3; ++i)
+    influences = max(influences, countInfluences(vertices[i]));
+  return influences;
+}
+
+void printInfluenceStats(const char* name, const InfluenceStats& stats) {
+  cout << name << ": " << stats.vertices[1] << "/" << stats.vertices[2] << "/" << stats.vertices[3]
+       << " vertices with 1/2/3 influences, " << stats.weightsPruned << " weights pruned, "
+       << stats.maxInfluences << " influences per vertex" << endl;
+}
@@ -0,0 +1,42 @@
+#ifndef SKINWEIGHTS_H
+#define SKINWEIGHTS_H
+
+#include <vector>
+
+#include "vertexpnb.h"
+
+//--------------------------------------------------------------------------------
+// Preprocessing of skinning weights. After pruneInfluences the influences of
+// every vertex are sorted by decreasing weight and unused slots have weight
+// 0, so a shader skinning with only the first n influences (and
+// renormalizing them) is the best n bone approximation of the vertex.
+//--------------------------------------------------------------------------------
+
+// Weights below this are dropped by default
+static const float SKIN_WEIGHT_THRESHOLD = 0.01f;
+
+// Influence counts found by pruneInfluences
+struct InfluenceStats {
+  int vertices[4];       // number of vertices with 0..3 influences
+  int maxInfluences;     // influences the mesh needs, the shader variant to use
+  int weightsPruned;     // nonzero weights that were dropped
+};
+
+// Drops weights below `threshold' and all but the `maxInfluences' largest
+// ones, renormalizes the remaining weights to sum to 1 and sorts them in
+// decreasing order. Unused slots get weight 0 and the bone of the first
+// slot.
+InfluenceStats pruneInfluences(std::vector<VertexPNB>& vertices,
+                               float threshold = SKIN_WEIGHT_THRESHOLD, int maxInfluences = 3);
+
+// Number of nonzero weights of a vertex
+inline int countInfluences(const VertexPNB& v) {
+  return (v.bw[0] > 0) + (v.bw[1] > 0) + (v.bw[2] > 0);
+}
+
+// Largest influence count over `count' vertices
+int countMeshInfluences(const VertexPNB* vertices, int count);
+
+void printInfluenceStats(const char* name, const InfluenceStats& stats);
+
+#endif
@@ -0,0 +1,174 @@
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SPARSESKIN_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "sparseskin.h"
+
+using namespace std;
+
+void buildSkinWeightsCsr(const VertexPNB* vertices, int count, SkinWeightsCsr& csr) {
+  csr.rowStart.resize(count + 1);
+  csr.bones.clear();
+  csr.weights.clear();
+  for (int v = 0; v < count; ++v) {
+    csr.rowStart[v] = (int) csr.bones.size();
+    for (int j = 0; j < 3; ++j) {
+      if (vertices[v].bw[j] > 0) {
+        csr.bones.push_back(vertices[v].bn[j]);
+        csr.weights.push_back(vertices[v].bw[j]);
+      }
+    }
+  }
+  csr.rowStart[count] = (int) csr.bones.size();
+}
+
+void buildSkinWeightsEll(const VertexPNB* vertices, int count, SkinWeightsEll& ell) {
+  ell.width = 1;
+  for (int v = 0; v < count; ++v)
+    ell.width = max(ell.width, (vertices[v].bw[0] > 0) + (vertices[v].bw[1] > 0) + (vertices[v].bw[2] > 0));
+
+  ell.bones.assign(count * ell.width, 0);
+  ell.weights.assign(count * ell.width, 0.0f);
+  for (int v = 0; v < count; ++v) {
+    int slot = v * ell.width;
+    for (int j = 0; j < 3; ++j) {
+      if (vertices[v].bw[j] > 0) {
+        ell.bones[slot] = vertices[v].bn[j];
+        ell.weights[slot++] = vertices[v].bw[j];
+      }
+    }
+  }
+}
+
+void buildSkinInput(const VertexPNB* vertices, int count, SkinInput& input) {
+  input.positions.resize(3 * count);
+  input.normals.resize(3 * count);
+  for (int v = 0; v < count; ++v) {
+    for (int j = 0; j < 3; ++j) {
+      input.positions[3 * v + j] = vertices[v].p[j];
+      input.normals[3 * v + j] = vertices[v].n[j];
+    }
+  }
+}
+
+static inline void transformVertex(const float* m, const float* p, const float* n, float* op, float* on) {
+  for (int i = 0; i < 3; ++i) {
+    const float* r = m + 4 * i;
+    op[i] = r[0] * p[0] + r[1] * p[1] + r[2] * p[2] + r[3];
+    on[i] = r[0] * n[0] + r[1] * n[1] + r[2] * n[2];
+  }
+}
+
+// Blends and applies the matrix of character k for the vertex whose
+// influences are given, for the characters past the last full group of
+// lanes and for targets without SSE2
+static inline void skinVertexCharacter(const int* bones, const float* weights, int influences,
+                                       const float* p, const float* n, const float* palettes, int K, int k,
+                                       float* op, float* on) {
+  float m[SKIN_PALETTE_STRIDE] = {0};
+  for (int i = 0; i < influences; ++i) {
+    const float* bone = palettes + bones[i] * SKIN_PALETTE_STRIDE * K + k;
+    for (int j = 0; j < SKIN_PALETTE_STRIDE; ++j)
+      m[j] += weights[i] * bone[j * K];
+  }
+  for (int i = 0; i < 3; ++i) {
+    const float* r = m + 4 * i;
+    op[i * K + k] = r[0] * p[0] + r[1] * p[1] + r[2] * p[2] + r[3];
+    on[i * K + k] = r[0] * n[0] + r[1] * n[1] + r[2] * n[2];
+  }
+}
+
+#ifdef SPARSESKIN_SSE2
+// The same for characters [k, k + 4), one per lane: a matrix element of a
+// bone is 4 consecutive floats for them, and so is each output component
+static inline void skinVertexLanes(const int* bones, const float* weights, int influences,
+                                   const float* p, const float* n, const float* palettes, int K, int k,
+                                   float* op, float* on) {
+  __m128 m[SKIN_PALETTE_STRIDE];
+  for (int j = 0; j < SKIN_PALETTE_STRIDE; ++j)
+    m[j] = _mm_setzero_ps();
+  for (int i = 0; i < influences; ++i) {
+    const __m128 weight = _mm_set1_ps(weights[i]);
+    const float* bone = palettes + bones[i] * SKIN_PALETTE_STRIDE * K + k;
+    for (int j = 0; j < SKIN_PALETTE_STRIDE; ++j)
+      m[j] = _mm_add_ps(m[j], _mm_mul_ps(weight, _mm_loadu_ps(bone + j * K)));
+  }
+  const __m128 px = _mm_set1_ps(p[0]), py = _mm_set1_ps(p[1]), pz = _mm_set1_ps(p[2]);
+  const __m128 nx = _mm_set1_ps(n[0]), ny = _mm_set1_ps(n[1]), nz = _mm_set1_ps(n[2]);
+  for (int i = 0; i < 3; ++i) {
+    const __m128* r = m + 4 * i;
+    const __m128 xy = _mm_add_ps(_mm_mul_ps(r[0], px), _mm_mul_ps(r[1], py));
+    _mm_storeu_ps(op + i * K + k, _mm_add_ps(xy, _mm_add_ps(_mm_mul_ps(r[2], pz), r[3])));
+    const __m128 nxy = _mm_add_ps(_mm_mul_ps(r[0], nx), _mm_mul_ps(r[1], ny));
+    _mm_storeu_ps(on + i * K + k, _mm_add_ps(nxy, _mm_mul_ps(r[2], nz)));
+  }
+}
+#endif
+
+// Skins vertex v for all K characters from its influences, loaded once
+static inline void skinVertexBatch(const int* bones, const float* weights, int influences, const SkinInput& input,
+                                   const float* palettes, int K, int v, float* positions, float* normals) {
+  const float* p = &input.positions[3 * v];
+  const float* n = &input.normals[3 * v];
+  float* op = positions + 3 * v * K;
+  float* on = normals + 3 * v * K;
+  int k = 0;
+#ifdef SPARSESKIN_SSE2
+  for (; k + 4 <= K; k += 4)
+    skinVertexLanes(bones, weights, influences, p, n, palettes, K, k, op, on);
+#endif
+  for (; k < K; ++k)
+    skinVertexCharacter(bones, weights, influences, p, n, palettes, K, k, op, on);
+}
+
+// The ELL width is a template parameter so the influence loop unrolls
+template <int Width>
+static void skinEllBatchWidth(const SkinWeightsEll& w, const SkinInput& input, const float* palettes, int K,
+                              float* positions, float* normals) {
+  const int vertexCount = (int) input.positions.size() / 3;
+  for (int v = 0; v < vertexCount; ++v)
+    skinVertexBatch(&w.bones[v * Width], &w.weights[v * Width], Width, input, palettes, K, v, positions, normals);
+}
+
+void skinCsr(const SkinWeightsCsr& w, const SkinInput& input, const float* palette,
+             float* positions, float* normals) {
+  const int vertexCount = (int) w.rowStart.size() - 1;
+  for (int v = 0; v < vertexCount; ++v) {
+    float m[SKIN_PALETTE_STRIDE] = {0};
+    for (int i = w.rowStart[v]; i < w.rowStart[v + 1]; ++i) {
+      const float weight = w.weights[i];
+      const float* bone = palette + w.bones[i] * SKIN_PALETTE_STRIDE;
+      for (int j = 0; j < SKIN_PALETTE_STRIDE; ++j)
+        m[j] += weight * bone[j];
+    }
+    transformVertex(m, &input.positions[3 * v], &input.normals[3 * v], positions + 3 * v, normals + 3 * v);
+  }
+}
+
+void skinCsrBatch(const SkinWeightsCsr& w, const SkinInput& input, const float* palettes, int K,
+                  float* positions, float* normals) {
+  // one character has no lanes to fill, and its layouts are skinCsr's
+  if (K == 1) {
+    skinCsr(w, input, palettes, positions, normals);
+    return;
+  }
+  const int vertexCount = (int) w.rowStart.size() - 1;
+  for (int v = 0; v < vertexCount; ++v) {
+    const int first = w.rowStart[v];
+    skinVertexBatch(&w.bones[0] + first, &w.weights[0] + first, w.rowStart[v + 1] - first, input, palettes, K, v,
+                    positions, normals);
+  }
+}
+
+void skinEllBatch(const SkinWeightsEll& w, const SkinInput& input, const float* palettes, int K,
+                  float* positions, float* normals) {
+  if (w.width == 1)
+    skinEllBatchWidth<1>(w, input, palettes, K, positions, normals);
+  else if (w.width == 2)
+    skinEllBatchWidth<2>(w, input, palettes, K, positions, normals);
+  else
+    skinEllBatchWidth<3>(w, input, palettes, K, positions, normals);
+}
@@ -0,0 +1,62 @@
+#ifndef SPARSESKIN_H
+#define SPARSESKIN_H
+
+#include <vector>
+
+#include "vertexpnb.h"
+
+//--------------------------------------------------------------------------------
+// CPU skinning as a sparse matrix product: the weights form a (vertices x
+// bones) sparse matrix W and a palette a dense column of bone matrices, so
+// the skinned mesh of K characters is W times a (bones x K) block of
+// palettes. Palettes hold the first three rows of each affine bone matrix
+// (12 floats, row-major), as the crowd's buffer texture does.
+//--------------------------------------------------------------------------------
+
+static const int SKIN_PALETTE_STRIDE = 12;  // floats per bone matrix
+
+// Compressed sparse rows: the influences of vertex v are
+// bones/weights[rowStart[v] .. rowStart[v+1])
+struct SkinWeightsCsr {
+  std::vector<int> rowStart;
+  std::vector<int> bones;
+  std::vector<float> weights;
+};
+
+// ELLPACK: every vertex has `width' influence slots, unused ones with
+// weight 0 and bone 0. Slot s of vertex v is at v * width + s.
+struct SkinWeightsEll {
+  int width;
+  std::vector<int> bones;
+  std::vector<float> weights;
+};
+
+// Keep the nonzero weights of the vertices
+void buildSkinWeightsCsr(const VertexPNB* vertices, int count, SkinWeightsCsr& csr);
+void buildSkinWeightsEll(const VertexPNB* vertices, int count, SkinWeightsEll& ell);
+
+// Positions and normals of the bind pose, 3 floats per vertex
+struct SkinInput {
+  std::vector<float> positions, normals;
+};
+void buildSkinInput(const VertexPNB* vertices, int count, SkinInput& input);
+
+// Skins one character with palette[bone * 12]. Writes 3 floats per vertex
+// to positions and normals. Normals use the linear part of the blended
+// matrix, which is right for rigid bones, and are not renormalized.
+void skinCsr(const SkinWeightsCsr& w, const SkinInput& input, const float* palette,
+             float* positions, float* normals);
+
+// Skins K characters sharing the mesh a vertex at a time: each vertex's
+// influences and input are loaded once and blended for 4 characters at a
+// time, one per SIMD lane. Both the palettes and the output interleave the
+// characters so that the lanes are contiguous: element j of the matrix of
+// bone b for character k is palettes[(b * 12 + j) * K + k], and component c
+// of character k's vertex v is written at (v * 3 + c) * K + k. With K = 1
+// these are the layouts of skinCsr.
+void skinCsrBatch(const SkinWeightsCsr& w, const SkinInput& input, const float* palettes, int K,
+                  float* positions, float* normals);
+void skinEllBatch(const SkinWeightsEll& w, const SkinInput& input, const float* palettes, int K,
+                  float* positions, float* normals);
+
+#endif
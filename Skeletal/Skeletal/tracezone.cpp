@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "tracezone.h"
+
+using namespace std;
+
+namespace {
+
+struct TraceEvent {
+  const char* name;
+  long long startNs, endNs;  // since g_traceEpoch
+};
+
+struct TraceBuffer {
+  int tid;
+  long long count;  // recorded so far, including those overwritten
+  vector<TraceEvent> events;
+};
+
+const TraceClock::time_point g_traceEpoch = TraceClock::now();
+
+// Buffers outlive their threads, so zones of finished workers still export
+mutex g_traceMutex;
+vector<unique_ptr<TraceBuffer> > g_traceBuffers;
+
+thread_local TraceBuffer* t_traceBuffer = NULL;
+
+TraceBuffer* registerTraceBuffer() {
+  unique_ptr<TraceBuffer> buffer(new TraceBuffer());
+  buffer->count = 0;
+  buffer->events.resize(TRACE_EVENTS_PER_THREAD);
+  lock_guard<mutex> lock(g_traceMutex);
+  buffer->tid = (int) g_traceBuffers.size();
+  g_traceBuffers.push_back(move(buffer));
+  return g_traceBuffers.back().get();
+}
+
+long long sinceEpochNs(TraceClock::time_point t) {
+  return chrono::duration_cast<chrono::nanoseconds>(t - g_traceEpoch).count();
+}
+
+} // namespace
+
+void recordTraceZone(const char* name, TraceClock::time_point start, TraceClock::time_point end) {
+  TraceBuffer* buffer = t_traceBuffer;
+  if (!buffer)
+    buffer = t_traceBuffer = registerTraceBuffer();
+  TraceEvent& e = buffer->events[buffer->count++ % TRACE_EVENTS_PER_THREAD];
+  e.name = name;
+  e.startNs = sinceEpochNs(start);
+  e.endNs = sinceEpochNs(end);
+}
+
+int writeTrace(const char* filename) {
+  ofstream f(filename);
+  if (!f)
+    throw runtime_error(string("Cannot write trace ") + filename);
+
+  // complete ("X") events in microseconds, one process, a track per thread
+  lock_guard<mutex> lock(g_traceMutex);
+  int written = 0;
+  f << fixed << setprecision(3) << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  for (size_t t = 0; t < g_traceBuffers.size(); ++t) {
+    const TraceBuffer& buffer = *g_traceBuffers[t];
+    const long long first = max(0LL, buffer.count - TRACE_EVENTS_PER_THREAD);
+    for (long long i = first; i < buffer.count; ++i) {
+      const TraceEvent& e = buffer.events[i % TRACE_EVENTS_PER_THREAD];
+      f << (written++ ? ",\n" : "\n") << "  {\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+        << buffer.tid << ", \"ts\": " << e.startNs / 1e3 << ", \"dur\": " << (e.endNs - e.startNs) / 1e3 << "}";
+    }
+  }
+  f << "\n]}\n";
+  if (!f)
+    throw runtime_error(string("Cannot write trace ") + filename);
+  return written;
+}
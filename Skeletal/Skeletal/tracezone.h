@@ -0,0 +1,59 @@
+#ifndef TRACEZONE_H
+#define TRACEZONE_H
+
+#include <chrono>
+
+//--------------------------------------------------------------------------------
+// Scoped timing zones for the frame's hot paths. TRACE_ZONE("name") times the
+// rest of the enclosing scope: the start and end ticks go to a fixed ring
+// buffer owned by the calling thread, so recording takes no lock and never
+// touches the heap after a thread's first zone. writeTrace() exports what the
+// buffers hold as Chrome trace event JSON, which chrome://tracing and
+// Perfetto open.
+//
+// Zones are compiled in unless TRACE_ZONES is defined as 0, in which case
+// TRACE_ZONE expands to nothing.
+//--------------------------------------------------------------------------------
+
+#ifndef TRACE_ZONES
+#define TRACE_ZONES 1
+#endif
+
+// Most recent zones kept per thread, older ones are overwritten
+static const int TRACE_EVENTS_PER_THREAD = 1 << 16;
+
+typedef std::chrono::steady_clock TraceClock;
+
+// Appends a finished zone to the calling thread's buffer. name must outlive
+// the trace, a string literal in practice.
+void recordTraceZone(const char* name, TraceClock::time_point start, TraceClock::time_point end);
+
+// Writes every thread's zones to filename, oldest first, and returns how many
+// were written. The other threads must not be recording meanwhile. Throws
+// runtime_error when the file cannot be written.
+int writeTrace(const char* filename);
+
+class TraceZone {
+  const char* name_;
+  TraceClock::time_point start_;
+
+  TraceZone(const TraceZone&);
+  TraceZone& operator = (const TraceZone&);
+
+public:
+  explicit TraceZone(const char* name) : name_(name), start_(TraceClock::now()) {}
+
+  ~TraceZone() {
+    recordTraceZone(name_, start_, TraceClock::now());
+  }
+};
+
+#if TRACE_ZONES
+#define TRACE_ZONE_JOIN2(a, b) a##b
+#define TRACE_ZONE_JOIN(a, b) TRACE_ZONE_JOIN2(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_ZONE_JOIN(traceZone, __LINE__)(name)
+#else
+#define TRACE_ZONE(name)
+#endif
+
+#endif
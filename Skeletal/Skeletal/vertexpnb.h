@@ -0,0 +1,35 @@
+#ifndef VERTEXPNB_H
+#define VERTEXPNB_H
+
+#include "cvec.h"
+#include "geometrymaker.h"
+
+// A vertex with floating point position and normal and bone coordinates
+struct VertexPNB {
+  Cvec3f p, n, bw;
+  Cvec<int,3> bn;
+
+  VertexPNB() {}
+  VertexPNB(float x, float y, float z,
+           float nx, float ny, float nz)
+    : p(x,y,z), n(nx, ny, nz)
+  {}
+
+  VertexPNB(const SmallVertex& v)
+	  : p(v.pos), n(v.normal), bn(v.boneNames), bw(v.boneWeights)
+  {}
+
+  // Define copy constructor and assignment operator from GenericVertex so we can
+  // use make* functions from geometrymaker.h
+  VertexPNB(const GenericVertex& v) {
+    *this = v;
+  }
+
+  VertexPNB& operator = (const GenericVertex& v) {
+    p = v.pos;
+    n = v.normal;
+    return *this;
+  }
+};
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//--------------------------------------------------------------------------------
+// A fixed set of worker threads started once and reused, so that a parallel
+// loop costs a wake-up rather than a thread creation per call. run() hands
+// out jobs 0..jobCount-1 to the workers and the calling thread and returns
+// once all are done. Calls from several threads are served one at a time;
+// a job must not call run() on the pool it runs on.
+//--------------------------------------------------------------------------------
+
+class WorkerPool {
+  std::vector<std::thread> threads_;
+  std::mutex mutex_, runMutex_;
+  std::condition_variable wake_, done_;
+  const std::function<void(int)>* job_;
+  int jobCount_;
+  std::atomic<int> next_;
+  int busy_;                  // workers not yet through the current run
+  unsigned generation_;       // bumped by each run
+  bool quit_;
+
+  // Takes jobs until there are none left
+  void take(const std::function<void(int)>& job, int jobCount) {
+    for (int i = next_++; i < jobCount; i = next_++)
+      job(i);
+  }
+
+  void work() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    unsigned seen = generation_;
+    for (;;) {
+      wake_.wait(lock, [&] { return quit_ || generation_ != seen; });
+      if (quit_)
+        return;
+      seen = generation_;
+      const std::function<void(int)>& job = *job_;
+      const int jobCount = jobCount_;
+      lock.unlock();
+      take(job, jobCount);
+      lock.lock();
+      if (--busy_ == 0)
+        done_.notify_one();
+    }
+  }
+
+public:
+  // threadCount counts the calling thread, so threadCount - 1 are started
+  explicit WorkerPool(int threadCount)
+    : job_(nullptr), jobCount_(0), next_(0), busy_(0), generation_(0), quit_(false) {
+    for (int i = 1; i < threadCount; ++i)
+      threads_.push_back(std::thread(&WorkerPool::work, this));
+  }
+
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      quit_ = true;
+    }
+    wake_.notify_all();
+    for (size_t i = 0; i < threads_.size(); ++i)
+      threads_[i].join();
+  }
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  int threadCount() const { return int(threads_.size()) + 1; }
+
+  // One pool of the hardware concurrency for the whole process, started on
+  // first use
+  static WorkerPool& shared() {
+    static WorkerPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+  }
+
+  // Runs job(i) for every i in [0, jobCount). A single job, or a pool of one
+  // thread, runs on the caller without waking anyone.
+  template<typename Job>
+  void run(int jobCount, Job job) {
+    if (jobCount <= 1 || threads_.empty()) {
+      for (int i = 0; i < jobCount; ++i)
+        job(i);
+      return;
+    }
+    const std::function<void(int)> f(job);
+    std::lock_guard<std::mutex> serial(runMutex_);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      job_ = &f;
+      jobCount_ = jobCount;
+      next_ = 0;
+      busy_ = int(threads_.size());
+      ++generation_;
+    }
+    wake_.notify_all();
+    take(f, jobCount);
+    // every worker checks in before the next run can start, so none misses one
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&] { return busy_ == 0; });
+  }
+};
+
+#endif